@@ -0,0 +1,78 @@
+// candlog-dump: デコーダが保存したバイナリの解候補ログ (<mergerCandidateFile>.bin) をテキストにする
+//
+// デコーダは打鍵ごとの候補を書式化せずにリングバッファへ記録し、saveCandidateLog のときに
+// 直前の打鍵の分だけをテキストで、リングバッファ全体をバイナリで書き出す。
+// このツールはバイナリのほうを、以前と同じテキスト形式で打鍵ごとに出力する。
+//
+// 使い方:
+//   candlog-dump <binFile> [options]
+//     -o <outFile>   出力先 (既定は標準出力。UTF-8)
+//     -l             最後に完了した打鍵の分だけを出力する
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "Lattice2_CandidateLogFormat.h"
+
+namespace {
+    struct Options {
+        std::string binFile;
+        std::string outFile;
+        bool lastStrokeOnly = false;
+    };
+
+    void usage() {
+        std::cerr << "usage: candlog-dump <binFile> [-o <outFile>] [-l]\n";
+    }
+
+    bool parseOptions(int argc, char** argv, Options& opts) {
+        for (int i = 1; i < argc; ++i) {
+            std::string opt = argv[i];
+            if (opt == "-l") {
+                opts.lastStrokeOnly = true;
+            } else if (opt == "-o") {
+                if (i + 1 >= argc) return false;
+                opts.outFile = argv[++i];
+            } else if (!opt.empty() && opt[0] == '-') {
+                return false;
+            } else {
+                if (!opts.binFile.empty()) return false;
+                opts.binFile = opt;
+            }
+        }
+        return !opts.binFile.empty();
+    }
+}
+
+int main(int argc, char** argv) {
+    Options opts;
+    if (!parseOptions(argc, argv, opts)) {
+        usage();
+        return 2;
+    }
+
+    std::ifstream ifs(opts.binFile, std::ios::binary);
+    if (!ifs) {
+        std::cerr << "cannot read candidate log: " << opts.binFile << std::endl;
+        return 2;
+    }
+    lattice2::candidate_log::Snapshot snap;
+    if (!lattice2::candidate_log::readSnapshot(ifs, snap)) {
+        std::cerr << "invalid candidate log: " << opts.binFile << std::endl;
+        return 1;
+    }
+
+    std::string text = lattice2::candidate_log::renderText(snap, opts.lastStrokeOnly);
+    if (opts.outFile.empty()) {
+        std::cout.write(text.data(), (std::streamsize)text.size());
+    } else {
+        std::ofstream ofs(opts.outFile, std::ios::binary);
+        if (!ofs) {
+            std::cerr << "cannot write: " << opts.outFile << std::endl;
+            return 2;
+        }
+        ofs.write(text.data(), (std::streamsize)text.size());
+    }
+    return 0;
+}
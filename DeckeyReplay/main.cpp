@@ -0,0 +1,436 @@
+// deckey-replay: 記録したDECKEY列をデコーダに流して、打鍵ごとの処理時間を計測する
+//
+// UI を介さずに CreateDecoder() でデコーダを生成し、settings ファイルの内容を presendSettings で送ってから
+// initializeDecoder を実行する。その後、DECKEY列ファイルの各DECKEYを HandleDeckeyDecoder() に渡し、
+// UI側と同じように numBackSpaces と outString を編集バッファに適用していく。
+//
+// 使い方:
+//   deckey-replay -s <settingsFile> -k <deckeyFile> [options]
+//     -r <rootDir>      settings の rootDir を上書きする
+//     -t <tableFile>    settings の tableFile を上書きする (rootDir からの相対パス)
+//     -D <key=value>    settings の任意の項目を上書きする (複数指定可)
+//     -x <expectedFile> 最終的な編集バッファの内容と比較する (UTF-8、末尾の改行は無視)
+//     -e <text>         編集バッファの初期内容
+//     -c <command>      初期化後、再生の前に実行するデコーダコマンド (複数指定可。引数はタブで区切る)
+//     -a <command>      再生の後に実行するデコーダコマンド (複数指定可。saveCandidateLog など)
+//     -n <passes>       計測するパス数 (既定 1。各パスの前にデコーダをリセットする)
+//     -w <passes>       計測前に空回しするパス数 (既定 0)
+//     -l <logLevel>     ログレベル (既定 0)
+//     -v                打鍵ごとの出力を表示する
+//
+// settings ファイルは UI側が送る settings と同じ key=value の行からなる (空行と # で始まる行は無視)。
+// DECKEY列ファイルは空白またはカンマで区切った DECKEY の並び (# から行末まではコメント)。
+//
+// アロケーション回数は、この実行ファイルで置き換えた operator new を数える。
+// デコーダを共有ライブラリとしてリンクした Linux では、デコーダ内部のアロケーションも数えられる。
+// Windows の DLL は自身の CRT でアロケートするため、DLL 内部のアロケーションは数えられない。
+// また、バックグラウンドのスレッド(ログ出力など)のアロケーションが混じることがある。
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Decoder.h"
+
+namespace {
+    // -------------------------------------------------------------------
+    // アロケーションの計数
+    std::atomic<size_t> allocCount{ 0 };
+
+    // -------------------------------------------------------------------
+    // 文字コード変換 (wchar_t が UTF-16 でも UTF-32 でも動くように自前で行う)
+    std::wstring fromUtf8(const std::string& str) {
+        std::wstring result;
+        size_t i = 0;
+        while (i < str.size()) {
+            unsigned char c = (unsigned char)str[i];
+            char32_t cp = 0xfffd;
+            size_t len = c < 0x80 ? 1 : (c >> 5) == 0x06 ? 2 : (c >> 4) == 0x0e ? 3 : (c >> 3) == 0x1e ? 4 : 0;
+            if (len == 0 || i + len > str.size()) {
+                ++i;
+            } else {
+                cp = len == 1 ? c : len == 2 ? (c & 0x1f) : len == 3 ? (c & 0x0f) : (c & 0x07);
+                for (size_t k = 1; k < len; ++k) cp = (cp << 6) | ((unsigned char)str[i + k] & 0x3f);
+                i += len;
+            }
+            if (sizeof(wchar_t) == 2 && cp >= 0x10000) {
+                cp -= 0x10000;
+                result.push_back((wchar_t)(0xd800 + (cp >> 10)));
+                result.push_back((wchar_t)(0xdc00 + (cp & 0x3ff)));
+            } else {
+                result.push_back((wchar_t)cp);
+            }
+        }
+        return result;
+    }
+
+    std::string toUtf8(const std::wstring& str) {
+        std::string result;
+        for (size_t i = 0; i < str.size(); ++i) {
+            char32_t cp = (char32_t)str[i];
+            if (sizeof(wchar_t) == 2 && cp >= 0xd800 && cp < 0xdc00 && i + 1 < str.size()) {
+                cp = 0x10000 + ((cp - 0xd800) << 10) + ((char32_t)str[++i] - 0xdc00);
+            }
+            if (cp < 0x80) {
+                result.push_back((char)cp);
+            } else if (cp < 0x800) {
+                result.push_back((char)(0xc0 | (cp >> 6)));
+                result.push_back((char)(0x80 | (cp & 0x3f)));
+            } else if (cp < 0x10000) {
+                result.push_back((char)(0xe0 | (cp >> 12)));
+                result.push_back((char)(0x80 | ((cp >> 6) & 0x3f)));
+                result.push_back((char)(0x80 | (cp & 0x3f)));
+            } else {
+                result.push_back((char)(0xf0 | (cp >> 18)));
+                result.push_back((char)(0x80 | ((cp >> 12) & 0x3f)));
+                result.push_back((char)(0x80 | ((cp >> 6) & 0x3f)));
+                result.push_back((char)(0x80 | (cp & 0x3f)));
+            }
+        }
+        return result;
+    }
+
+    // 固定長の wchar_t 配列に '\0' 終端でコピーする
+    template<size_t N>
+    void copyToArray(wchar_t (&dest)[N], const std::wstring& src) {
+        size_t len = std::min(src.size(), N - 1);
+        std::copy(src.begin(), src.begin() + len, dest);
+        dest[len] = 0;
+    }
+
+    template<size_t N>
+    std::wstring fromArray(const wchar_t (&src)[N]) {
+        size_t len = 0;
+        while (len < N && src[len] != 0) ++len;
+        return std::wstring(src, len);
+    }
+
+    bool readFile(const std::string& path, std::string& contents) {
+        std::ifstream ifs(path, std::ios::binary);
+        if (!ifs) return false;
+        std::ostringstream oss;
+        oss << ifs.rdbuf();
+        contents = oss.str();
+        if (contents.compare(0, 3, "\xEF\xBB\xBF") == 0) contents.erase(0, 3);
+        return true;
+    }
+
+    // -------------------------------------------------------------------
+    struct Options {
+        std::string settingsFile;
+        std::string deckeyFile;
+        std::string expectedFile;
+        std::vector<std::string> overrides;
+        std::string initialEdit;
+        std::vector<std::string> preCommands;
+        std::vector<std::string> postCommands;
+        int passes = 1;
+        int warmups = 0;
+        int logLevel = 0;
+        bool verbose = false;
+    };
+
+    void usage() {
+        std::cerr <<
+            "usage: deckey-replay -s <settingsFile> -k <deckeyFile> [-r <rootDir>] [-t <tableFile>] [-D <key=value>]...\n"
+            "                     [-x <expectedFile>] [-e <initialEdit>] [-c <command>]... [-a <command>]...\n"
+            "                     [-n <passes>] [-w <warmupPasses>] [-l <logLevel>] [-v]\n";
+    }
+
+    bool parseOptions(int argc, char** argv, Options& opts) {
+        for (int i = 1; i < argc; ++i) {
+            std::string opt = argv[i];
+            if (opt == "-v") {
+                opts.verbose = true;
+                continue;
+            }
+            if (i + 1 >= argc) return false;
+            std::string val = argv[++i];
+            if (opt == "-s") opts.settingsFile = val;
+            else if (opt == "-k") opts.deckeyFile = val;
+            else if (opt == "-x") opts.expectedFile = val;
+            else if (opt == "-r") opts.overrides.push_back("rootDir=" + val);
+            else if (opt == "-t") opts.overrides.push_back("tableFile=" + val);
+            else if (opt == "-D") opts.overrides.push_back(val);
+            else if (opt == "-e") opts.initialEdit = val;
+            else if (opt == "-c") opts.preCommands.push_back(val);
+            else if (opt == "-a") opts.postCommands.push_back(val);
+            else if (opt == "-n") opts.passes = std::max(1, std::atoi(val.c_str()));
+            else if (opt == "-w") opts.warmups = std::max(0, std::atoi(val.c_str()));
+            else if (opt == "-l") opts.logLevel = std::atoi(val.c_str());
+            else return false;
+        }
+        return !opts.settingsFile.empty() && !opts.deckeyFile.empty();
+    }
+
+    // settings ファイルを読んで、上書き指定を反映した settings 文字列を作る
+    bool loadSettings(const Options& opts, std::wstring& settings) {
+        std::string contents;
+        if (!readFile(opts.settingsFile, contents)) {
+            std::cerr << "cannot read settings file: " << opts.settingsFile << std::endl;
+            return false;
+        }
+        std::vector<std::string> lines;
+        std::istringstream iss(contents);
+        std::string line;
+        while (std::getline(iss, line)) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (line.empty() || line[0] == '#') continue;
+            lines.push_back(line);
+        }
+        for (const auto& ov : opts.overrides) {
+            auto key = ov.substr(0, ov.find('=') + 1);
+            lines.erase(std::remove_if(lines.begin(), lines.end(), [&key](const std::string& s) { return s.compare(0, key.size(), key) == 0; }), lines.end());
+            lines.push_back(ov);
+        }
+        lines.erase(std::remove_if(lines.begin(), lines.end(), [](const std::string& s) { return s.compare(0, 9, "logLevel=") == 0; }), lines.end());
+        lines.push_back("logLevel=" + std::to_string(opts.logLevel));
+
+        std::string joined;
+        for (const auto& s : lines) {
+            if (!joined.empty()) joined.push_back('\n');
+            joined += s;
+        }
+        settings = fromUtf8(joined);
+        return true;
+    }
+
+    // DECKEY列ファイルを読む
+    bool loadDeckeys(const std::string& path, std::vector<int>& deckeys) {
+        std::string contents;
+        if (!readFile(path, contents)) {
+            std::cerr << "cannot read deckey file: " << path << std::endl;
+            return false;
+        }
+        std::istringstream iss(contents);
+        std::string line;
+        while (std::getline(iss, line)) {
+            line = line.substr(0, line.find('#'));
+            std::replace(line.begin(), line.end(), ',', ' ');
+            std::istringstream ls(line);
+            std::string tok;
+            while (ls >> tok) {
+                char* end = nullptr;
+                long n = std::strtol(tok.c_str(), &end, 0);
+                if (*end != 0 || n < 0) {
+                    std::cerr << "invalid deckey: " << tok << std::endl;
+                    return false;
+                }
+                deckeys.push_back((int)n);
+            }
+        }
+        return true;
+    }
+
+    // -------------------------------------------------------------------
+    // デコーダを UI側と同じ手順で呼び出す
+    class DecoderDriver {
+        void* decoder = nullptr;
+        DecoderCommandParams cmdParams;
+        DecoderHandleDeckeyParams deckeyParams;
+        DecoderOutParams outParams;
+
+    public:
+        std::wstring buffer;
+        size_t vkeyCount = 0;
+
+        ~DecoderDriver() {
+            if (decoder) FinalizeDecoder(decoder);
+        }
+
+        bool ExecCmd(const std::wstring& cmd) {
+            copyToArray(cmdParams.inOutData, cmd);
+            int result = ExecCmdDecoder(decoder, &cmdParams, &outParams);
+            if (result < -2) {
+                std::cerr << "command failed: " << toUtf8(cmd.substr(0, cmd.find('\t'))) << ": " << toUtf8(fromArray(cmdParams.inOutData)) << std::endl;
+                return false;
+            }
+            return true;
+        }
+
+        bool Create(int logLevel, const std::wstring& settings) {
+            decoder = CreateDecoder(logLevel);
+            if (!decoder) {
+                std::cerr << "CreateDecoder failed" << std::endl;
+                return false;
+            }
+            copyToArray(cmdParams.inOutData, L"");
+            InitializeDecoder(decoder, &cmdParams);
+
+            // settings は送受信データの大きさに収まるように分割して送る
+            const size_t payloadLimit = IN_OUT_DATA_SIZE - 100;
+            for (size_t pos = 0; pos < settings.size(); pos += payloadLimit) {
+                std::wstring prefix = pos == 0 ? L"presendSettings\ttrue\t" : L"presendSettings\tfalse\t";
+                if (!ExecCmd(prefix + settings.substr(pos, payloadLimit))) return false;
+            }
+            return ExecCmd(L"initializeDecoder");
+        }
+
+        void Reset(const std::wstring& initialEdit) {
+            ResetDecoder(decoder);
+            buffer = initialEdit;
+        }
+
+        // 1打鍵を処理し、その結果を編集バッファに反映する
+        void HandleDeckey(int deckey) {
+            // UI側は直前の文字列を編集バッファとして送ってくる
+            size_t len = std::min(buffer.size(), (size_t)HANDLE_DECKEY_DATA_SIZE - 1);
+            copyToArray(deckeyParams.editBufferData, buffer.substr(buffer.size() - len));
+            outParams.outString[0] = 0;
+            outParams.numBackSpaces = 0;
+            outParams.resultFlags = 0;
+            HandleDeckeyDecoder(decoder, &deckeyParams, deckey, 0, 0, &outParams);
+        }
+
+        void ApplyOutput() {
+            if (outParams.resultFlags & (UINT32)1) {
+                // DeckeyToVkey: UI側がキーをそのまま送るので、編集バッファは変えない
+                ++vkeyCount;
+                return;
+            }
+            size_t numBS = std::min((size_t)std::max(outParams.numBackSpaces, 0), buffer.size());
+            buffer.resize(buffer.size() - numBS);
+            buffer += fromArray(outParams.outString);
+        }
+
+        std::wstring LastOutput() const {
+            return fromArray(outParams.outString);
+        }
+
+        int LastNumBackSpaces() const {
+            return outParams.numBackSpaces;
+        }
+    };
+
+    double percentile(const std::vector<double>& sorted, double p) {
+        if (sorted.empty()) return 0;
+        size_t n = (size_t)(p / 100.0 * (double)(sorted.size() - 1) + 0.5);
+        return sorted[std::min(n, sorted.size() - 1)];
+    }
+}
+
+// この実行ファイル内のアロケーションを数えるための置き換え
+void* operator new(size_t size) {
+    allocCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+int main(int argc, char** argv) {
+    Options opts;
+    if (!parseOptions(argc, argv, opts)) {
+        usage();
+        return 2;
+    }
+
+    std::wstring settings;
+    std::vector<int> deckeys;
+    if (!loadSettings(opts, settings) || !loadDeckeys(opts.deckeyFile, deckeys)) return 2;
+
+    std::wstring expected;
+    bool bExpected = !opts.expectedFile.empty();
+    if (bExpected) {
+        std::string contents;
+        if (!readFile(opts.expectedFile, contents)) {
+            std::cerr << "cannot read expected file: " << opts.expectedFile << std::endl;
+            return 2;
+        }
+        while (!contents.empty() && (contents.back() == '\n' || contents.back() == '\r')) contents.pop_back();
+        expected = fromUtf8(contents);
+    }
+
+    DecoderDriver driver;
+    auto t0 = std::chrono::steady_clock::now();
+    if (!driver.Create(opts.logLevel, settings)) return 2;
+    double initMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    for (const auto& cmd : opts.preCommands) {
+        if (!driver.ExecCmd(fromUtf8(cmd))) return 2;
+    }
+
+    std::wstring initialEdit = fromUtf8(opts.initialEdit);
+    for (int w = 0; w < opts.warmups; ++w) {
+        driver.Reset(initialEdit);
+        for (int deckey : deckeys) {
+            driver.HandleDeckey(deckey);
+            driver.ApplyOutput();
+        }
+    }
+
+    driver.vkeyCount = 0;
+
+    std::vector<double> latencies;
+    latencies.reserve(deckeys.size() * opts.passes);
+    size_t totalAllocs = 0;
+    size_t maxAllocs = 0;
+    double totalUs = 0;
+    int mismatches = 0;
+    std::wstring firstResult;
+
+    for (int pass = 0; pass < opts.passes; ++pass) {
+        driver.Reset(initialEdit);
+        for (int deckey : deckeys) {
+            size_t allocs0 = allocCount.load(std::memory_order_relaxed);
+            auto start = std::chrono::steady_clock::now();
+            driver.HandleDeckey(deckey);
+            auto end = std::chrono::steady_clock::now();
+            size_t allocs = allocCount.load(std::memory_order_relaxed) - allocs0;
+
+            double us = std::chrono::duration<double, std::micro>(end - start).count();
+            latencies.push_back(us);
+            totalUs += us;
+            totalAllocs += allocs;
+            maxAllocs = std::max(maxAllocs, allocs);
+
+            driver.ApplyOutput();
+            if (opts.verbose && pass == 0) {
+                std::cout << "STEP key=" << deckey << " out='" << toUtf8(driver.LastOutput()) << "' numBS=" << driver.LastNumBackSpaces()
+                    << " buffer='" << toUtf8(driver.buffer) << "' us=" << us << " allocs=" << allocs << "\n";
+            }
+        }
+        if (pass == 0) firstResult = driver.buffer;
+        if (bExpected && driver.buffer != expected) ++mismatches;
+    }
+
+    for (const auto& cmd : opts.postCommands) {
+        if (!driver.ExecCmd(fromUtf8(cmd))) return 2;
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    size_t nKeys = latencies.size();
+
+    std::printf("init: %.1f ms\n", initMs);
+    std::printf("keys: %zu x %d passes (warmup %d)\n", deckeys.size(), opts.passes, opts.warmups);
+    std::printf("latency(us): min=%.1f p50=%.1f p90=%.1f p99=%.1f p99.9=%.1f max=%.1f mean=%.1f\n",
+        percentile(latencies, 0), percentile(latencies, 50), percentile(latencies, 90), percentile(latencies, 99),
+        percentile(latencies, 99.9), percentile(latencies, 100), nKeys ? totalUs / (double)nKeys : 0.0);
+    std::printf("throughput: %.0f keys/s\n", totalUs > 0 ? (double)nKeys * 1e6 / totalUs : 0.0);
+    std::printf("allocations: total=%zu per-key=%.2f max=%zu\n", totalAllocs, nKeys ? (double)totalAllocs / (double)nKeys : 0.0, maxAllocs);
+    std::printf("vkeys: %zu\n", driver.vkeyCount / (size_t)opts.passes);
+    std::printf("final: '%s'\n", toUtf8(firstResult).c_str());
+
+    if (bExpected) {
+        if (mismatches > 0) {
+            std::printf("result: MISMATCH (%d/%d passes)\nexpected: '%s'\n", mismatches, opts.passes, toUtf8(expected).c_str());
+            return 1;
+        }
+        std::printf("result: OK\n");
+    }
+    return 0;
+}
@@ -0,0 +1,45 @@
+# 解候補ログのテスト (ctest から実行する)
+#
+#   cmake -DREPLAY=<deckey-replay> -DDUMP=<candlog-dump> -DDATA_DIR=<testdata> -DNAME=<name> -DROOT=<rootDir> -P check_candlog.cmake
+#
+# <NAME>.deckeys.txt を解候補ログを有効にして再生し、saveCandidateLog で書き出させる。
+# 直前の打鍵のテキスト (mergerCandidateFile) と、バイナリ (.bin) を candlog-dump -l でテキストにしたものの両方が、
+# <NAME>.candlog.expected.txt (以前のテキスト形式の解候補ログで記録したもの) と一致することを確かめる
+
+foreach(var REPLAY DUMP DATA_DIR NAME ROOT)
+    if(NOT DEFINED ${var})
+        message(FATAL_ERROR "${var} is not specified")
+    endif()
+endforeach()
+
+function(run_tool)
+    execute_process(COMMAND ${ARGN} WORKING_DIRECTORY ${ROOT} RESULT_VARIABLE rc OUTPUT_VARIABLE out ERROR_VARIABLE out)
+    if(NOT rc EQUAL 0)
+        message(FATAL_ERROR "failed (${rc}): ${ARGN}\n${out}")
+    endif()
+endfunction()
+
+# 末尾の改行は比較しない
+function(read_text path var)
+    file(READ ${path} text)
+    string(REGEX REPLACE "[\r\n]+$" "" text "${text}")
+    set(${var} "${text}" PARENT_SCOPE)
+endfunction()
+
+function(check_text path expected)
+    read_text(${path} actual)
+    if(NOT actual STREQUAL expected)
+        message(FATAL_ERROR "candidate log mismatch: ${path}\n--- expected ---\n${expected}\n--- actual ---\n${actual}")
+    endif()
+endfunction()
+
+set(logFile ${ROOT}/candlog.txt)
+file(REMOVE ${logFile} ${logFile}.bin ${logFile}.dump.txt)
+
+run_tool(${REPLAY} -s ${DATA_DIR}/settings.txt -r ${ROOT} -k ${DATA_DIR}/${NAME}.deckeys.txt
+    -D multiCandidateMode=true -D mergerCandidateFile=candlog.txt -c enableCandidateLog -a saveCandidateLog)
+run_tool(${DUMP} ${logFile}.bin -l -o ${logFile}.dump.txt)
+
+read_text(${DATA_DIR}/${NAME}.candlog.expected.txt expected)
+check_text(${logFile} "${expected}")
+check_text(${logFile}.dump.txt "${expected}")
@@ -0,0 +1,45 @@
+# deckey-replay のテスト用の rootDir を作る (ctest の FIXTURES_SETUP から実行する)
+#
+#   cmake -DDYMAZ=<dymaz> -DNGRAMER=<ngramer> -DDATA_DIR=<testdata> -DTABLE=<tableFile> -DROOT=<rootDir> -P make_root.cmake
+#
+# 形態素辞書と Ngram辞書は、testdata の小さなソースからその場でビルドする
+
+foreach(var DYMAZ NGRAMER DATA_DIR TABLE ROOT)
+    if(NOT DEFINED ${var})
+        message(FATAL_ERROR "${var} is not specified")
+    endif()
+endforeach()
+
+function(run_tool)
+    execute_process(COMMAND ${ARGN} RESULT_VARIABLE rc OUTPUT_VARIABLE out ERROR_VARIABLE out)
+    if(NOT rc EQUAL 0)
+        message(FATAL_ERROR "failed (${rc}): ${ARGN}\n${out}")
+    endif()
+endfunction()
+
+set(work ${ROOT}/work)
+set(mazeSrc ${work}/mazedic/)
+set(mazeDic ${ROOT}/dymazin/dic/mazedic/)
+set(ngramSrc ${work}/ngram/)
+set(ngramDic ${ROOT}/ngram/dic/)
+
+file(REMOVE_RECURSE ${ROOT})
+file(MAKE_DIRECTORY ${ROOT}/tmp ${ROOT}/dymazin/etc ${mazeSrc} ${mazeDic} ${ngramSrc} ${ngramDic})
+
+# テーブル (デコーダは rootDir/tmp/tableFile1.tbl を読む)
+configure_file(${DATA_DIR}/${TABLE} ${ROOT}/tmp/tableFile1.tbl COPYONLY)
+
+# 形態素辞書
+# - matrix.def.csv も *.csv なので、システム辞書をビルドする前に取り除く
+file(TOUCH ${ROOT}/dymazin/etc/morphrc)
+configure_file(${DATA_DIR}/mazedic/dicrc ${mazeDic}dicrc COPYONLY)
+file(COPY ${DATA_DIR}/mazedic/dicrc ${DATA_DIR}/mazedic/matrix.def.csv ${DATA_DIR}/mazedic/unk.def DESTINATION ${mazeSrc})
+run_tool(${DYMAZ} make-dict -d ${mazeSrc} -o ${mazeDic} --build-matrix)
+run_tool(${DYMAZ} make-dict -d ${mazeSrc} -o ${mazeDic} --build-unknown)
+file(REMOVE ${mazeSrc}matrix.def.csv)
+file(COPY ${DATA_DIR}/mazedic/maze.csv DESTINATION ${mazeSrc})
+run_tool(${DYMAZ} make-dict -d ${mazeSrc} -o ${mazeDic} --build-sysdic)
+
+# Ngram辞書
+file(COPY ${DATA_DIR}/ngram/ngram-sys-source.txt DESTINATION ${ngramSrc})
+run_tool(${NGRAMER} make-dict -d ${ngramSrc} -o ${ngramDic})
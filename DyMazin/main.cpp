@@ -30,7 +30,7 @@ int main(int argc, const char** argv) {
         args.push_back(utf8_decode(argv[i]));
     }
 
-    String logFile = RegexUtil(L"exe$").replace(args[0], L"log");
+    String logFile = std::filesystem::path(args[0]).replace_extension(L".log").wstring();
 
     //std::wcerr << L"logFile=" << logFile << std::endl;
 
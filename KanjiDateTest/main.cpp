@@ -0,0 +1,148 @@
+// kanji-date-test: 漢数字による日付パターンの DFA (Lattice2_KanjiDate.h) が、以前の std::wregex と同じ判定をするか確かめる
+//
+// 漢数字・年・月・日とそれ以外の文字からなる文字列を網羅的・ランダムに生成し、下記を突き合わせる
+//   - 全体一致: isKanjiDateTime() と std::regex_match
+//   - 部分一致: 各位置での datePatternMatchedLen() と、以前の std::regex_search によるマッチ長
+//
+// 使い方:
+//   kanji-date-test [-n <randomCount>] [-s <seed>]
+//   (不一致があれば、その文字列を表示して 1 を返す)
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <regex>
+#include <string>
+
+#include "Lattice2_KanjiDate.h"
+
+namespace {
+    const std::wstring kanjiNumChars = L"一二三四五六七八九十〇";
+
+    // 以前の Lattice2_Ngram.cpp で使っていた正規表現
+    const std::wregex kanjiDateTime(L"[一二三四五六七八九十〇](年[一二三四五六七八九十〇]+月([一二三四五六七八九十〇]+日)?|月[一二三四五六七八九十〇]+日|[一二三四五六七八九十〇]日)");
+
+    bool oldIsKanjiDateTime(const std::wstring& str) {
+        return std::regex_match(str, kanjiDateTime);
+    }
+
+    size_t oldDatePatternMatchedLen(const std::wstring& str, size_t pos) {
+        if (pos < str.size() && kanjiNumChars.find(str[pos]) != std::wstring::npos) {
+            std::wsmatch results;
+            std::wstring s = str.substr(pos);
+            if (std::regex_search(s, results, kanjiDateTime)) {
+                return (size_t)results.length(0);
+            }
+        }
+        return 0;
+    }
+
+    // 生成に使う文字 (漢数字の種類による違いはないので、2種類だけにして網羅の組合せを減らす)
+    const wchar_t alphabet[] = { L'一', L'〇', L'年', L'月', L'日', L'あ' };
+    const size_t alphabetSize = sizeof(alphabet) / sizeof(alphabet[0]);
+
+    MString toMString(const std::wstring& ws) {
+        MString ms;
+        for (wchar_t ch : ws) ms.push_back((mchar_t)ch);
+        return ms;
+    }
+
+    std::string toUtf8(const std::wstring& ws) {
+        std::string out;
+        for (wchar_t wc : ws) {
+            uint32_t ch = (uint32_t)wc;
+            if (ch < 0x80) {
+                out.push_back((char)ch);
+            } else if (ch < 0x800) {
+                out.push_back((char)(0xc0 | (ch >> 6)));
+                out.push_back((char)(0x80 | (ch & 0x3f)));
+            } else {
+                out.push_back((char)(0xe0 | (ch >> 12)));
+                out.push_back((char)(0x80 | ((ch >> 6) & 0x3f)));
+                out.push_back((char)(0x80 | (ch & 0x3f)));
+            }
+        }
+        return out;
+    }
+
+    struct Checker {
+        size_t numChecked = 0;
+        size_t numFailed = 0;
+
+        void check(const std::wstring& ws) {
+            ++numChecked;
+            MString ms = toMString(ws);
+            bool oldFull = oldIsKanjiDateTime(ws);
+            bool newFull = lattice2::isKanjiDateTime(ms);
+            if (oldFull != newFull) {
+                report(ws, "full match", oldFull, newFull);
+            }
+            for (size_t pos = 0; pos <= ws.size(); ++pos) {
+                size_t oldLen = oldDatePatternMatchedLen(ws, pos);
+                size_t newLen = lattice2::datePatternMatchedLen(ms, pos);
+                if (oldLen != newLen) {
+                    report(ws, ("search at pos=" + std::to_string(pos)).c_str(), oldLen, newLen);
+                }
+            }
+        }
+
+        void report(const std::wstring& ws, const char* what, size_t oldVal, size_t newVal) {
+            if (numFailed++ < 20) {
+                std::cerr << "MISMATCH (" << what << "): '" << toUtf8(ws) << "': regex=" << oldVal << ", dfa=" << newVal << "\n";
+            }
+        }
+    };
+
+    // 長さ len 以下のすべての文字列
+    void checkExhaustive(Checker& checker, std::wstring& ws, size_t len) {
+        checker.check(ws);
+        if (ws.size() >= len) return;
+        for (size_t i = 0; i < alphabetSize; ++i) {
+            ws.push_back(alphabet[i]);
+            checkExhaustive(checker, ws, len);
+            ws.pop_back();
+        }
+    }
+
+    // 漢数字の比率を高めにした、長めのランダムな文字列
+    void checkRandom(Checker& checker, size_t count, unsigned seed) {
+        std::mt19937 rng(seed);
+        std::uniform_int_distribution<size_t> lenDist(0, 24);
+        std::uniform_int_distribution<size_t> classDist(0, 9);
+        std::uniform_int_distribution<size_t> numDist(0, kanjiNumChars.size() - 1);
+        const wchar_t others[] = { L'年', L'月', L'日', L'あ', L'時', L'1' };
+        std::uniform_int_distribution<size_t> otherDist(0, sizeof(others) / sizeof(others[0]) - 1);
+        for (size_t n = 0; n < count; ++n) {
+            std::wstring ws;
+            size_t len = lenDist(rng);
+            for (size_t i = 0; i < len; ++i) {
+                ws.push_back(classDist(rng) < 6 ? kanjiNumChars[numDist(rng)] : others[otherDist(rng)]);
+            }
+            checker.check(ws);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t randomCount = 20000;
+    unsigned seed = 12345;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-n" && i + 1 < argc) {
+            randomCount = (size_t)std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "-s" && i + 1 < argc) {
+            seed = (unsigned)std::strtoul(argv[++i], nullptr, 10);
+        } else {
+            std::cerr << "usage: kanji-date-test [-n <randomCount>] [-s <seed>]\n";
+            return 2;
+        }
+    }
+
+    Checker checker;
+    std::wstring ws;
+    checkExhaustive(checker, ws, 7);
+    checkRandom(checker, randomCount, seed);
+
+    std::cout << "checked " << checker.numChecked << " strings, " << checker.numFailed << " mismatches\n";
+    return checker.numFailed == 0 ? 0 : 1;
+}
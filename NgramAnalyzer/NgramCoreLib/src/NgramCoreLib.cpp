@@ -120,6 +120,15 @@ namespace NgramCoreLib {
         return RealtimeDict::updateEntry(word, delta);
     }
 
+    // リアルタイムNgramエントリの一括更新
+    // @param sentence 対象の文字列
+    // @param spans 更新する部分文字列の、sentence 中の (オフセット, 長さ) を順に詰めて並べたもの
+    // @param delta 各エントリに加算する値
+    // @return 更新したエントリの数
+    int UpdateRealtimeEntries(StringRef sentence, const std::vector<size_t>& spans, int delta) {
+        return RealtimeDict::updateEntries(sentence, spans, delta);
+    }
+
     // リアルタイムNgram辞書のロード
     // @param ngramFilePath リアルタイムNgramファイルのパス
     int LoadRealtimeDict(StringRef ngramFilePath) {
@@ -140,6 +149,27 @@ namespace NgramCoreLib {
         return result;
     }
 
+    struct NgramDictGeneration {
+        RealtimeDict::DictGeneration gen;
+    };
+
+    // リアルタイムNgram辞書とユーザーNgram辞書を、現在の辞書とは別に読み込む
+    // @param realtimeNgramPath リアルタイムNgramファイルのパス
+    // @param userNgramPath ユーザーNgramファイルのパス
+    SharedPtr<NgramDictGeneration> PrepareNgramDicts(StringRef realtimeNgramPath, StringRef userNgramPath) {
+        LOG_INFOH(L"ENTER");
+        auto generation = MakeShared<NgramDictGeneration>();
+        RealtimeDict::readRealtimeNgramFile(realtimeNgramPath, generation->gen);
+        RealtimeDict::readUserNgramFile(userNgramPath, generation->gen);
+        LOG_INFOH(L"LEAVE: realtime={}, user={}", generation->gen.nRealtimeEntries, generation->gen.nUserEntries);
+        return generation;
+    }
+
+    // PrepareNgramDicts() で読み込んだ辞書に差し替える
+    void InstallNgramDicts(NgramDictGeneration& generation) {
+        RealtimeDict::swapGeneration(generation.gen);
+    }
+
     // リアルタイムNgramファイルの保存
     // @param ngramFilePath リアルタイムNgramファイルのパス
     // @param rotationNum 過去履歴の保存数 (0 なら保存しない)
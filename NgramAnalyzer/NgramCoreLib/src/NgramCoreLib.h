@@ -19,6 +19,15 @@ namespace NgramCoreLib {
     // @param ngramFilePath ユーザーNgramファイルのパス
     int LoadUserNgram(StringRef ngramFilePath);
 
+    // バックグラウンドで読み込んだリアルタイムNgram辞書とユーザーNgram辞書
+    struct NgramDictGeneration;
+
+    // リアルタイムNgram辞書とユーザーNgram辞書を、現在の辞書とは別に読み込む (現在の辞書は変更しない)
+    SharedPtr<NgramDictGeneration> PrepareNgramDicts(StringRef realtimeNgramPath, StringRef userNgramPath);
+
+    // PrepareNgramDicts() で読み込んだ辞書に差し替える。それまでの辞書は generation に移る
+    void InstallNgramDicts(NgramDictGeneration& generation);
+
     // リアルタイムNgramファイルの保存
     // @param ngramFilePath リアルタイムNgramファイルのパス
     // @param rotationNum 過去履歴の保存数 (0 なら保存しない)
@@ -29,6 +38,13 @@ namespace NgramCoreLib {
     // @return 更新後のエントリの値
     int UpdateRealtimeEntry(const String& word, int delta);
 
+    // リアルタイムNgramエントリの一括更新
+    // @param sentence 対象の文字列
+    // @param spans 更新する部分文字列の、sentence 中の (オフセット, 長さ) を順に詰めて並べたもの
+    // @param delta 各エントリに加算する値
+    // @return 更新したエントリの数
+    int UpdateRealtimeEntries(StringRef sentence, const std::vector<size_t>& spans, int delta);
+
     // ユーザー辞書の再オープン
     int NgramReloadUserDics(wchar_t* errMsgBuf, size_t bufsiz);
 
@@ -1,3 +1,5 @@
+#include <atomic>
+
 #include "std_utils.h"
 #include "file_utils.h"
 #include "string_utils.h"
@@ -22,7 +24,8 @@ namespace analyzer {
         size_t minLen = 1;  // 最小N-gram長
         size_t maxLen = 4;  // 最大N-gram長
 
-        int ngramInflexBonusPoint = 25;         // Ngramに与えるボーナスポイントの変曲点
+        // ユーザー定義Ngramファイルの読み込みはバックグラウンドでも行われるので atomic にしておく
+        std::atomic<int> ngramInflexBonusPoint = 25;         // Ngramに与えるボーナスポイントの変曲点
         int ngramBonusPointFactor = 100;        // ボーナスポイントに対するボーナス係数
 
         int maxRealtimeCount = 0;  // リアルタイムN-gramの最大カウント (ユーザー定義のN-gramのカウントは含まない)
@@ -48,16 +51,40 @@ namespace analyzer {
             return count;
         }
 
+        int updateEntries(StringRef sentence, const std::vector<size_t>& spans, int delta) {
+            LOG_DEBUGH(L"ENTER: sentence={}, spans={}, delta={}", sentence, spans.size() / 2, delta);
+            // キーの作業領域 (短い Ngram なら、割り当て済みの領域に収まる)
+            String key;
+            int nUpdated = 0;
+            for (size_t i = 0; i + 1 < spans.size(); i += 2) {
+                size_t offset = spans[i];
+                size_t length = spans[i + 1];
+                if (length == 0 || offset + length > sentence.size()) continue;
+                key.assign(sentence, offset, length);
+                auto iter = realtimeDict.find(key);
+                if (iter == realtimeDict.end()) iter = realtimeDict.emplace(key, 0).first;
+                int count = iter->second += delta;
+                if (count > kMaxNgramBonus) {
+                    maxRealtimeCount = count;
+                }
+                LOG_DEBUG(L"word={}, count={}", key, count);
+                ++nUpdated;
+            }
+            if (nUpdated > 0) realtimeNgram_updated = true;
+            LOG_DEBUGH(L"LEAVE: updated={}", nUpdated);
+            return nUpdated;
+        }
+
         inline bool isDecimalString(StringRef item) {
             return utils::reMatch(item, L"[+\\-]?[0-9]+");
         }
 
-        // リアルタイムNgramファイルのロード
-        int loadRealtimeNgramFile(StringRef ngramFilePath) {
+        // リアルタイムNgramファイルを読み込んで gen に格納する
+        void readRealtimeNgramFile(StringRef ngramFilePath, DictGeneration& gen) {
             LOG_INFOH(_T("LOAD: {}"), ngramFilePath);
-            int nEntries = 0;
-            realtimeDict.clear();
-            maxRealtimeCount = 0;
+            gen.realtimeDict.clear();
+            gen.maxRealtimeCount = 0;
+            gen.nRealtimeEntries = 0;
             utils::IfstreamReader reader(ngramFilePath);
             if (reader.success()) {
                 for (const auto& line : reader.getAllLines()) {
@@ -66,30 +93,30 @@ namespace analyzer {
                         String sCount = items[1];
                         if (isDecimalString(sCount)) {
                             int count = std::stoi(sCount);
-                            realtimeDict[items[0]] = count;
-                            if (count > maxRealtimeCount) {
-                                maxRealtimeCount = count;
+                            gen.realtimeDict[items[0]] = count;
+                            if (count > gen.maxRealtimeCount) {
+                                gen.maxRealtimeCount = count;
                             }
-                            ++nEntries;
+                            ++gen.nRealtimeEntries;
                         }
                     }
                 }
             }
-            LOG_INFOH(_T("DONE: nEntries={}"), nEntries);
-            return nEntries;
+            LOG_INFOH(_T("DONE: nEntries={}"), gen.nRealtimeEntries);
         }
 
-        // ユーザー定義のNgramファイルのロード
-        int loaUserdNgramFile(StringRef ngramFilePath) {
+        // ユーザー定義のNgramファイルを読み込んで gen に格納する
+        void readUserNgramFile(StringRef ngramFilePath, DictGeneration& gen) {
             LOG_INFOH(_T("LOAD: {}"), ngramFilePath);
-            int nEntries = 0;
-            userDict.clear();
+            gen.userDict.clear();
+            gen.nUserEntries = 0;
+            int defaultCount = ngramInflexBonusPoint;  // ユーザー定義のN-gramは、デフォルトで最大ボーナスポイントを与える
             utils::IfstreamReader reader(ngramFilePath);
             if (reader.success()) {
                 for (const auto& line : reader.getAllLines()) {
                     auto items = utils::split(utils::replace_all(utils::strip(line), L" +", L"\t"), '\t');
                     if (items.size() >= 1 && !items[0].empty() && items[0][0] != L'#') {
-                        int count = ngramInflexBonusPoint;  // ユーザー定義のN-gramは、デフォルトで最大ボーナスポイントを与える
+                        int count = defaultCount;
                         if (items.size() > 1 && !items[1].empty()) {
                             String sCount = items[1];
                             if (isDecimalString(sCount)) {
@@ -97,22 +124,45 @@ namespace analyzer {
                             }
                         }
                         StringRef word = items[0];
-                        userDict[word] = count;
-                        userDict[L"〓" + word] = count;
+                        gen.userDict[word] = count;
+                        gen.userDict[L"〓" + word] = count;
                         if (word.size() >= 6) {
                             // 6gram以上なら、5gramに分割して登録する
                             size_t len = 5;
                             for (size_t pos = 0; pos + len <= word.size(); ++pos) {
                                 LOG_DEBUGH(_T("register SUB 5gram: sub 5gram={}, count={}"), word.substr(pos, len), count);
-                                userDict[word.substr(pos, len)] = count;
+                                gen.userDict[word.substr(pos, len)] = count;
                             }
                         }
-                        ++nEntries;
+                        ++gen.nUserEntries;
                     }
                 }
             }
-            LOG_INFOH(_T("DONE: nEntries={}"), nEntries);
-            return nEntries;
+            LOG_INFOH(_T("DONE: nEntries={}"), gen.nUserEntries);
+        }
+
+        // 現在の辞書と gen を入れ替える
+        void swapGeneration(DictGeneration& gen) {
+            realtimeDict.swap(gen.realtimeDict);
+            userDict.swap(gen.userDict);
+            std::swap(maxRealtimeCount, gen.maxRealtimeCount);
+        }
+
+        // リアルタイムNgramファイルのロード
+        int loadRealtimeNgramFile(StringRef ngramFilePath) {
+            DictGeneration gen;
+            readRealtimeNgramFile(ngramFilePath, gen);
+            realtimeDict.swap(gen.realtimeDict);
+            maxRealtimeCount = gen.maxRealtimeCount;
+            return gen.nRealtimeEntries;
+        }
+
+        // ユーザー定義のNgramファイルのロード
+        int loaUserdNgramFile(StringRef ngramFilePath) {
+            DictGeneration gen;
+            readUserNgramFile(ngramFilePath, gen);
+            userDict.swap(gen.userDict);
+            return gen.nUserEntries;
         }
 
         // リアルタイムNgramファイルの保存
@@ -175,18 +225,19 @@ namespace analyzer {
 
         // ユーザー定義のN-gramのカウントからボーナスポイントを計算する。カウントが大きくなるほど、ボーナスポイントの増加は緩やかになるようにする。
         int calcUserBonus(int bonusPoint) {
+            const int inflex = ngramInflexBonusPoint;
             double point = bonusPoint;
-            if (point > ngramInflexBonusPoint) {
-                if (point <= ngramInflexBonusPoint * 2) {
-                    point = ngramInflexBonusPoint + (point - ngramInflexBonusPoint) * 0.4;
-                } else if (point <= ngramInflexBonusPoint * 4) {
-                    point = ngramInflexBonusPoint * 1.4 + (point - ngramInflexBonusPoint * 2) * 0.2;
-                } else if (point <= ngramInflexBonusPoint * 40) {
-                    point = ngramInflexBonusPoint * 1.8 + (point - ngramInflexBonusPoint * 4) * 0.1;
-                } else if (point <= ngramInflexBonusPoint * 400) {
-                    point = ngramInflexBonusPoint * 2.16 + (point - ngramInflexBonusPoint * 40) * 0.02;
+            if (point > inflex) {
+                if (point <= inflex * 2) {
+                    point = inflex + (point - inflex) * 0.4;
+                } else if (point <= inflex * 4) {
+                    point = inflex * 1.4 + (point - inflex * 2) * 0.2;
+                } else if (point <= inflex * 40) {
+                    point = inflex * 1.8 + (point - inflex * 4) * 0.1;
+                } else if (point <= inflex * 400) {
+                    point = inflex * 2.16 + (point - inflex * 40) * 0.02;
                 } else {
-                    point = ngramInflexBonusPoint * 9.36 + (point - ngramInflexBonusPoint * 400) * 0.01;
+                    point = inflex * 9.36 + (point - inflex * 400) * 0.01;
                 }
             }
             return (int)(point * ngramBonusPointFactor);
@@ -17,6 +17,13 @@ namespace analyzer {
         // @return 更新後のエントリの値
         int updateEntry(const String& word, int delta);
 
+        // リアルタイムNgramエントリの一括更新
+        // @param sentence 対象の文字列
+        // @param spans 更新する部分文字列の、sentence 中の (オフセット, 長さ) を順に詰めて並べたもの
+        // @param delta 各エントリに加算する値
+        // @return 更新したエントリの数
+        int updateEntries(StringRef sentence, const std::vector<size_t>& spans, int delta);
+
         // リアルタイムNgramファイルのロード
         // @param ngramFilePath リアルタイムNgramファイルのパス
         // @return ロードされたエントリの数
@@ -25,6 +32,24 @@ namespace analyzer {
         // ユーザー定義のNgramファイルのロード
         int loaUserdNgramFile(StringRef ngramFilePath);
 
+        // 辞書の1世代分 -- 現在の辞書とは別に読み込んでおいて、swapGeneration() で差し替える
+        struct DictGeneration {
+            std::map<String, int> realtimeDict;
+            std::map<String, int> userDict;
+            int maxRealtimeCount = 0;
+            int nRealtimeEntries = 0;
+            int nUserEntries = 0;
+        };
+
+        // リアルタイムNgramファイルを読み込んで gen に格納する (現在の辞書は変更しない)
+        void readRealtimeNgramFile(StringRef ngramFilePath, DictGeneration& gen);
+
+        // ユーザー定義のNgramファイルを読み込んで gen に格納する (現在の辞書は変更しない)
+        void readUserNgramFile(StringRef ngramFilePath, DictGeneration& gen);
+
+        // 現在の辞書と gen を入れ替える (それまでの辞書は gen に移る)
+        void swapGeneration(DictGeneration& gen);
+
         // リアルタイムNgramファイルの保存
         // @param ngramFilePath リアルタイムNgramファイルのパス
         void saveNgramFile(StringRef ngramFilePath, int rotationNum);
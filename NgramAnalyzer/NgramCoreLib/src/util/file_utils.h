@@ -54,7 +54,12 @@ namespace utils {
         virtual void deserialize(IfstreamReader& reader) = 0;
     };
 
+#ifdef _WIN32
 #define ULONG unsigned long
+#else
+// ファイル上では Windows と同じく4バイトで読み書きする
+#define ULONG uint32_t
+#endif
 
     // ifstream の reader
     class IfstreamReader {
@@ -80,7 +85,7 @@ namespace utils {
         inline bool open(StringRef filepath) {
             std::ios_base::openmode openMode = std::ios_base::in;
             if (_binary) openMode = openMode | std::ios_base::binary;
-            _ifs.open(filepath, openMode);
+            _ifs.open(std::filesystem::path(filepath), openMode);
             _fail = _ifs.fail();
             _cin = false;
             return success();
@@ -132,14 +137,14 @@ namespace utils {
         }
 
         // read unsigned long
-        inline unsigned long read_ulong() {
+        inline ULONG read_ulong() {
             ULONG _value;
             _ifs.read(reinterpret_cast<char*>(&_value), sizeof(ULONG));
             return _value;
         }
 
         // read unsigned long
-        inline void read(unsigned long& value) {
+        inline void read(ULONG& value) {
             value = read_ulong();
         }
 
@@ -298,7 +303,7 @@ namespace utils {
         inline bool open(StringRef filepath) {
             std::ios_base::openmode openMode = _append ? std::ios_base::app : std::ios_base::out;
             if (_binary) openMode = openMode | std::ios_base::binary;
-            ofs.open(filepath, openMode);
+            ofs.open(std::filesystem::path(filepath), openMode);
             _fail = ofs.fail();
             return success();
         }
@@ -1,6 +1,6 @@
 #include "path_utils.h"
 
-#include "Reporting/Logger.h"
+#include "reporting/Logger.h"
 #include <algorithm>
 #include <array>
 #include <chrono>
@@ -0,0 +1,429 @@
+#pragma once
+
+// Windows 以外でビルドするときに <windows.h> の代わりに読み込まれる互換ヘッダ
+// kw-uni / DyMazinLib / NgramCoreLib が使っている Win32 API と CRT 拡張だけを、POSIX と標準ライブラリで実装する
+// (CMake が Windows 以外のときだけ、このディレクトリをインクルードパスに加える)
+
+#ifndef _WIN32
+
+#include <cerrno>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <cwchar>
+#include <cwctype>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+// -------------------------------------------------------------------
+// 型とマクロ
+typedef int BOOL;
+typedef unsigned char UCHAR;
+typedef unsigned short WORD;
+typedef unsigned int UINT;
+typedef uint32_t UINT32;
+typedef uint32_t DWORD;
+typedef long LONG;
+typedef void* HANDLE;
+typedef void* HMODULE;
+typedef void* LPVOID;
+typedef const void* LPCVOID;
+typedef wchar_t TCHAR;
+typedef wchar_t* LPWSTR;
+typedef const wchar_t* LPCWSTR;
+typedef int errno_t;
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+#define WINAPI
+#define APIENTRY
+#define MAX_PATH 260
+#define _TRUNCATE ((size_t)-1)
+#define _countof(a) (sizeof(a) / sizeof((a)[0]))
+
+// dllexport/dllimport は、共有ライブラリから公開するシンボルの可視性に読み替える
+#define __declspec(x) __attribute__((visibility("default")))
+
+#define DLL_PROCESS_DETACH 0
+#define DLL_PROCESS_ATTACH 1
+#define DLL_THREAD_ATTACH 2
+#define DLL_THREAD_DETACH 3
+
+#define CP_UTF8 65001
+
+// -------------------------------------------------------------------
+// CRT のセキュア関数
+inline errno_t wcsncpy_s(wchar_t* dest, size_t destSize, const wchar_t* src, size_t count) {
+    if (!dest || destSize == 0) return EINVAL;
+    size_t len = src ? wcslen(src) : 0;
+    if (count != _TRUNCATE && count < len) len = count;
+    if (len >= destSize) len = destSize - 1;
+    if (len > 0) wmemcpy(dest, src, len);
+    dest[len] = 0;
+    return 0;
+}
+
+inline errno_t wcscpy_s(wchar_t* dest, size_t destSize, const wchar_t* src) {
+    return wcsncpy_s(dest, destSize, src, _TRUNCATE);
+}
+
+template<size_t N>
+inline errno_t wcscpy_s(wchar_t (&dest)[N], const wchar_t* src) {
+    return wcsncpy_s(dest, N, src, _TRUNCATE);
+}
+
+template<size_t N>
+inline errno_t wcsncpy_s(wchar_t (&dest)[N], const wchar_t* src, size_t count) {
+    return wcsncpy_s(dest, N, src, count);
+}
+
+inline errno_t memcpy_s(void* dest, size_t destSize, const void* src, size_t count) {
+    if (count > destSize) return ERANGE;
+    memcpy(dest, src, count);
+    return 0;
+}
+
+inline errno_t wcstombs_s(size_t* pReturnValue, char* dest, size_t destSize, const wchar_t* src, size_t count) {
+    size_t n = wcstombs(dest, src, count == _TRUNCATE || count >= destSize ? destSize - 1 : count);
+    if (n == (size_t)-1) {
+        if (dest && destSize > 0) dest[0] = 0;
+        if (pReturnValue) *pReturnValue = 0;
+        return EILSEQ;
+    }
+    if (dest) dest[n] = 0;
+    if (pReturnValue) *pReturnValue = n + 1;
+    return 0;
+}
+
+inline errno_t localtime_s(struct tm* result, const time_t* timer) {
+    return localtime_r(timer, result) ? 0 : EINVAL;
+}
+
+inline int lstrlen(const wchar_t* s) { return s ? (int)wcslen(s) : 0; }
+
+inline int lstrlenA(const char* s) { return s ? (int)strlen(s) : 0; }
+
+// -------------------------------------------------------------------
+// 文字コード変換 (CP_UTF8 だけに対応。wchar_t は UTF-32)
+inline int MultiByteToWideChar(UINT, DWORD, const char* src, int srcLen, wchar_t* dest, int destLen) {
+    if (srcLen < 0) srcLen = (int)strlen(src) + 1;
+    int n = 0;
+    for (int i = 0; i < srcLen; ) {
+        unsigned char c = (unsigned char)src[i];
+        int len = c < 0x80 ? 1 : (c >> 5) == 0x06 ? 2 : (c >> 4) == 0x0e ? 3 : (c >> 3) == 0x1e ? 4 : 0;
+        char32_t cp = 0xfffd;
+        if (len == 0 || i + len > srcLen) {
+            ++i;
+        } else {
+            cp = len == 1 ? c : len == 2 ? (c & 0x1f) : len == 3 ? (c & 0x0f) : (c & 0x07);
+            for (int k = 1; k < len; ++k) cp = (cp << 6) | ((unsigned char)src[i + k] & 0x3f);
+            i += len;
+        }
+        if (destLen > 0) {
+            if (n >= destLen) return 0;
+            dest[n] = (wchar_t)cp;
+        }
+        ++n;
+    }
+    return n;
+}
+
+inline int WideCharToMultiByte(UINT, DWORD, const wchar_t* src, int srcLen, char* dest, int destLen, const char*, BOOL*) {
+    if (srcLen < 0) srcLen = (int)wcslen(src) + 1;
+    int n = 0;
+    auto put = [&](unsigned char b) {
+        if (destLen > 0 && n < destLen) dest[n] = (char)b;
+        ++n;
+    };
+    for (int i = 0; i < srcLen; ++i) {
+        char32_t cp = (char32_t)src[i];
+        if (cp < 0x80) {
+            put((unsigned char)cp);
+        } else if (cp < 0x800) {
+            put(0xc0 | (cp >> 6));
+            put(0x80 | (cp & 0x3f));
+        } else if (cp < 0x10000) {
+            put(0xe0 | (cp >> 12));
+            put(0x80 | ((cp >> 6) & 0x3f));
+            put(0x80 | (cp & 0x3f));
+        } else {
+            put(0xf0 | (cp >> 18));
+            put(0x80 | ((cp >> 12) & 0x3f));
+            put(0x80 | ((cp >> 6) & 0x3f));
+            put(0x80 | (cp & 0x3f));
+        }
+    }
+    return destLen > 0 && n > destLen ? 0 : n;
+}
+
+namespace win32_compat {
+    inline std::string narrowPath(const wchar_t* path) {
+        return std::filesystem::path(path).string();
+    }
+}
+
+// -------------------------------------------------------------------
+// 時刻
+typedef struct {
+    DWORD dwLowDateTime;
+    DWORD dwHighDateTime;
+} FILETIME;
+
+typedef struct {
+    WORD wYear;
+    WORD wMonth;
+    WORD wDayOfWeek;
+    WORD wDay;
+    WORD wHour;
+    WORD wMinute;
+    WORD wSecond;
+    WORD wMilliseconds;
+} SYSTEMTIME;
+
+namespace win32_compat {
+    // FILETIME は 1601/01/01 からの 100ns 単位
+    const uint64_t EPOCH_DIFF_100NS = 116444736000000000ULL;
+
+    inline uint64_t toUInt64(const FILETIME* ft) {
+        return ((uint64_t)ft->dwHighDateTime << 32) | ft->dwLowDateTime;
+    }
+
+    inline void fromUInt64(uint64_t v, FILETIME* ft) {
+        ft->dwLowDateTime = (DWORD)v;
+        ft->dwHighDateTime = (DWORD)(v >> 32);
+    }
+
+    inline void toSystemTime(const struct tm& t, int msec, SYSTEMTIME* st) {
+        st->wYear = (WORD)(t.tm_year + 1900);
+        st->wMonth = (WORD)(t.tm_mon + 1);
+        st->wDayOfWeek = (WORD)t.tm_wday;
+        st->wDay = (WORD)t.tm_mday;
+        st->wHour = (WORD)t.tm_hour;
+        st->wMinute = (WORD)t.tm_min;
+        st->wSecond = (WORD)t.tm_sec;
+        st->wMilliseconds = (WORD)msec;
+    }
+}
+
+inline void GetSystemTimeAsFileTime(FILETIME* ft) {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    win32_compat::fromUInt64((uint64_t)tv.tv_sec * 10000000ULL + (uint64_t)tv.tv_usec * 10ULL + win32_compat::EPOCH_DIFF_100NS, ft);
+}
+
+inline BOOL FileTimeToLocalFileTime(const FILETIME* ft, FILETIME* localFt) {
+    uint64_t v = win32_compat::toUInt64(ft);
+    time_t sec = (time_t)((v - win32_compat::EPOCH_DIFF_100NS) / 10000000ULL);
+    struct tm t;
+    localtime_r(&sec, &t);
+    win32_compat::fromUInt64(v + (uint64_t)((int64_t)t.tm_gmtoff * 10000000LL), localFt);
+    return TRUE;
+}
+
+inline BOOL FileTimeToSystemTime(const FILETIME* ft, SYSTEMTIME* st) {
+    uint64_t v = win32_compat::toUInt64(ft) - win32_compat::EPOCH_DIFF_100NS;
+    time_t sec = (time_t)(v / 10000000ULL);
+    struct tm t;
+    gmtime_r(&sec, &t);
+    win32_compat::toSystemTime(t, (int)((v / 10000ULL) % 1000ULL), st);
+    return TRUE;
+}
+
+inline void GetLocalTime(SYSTEMTIME* st) {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    time_t sec = tv.tv_sec;
+    struct tm t;
+    localtime_r(&sec, &t);
+    win32_compat::toSystemTime(t, (int)(tv.tv_usec / 1000), st);
+}
+
+// -------------------------------------------------------------------
+// ファイル (ログの追記に使う範囲だけ)
+#define INVALID_HANDLE_VALUE ((HANDLE)(intptr_t)-1)
+#define GENERIC_WRITE 0x40000000
+#define FILE_SHARE_READ 0x00000001
+#define OPEN_ALWAYS 4
+#define FILE_ATTRIBUTE_ARCHIVE 0x00000020
+#define FILE_FLAG_SEQUENTIAL_SCAN 0x08000000
+#define FILE_FLAG_WRITE_THROUGH 0x80000000
+#define FILE_BEGIN 0
+#define FILE_CURRENT 1
+#define FILE_END 2
+
+inline HANDLE CreateFile(const wchar_t* path, DWORD, DWORD, void*, DWORD, DWORD, void*) {
+    int fd = ::open(win32_compat::narrowPath(path).c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    return fd < 0 ? INVALID_HANDLE_VALUE : (HANDLE)(intptr_t)fd;
+}
+
+inline DWORD SetFilePointer(HANDLE h, LONG distance, LONG*, DWORD method) {
+    int whence = method == FILE_END ? SEEK_END : method == FILE_CURRENT ? SEEK_CUR : SEEK_SET;
+    off_t pos = ::lseek((int)(intptr_t)h, distance, whence);
+    return pos < 0 ? (DWORD)-1 : (DWORD)pos;
+}
+
+inline BOOL WriteFile(HANDLE h, LPCVOID buf, DWORD size, DWORD* written, void*) {
+    ssize_t n = ::write((int)(intptr_t)h, buf, size);
+    if (written) *written = n < 0 ? 0 : (DWORD)n;
+    return n == (ssize_t)size;
+}
+
+inline BOOL FlushFileBuffers(HANDLE h) {
+    return ::fsync((int)(intptr_t)h) == 0;
+}
+
+inline BOOL CloseHandle(HANDLE h) {
+    return ::close((int)(intptr_t)h) == 0;
+}
+
+inline BOOL CopyFile(const wchar_t* src, const wchar_t* dest, BOOL bFailIfExists) {
+    std::error_code ec;
+    auto opt = bFailIfExists ? std::filesystem::copy_options::none : std::filesystem::copy_options::overwrite_existing;
+    return std::filesystem::copy_file(std::filesystem::path(src), std::filesystem::path(dest), opt, ec) && !ec;
+}
+
+inline DWORD GetCurrentDirectory(DWORD bufLen, wchar_t* buf) {
+    std::error_code ec;
+    std::wstring cwd = std::filesystem::current_path(ec).wstring();
+    if (ec || cwd.size() + 1 > bufLen) return ec ? 0 : (DWORD)(cwd.size() + 1);
+    wcscpy_s(buf, bufLen, cwd.c_str());
+    return (DWORD)cwd.size();
+}
+
+// -------------------------------------------------------------------
+// INI ファイル (UTF-8 として読み書きする)
+namespace win32_compat {
+    struct IniLine {
+        std::wstring section;   // 属するセクション
+        std::wstring key;       // 空ならセクション行・空行・コメント
+        std::wstring raw;       // 元の行
+    };
+
+    inline std::wstring trim(const std::wstring& s) {
+        size_t b = s.find_first_not_of(L" \t\r");
+        size_t e = s.find_last_not_of(L" \t\r");
+        return b == std::wstring::npos ? std::wstring() : s.substr(b, e - b + 1);
+    }
+
+    inline bool equalsNoCase(const std::wstring& a, const std::wstring& b) {
+        if (a.size() != b.size()) return false;
+        for (size_t i = 0; i < a.size(); ++i) {
+            if (towlower(a[i]) != towlower(b[i])) return false;
+        }
+        return true;
+    }
+
+    inline std::vector<IniLine> readIni(const wchar_t* path) {
+        std::vector<IniLine> lines;
+        std::ifstream ifs(std::filesystem::path(path), std::ios::binary);
+        std::string line;
+        std::wstring section;
+        while (std::getline(ifs, line)) {
+            if (lines.empty() && line.compare(0, 3, "\xEF\xBB\xBF") == 0) line.erase(0, 3);
+            std::wstring wline((size_t)MultiByteToWideChar(CP_UTF8, 0, line.data(), (int)line.size(), nullptr, 0), 0);
+            MultiByteToWideChar(CP_UTF8, 0, line.data(), (int)line.size(), wline.data(), (int)wline.size());
+            std::wstring t = trim(wline);
+            IniLine il{ section, L"", wline };
+            if (!t.empty() && t.front() == L'[' && t.back() == L']') {
+                section = trim(t.substr(1, t.size() - 2));
+                il.section = section;
+            } else if (!t.empty() && t.front() != L';' && t.find(L'=') != std::wstring::npos) {
+                il.key = trim(t.substr(0, t.find(L'=')));
+            }
+            lines.push_back(il);
+        }
+        return lines;
+    }
+
+    inline std::wstring iniValue(const IniLine& il) {
+        return trim(il.raw.substr(il.raw.find(L'=') + 1));
+    }
+
+    // 値を buf にコピーして、コピーした文字数を返す
+    inline DWORD copyResult(const std::wstring& s, wchar_t* buf, DWORD bufLen) {
+        if (bufLen == 0) return 0;
+        size_t len = std::min(s.size(), (size_t)bufLen - 1);
+        wmemcpy(buf, s.data(), len);
+        buf[len] = 0;
+        return (DWORD)len;
+    }
+}
+
+inline DWORD GetPrivateProfileString(const wchar_t* section, const wchar_t* key, const wchar_t* defVal, wchar_t* buf, DWORD bufLen, const wchar_t* path) {
+    for (const auto& il : win32_compat::readIni(path)) {
+        if (!il.key.empty() && win32_compat::equalsNoCase(il.section, section) && win32_compat::equalsNoCase(il.key, key)) {
+            return win32_compat::copyResult(win32_compat::iniValue(il), buf, bufLen);
+        }
+    }
+    return win32_compat::copyResult(defVal ? defVal : L"", buf, bufLen);
+}
+
+// セクション名を '\0' 区切りで並べ、最後に '\0' を2つ置く
+inline DWORD GetPrivateProfileSectionNames(wchar_t* buf, DWORD bufLen, const wchar_t* path) {
+    if (bufLen < 2) return 0;
+    std::wstring names;
+    std::wstring prev;
+    bool bFirst = true;
+    for (const auto& il : win32_compat::readIni(path)) {
+        if (!il.section.empty() && (bFirst || il.section != prev)) {
+            names += il.section;
+            names.push_back(0);
+            prev = il.section;
+            bFirst = false;
+        }
+    }
+    if (names.size() + 1 > bufLen) {
+        names.resize(bufLen - 2);
+        names.push_back(0);
+    }
+    wmemcpy(buf, names.data(), names.size());
+    buf[names.size()] = 0;
+    return (DWORD)(names.size() + 1 > bufLen ? bufLen - 2 : names.size());
+}
+
+inline BOOL WritePrivateProfileString(const wchar_t* section, const wchar_t* key, const wchar_t* value, const wchar_t* path) {
+    auto lines = win32_compat::readIni(path);
+    std::wstring newLine = std::wstring(key) + L"=" + (value ? value : L"");
+    bool bDone = false;
+    int lastInSection = -1;
+    for (size_t i = 0; i < lines.size(); ++i) {
+        if (!win32_compat::equalsNoCase(lines[i].section, section)) continue;
+        lastInSection = (int)i;
+        if (!lines[i].key.empty() && win32_compat::equalsNoCase(lines[i].key, key)) {
+            lines[i].raw = newLine;
+            bDone = true;
+            break;
+        }
+    }
+    if (!bDone) {
+        if (lastInSection < 0) {
+            lines.push_back({ section, L"", L"[" + std::wstring(section) + L"]" });
+            lastInSection = (int)lines.size() - 1;
+        }
+        lines.insert(lines.begin() + lastInSection + 1, { section, key, newLine });
+    }
+    std::ofstream ofs(std::filesystem::path(path), std::ios::binary | std::ios::trunc);
+    for (const auto& il : lines) {
+        std::string s((size_t)WideCharToMultiByte(CP_UTF8, 0, il.raw.data(), (int)il.raw.size(), nullptr, 0, nullptr, nullptr), 0);
+        WideCharToMultiByte(CP_UTF8, 0, il.raw.data(), (int)il.raw.size(), s.data(), (int)s.size(), nullptr, nullptr);
+        ofs << s << "\r\n";
+    }
+    return ofs.good();
+}
+
+#endif // _WIN32
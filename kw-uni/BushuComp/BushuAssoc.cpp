@@ -55,6 +55,22 @@ namespace {
             clearStrList();
         }
 
+        // 連想リストの startPos 番から10個を strList に入れる (辞書の連想リストを直接参照する)
+        // startPos が連想リストの範囲を超えていたら false を返す
+        bool loadSubList(size_t startPos) {
+            MStringView view = currentEntry->GetListView();
+            if (startPos >= view.size()) return false;
+
+            for (size_t i = 0; i < strList.size(); ++i) {
+                if (startPos + i < view.size()) {
+                    strList[i] = to_mstr(view[startPos + i]);
+                } else {
+                    strList[i].clear();
+                }
+            }
+            return true;
+        }
+
     public:
         CurrentAssocList() {
             strList.resize(N_SUB_LIST);
@@ -66,7 +82,7 @@ namespace {
             if (BUSHU_ASSOC_DIC) {
                 currentEntry = BUSHU_ASSOC_DIC->GetEntry(ch);
                 if (currentEntry) {
-                    currentEntry->CopySubList(strList, 0, N_SUB_LIST);
+                    loadSubList(0);
                     return true;
                 }
             }
@@ -91,7 +107,7 @@ namespace {
             MString result = strList[n];
             if (currentEntry) {
                 currentEntry->SelectNthTarget(n + row * N_SUB_LIST);
-                //currentEntry->CopySubList(strList, row * N_SUB_LIST, N_SUB_LIST); // これは不要
+                //loadSubList(row * N_SUB_LIST); // これは不要
             }
             return result;
         }
@@ -99,7 +115,7 @@ namespace {
         // 次の10個の枠を処理対象とする
         void NextCandidates() {
             if (currentEntry) {
-                if (currentEntry->CopySubList(strList, (row + 1) * N_SUB_LIST, N_SUB_LIST)) {
+                if (loadSubList((row + 1) * N_SUB_LIST)) {
                     ++row;
                 }
             }
@@ -110,7 +126,7 @@ namespace {
             if (currentEntry) {
                 if (row > 0) {
                     --row;
-                    currentEntry->CopySubList(strList, row * N_SUB_LIST, N_SUB_LIST);
+                    loadSubList(row * N_SUB_LIST);
                 }
             }
         }
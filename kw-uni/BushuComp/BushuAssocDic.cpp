@@ -2,6 +2,7 @@
 #include "string_type.h"
 #include "file_utils.h"
 #include "path_utils.h"
+#include "flat_hash_map.h"
 
 //#include "Constants.h"
 #include "Settings.h"
@@ -20,38 +21,25 @@
 namespace {
     inline bool isDelim(mchar_t m) { return m == 0 || m == wchar_t('\r') || m == wchar_t('\n'); }
 
+    // 連想リストを文字列に変換する
+    String listToWstr(const mchar_t* list, size_t len) {
+        String result;
+        for (size_t i = 0; i < len; ++i) push_back_wstr(list[i], result);
+        return result;
+    }
+
     // -------------------------------------------------------------------
-    /** 部首連想入力リストのエントリ */
-    class BushuAssocEntryImpl : public BushuAssocEntry {
-    private:
+    /** 部首連想入力リストのエントリの内容 (辞書ファイルの読み込みやマージの作業用) */
+    struct BushuAssocRecord {
         mchar_t key = 0;                // 部首
         size_t posFixed = 0;            // 固定位置文字数
         std::vector<mchar_t> list;      // key から生成される文字のリスト
         bool filled = false;            // bushuDic からターゲットを取得済みか
 
-    private:
-        // リストから tgt を検索し、その位置を返す。リストに存在しなければ末尾に追加する
-        size_t findTarget(mchar_t tgt) {
-            int x = (int)posFixed;
-            if (x < 0) x = 0;
-            int n = -1;
-            for (size_t i = 0; i < list.size(); ++i) {
-                if (list[i] == tgt) {
-                    n = i;
-                    break;
-                }
-            }
-            if (n < 0) {
-                n = (int)list.size();
-                list.push_back(tgt);
-            }
-            return n;
-        }
-
-    public:
-        BushuAssocEntryImpl(mchar_t k = 0) : key(k) {
-        }
-
+        /**
+        * 1行の定義を読み込む
+        *   K[=]AB|C...
+        */
         void ReadLine(StringRef line) {
             MString mline = to_mstr(line);
             key = mline[0];
@@ -71,67 +59,120 @@ namespace {
             }
             if (!bFixed) posFixed = list.size();
         }
+    };
+
+    // -------------------------------------------------------------------
+    /** 全エントリの連想リストを格納する連続領域 */
+    class AssocListPool {
+        std::vector<mchar_t> buffer;
+
+    public:
+        inline mchar_t* at(size_t offset) { return buffer.data() + offset; }
+
+        inline const mchar_t* at(size_t offset) const { return buffer.data() + offset; }
+
+        // 末尾に len 文字分の領域を確保し、その先頭位置を返す
+        inline size_t allocate(size_t len) {
+            size_t offset = buffer.size();
+            buffer.resize(offset + len, 0);
+            return offset;
+        }
+
+        inline void clear() { buffer.clear(); }
+    };
+
+    // -------------------------------------------------------------------
+    /** 部首連想入力リストのエントリ (連想リストの実体は AssocListPool 上にある) */
+    class BushuAssocEntryImpl : public BushuAssocEntry {
+    private:
+        AssocListPool* pool = 0;
+        mchar_t key = 0;                // 部首
+        size_t posFixed = 0;            // 固定位置文字数
+        size_t offset = 0;              // pool 内の連想リストの先頭位置
+        size_t length = 0;              // 連想リストの長さ
+        size_t capacity = 0;            // pool 内に確保済みの長さ
+        bool filled = false;            // bushuDic からターゲットを取得済みか
+
+        inline mchar_t* data() { return pool->at(offset); }
+
+        inline const mchar_t* data() const { return pool->at(offset); }
+
+        // 確保済み領域が足りなければ、pool の末尾に領域を確保し直して移動する
+        void reserve(size_t len) {
+            if (len > capacity) {
+                size_t newCapacity = std::max(len, capacity * 2);
+                size_t newOffset = pool->allocate(newCapacity);
+                std::copy(pool->at(offset), pool->at(offset) + length, pool->at(newOffset));
+                offset = newOffset;
+                capacity = newCapacity;
+            }
+        }
+
+        // リストから tgt を検索し、その位置を返す。リストに存在しなければ末尾に追加する
+        size_t findTarget(mchar_t tgt) {
+            for (size_t i = 0; i < length; ++i) {
+                if (data()[i] == tgt) return i;
+            }
+            reserve(length + 1);
+            data()[length] = tgt;
+            return length++;
+        }
+
+    public:
+        BushuAssocEntryImpl(AssocListPool* p, mchar_t k = 0) : pool(p), key(k) {
+        }
+
+        // 連想リストの内容を設定する
+        void Assign(const BushuAssocRecord& rec) {
+            key = rec.key;
+            posFixed = rec.posFixed;
+            filled = rec.filled;
+            length = 0;
+            reserve(rec.list.size());
+            std::copy(rec.list.begin(), rec.list.end(), data());
+            length = rec.list.size();
+        }
+
+        // 連想リストの内容を取り出す
+        BushuAssocRecord ToRecord() const {
+            MStringView view = GetListView();
+            return BushuAssocRecord{ key, posFixed, std::vector<mchar_t>(view.begin(), view.end()), filled };
+        }
 
         // 連想リストの元となるキー文字を返す
         mchar_t GetKey() const { return key; }
 
-        const std::vector<mchar_t>& GetList() const {
-            return list;
+        MStringView GetListView() const {
+            return length > 0 ? MStringView(data(), length) : MStringView();
         }
 
         size_t GetPosFixed() const { return posFixed; }
 
-        std::string MakeDicLine() {
+        std::string MakeDicLine() const {
             String line;
             line.append(to_wstr(key));
             line.append(_T("="));
             size_t len = posFixed + 10;    // 固定位置以外に10文字まで保存
-            if (len > list.size()) len = list.size();
+            if (len > length) len = length;
             if (posFixed < len) {
-                line.append(to_wstr(list, 0, posFixed));
+                line.append(listToWstr(data(), posFixed));
                 line.append(_T("|"));
-                line.append(to_wstr(list, posFixed, len - posFixed));
+                line.append(listToWstr(data() + posFixed, len - posFixed));
             } else {
-                line.append(to_wstr(list, 0, len));
+                line.append(listToWstr(data(), len));
             }
             return utils::utf8_encode(line);
         }
 
-        bool DeleteSameChars(const BushuAssocEntryImpl* other) {
-            bool bDirty = false;
-            if (other) {
-                for (auto x : other->list) {
-                    for (size_t i = 0; i < list.size(); ++i) {
-                        if (list[i] == x) {
-                            list[i] = 0;
-                            bDirty = true;
-                        }
-                    }
-                }
-            }
-            return bDirty;
-        }
-
-        bool MergeChars(const BushuAssocEntryImpl* other) {
-            bool bDirty = false;
-            if (other) {
-                for (auto x : other->list) {
-                    if (x != 0) {
-                        list.push_back(x);
-                        bDirty = true;
-                    }
-                }
-            }
-            return bDirty;
-        }
-
         // 合成辞書から連想入力リストを集めてくる
         bool GatherDerivedChars() {
             bool bDirty = false;
             if (!filled) {
                 if (BUSHU_DIC) {
-                    BUSHU_DIC->GatherDerivedMoji(key, list);
-                    filled = true;
+                    BushuAssocRecord rec = ToRecord();
+                    BUSHU_DIC->GatherDerivedMoji(key, rec.list);
+                    rec.filled = true;
+                    Assign(rec);
                     bDirty = true;
                 }
             }
@@ -147,12 +188,11 @@ namespace {
 
         // n番目の文字を選択して返す。選択されたものを固定位置の後の先頭に入れ替える
         mchar_t SelectNthTarget(size_t n, bool* pDirty) {
-            if (n < list.size()) {
+            if (n < length) {
+                mchar_t* list = data();
                 mchar_t m = list[n];
                 if (n > posFixed) { // 固定位置の直後なら移動の必要なし
-                    for (size_t i = n; i > posFixed; --i) {
-                        list[i] = list[i - 1];
-                    }
+                    std::copy_backward(list + posFixed, list + n, list + n + 1);
                     list[posFixed] = m;
                     if (pDirty) *pDirty = true;
                 }
@@ -161,28 +201,6 @@ namespace {
             return 0;
         }
 
-        // startPos 番から n 個の候補を文字列としてコピーする
-        // startPos が list の範囲を超えていたら false を返す
-        // bIncludeBar = true なら固定位置を示す '|' を挿入する
-        bool CopySubList(std::vector<MString>& strList, size_t startPos, size_t n, bool bIncludeBar) {
-            if (startPos >= list.size()) return false;
-
-            size_t j = 0;
-            for (size_t i = 0; i < n && j < strList.size(); ++i) {
-                if (bIncludeBar && i == posFixed) {
-                    strList[j++] = to_mstr('|');
-                    if (j >= strList.size()) break;
-                }
-                if (startPos + i < list.size()) {
-                    strList[j] = to_mstr(list[startPos + i]);
-                } else {
-                    strList[j].clear();
-                }
-                ++j;
-            }
-            return true;
-        }
-
     }; // class BushuAssocEntryImpl
 
 
@@ -192,19 +210,69 @@ namespace {
     private:
         DECLARE_CLASS_LOGGER;
 
-        std::map<mchar_t, BushuAssocEntryImpl*> bscEntries;
+        // 全エントリの連想リストの格納領域
+        AssocListPool listPool;
+
+        // エントリ本体 (GetEntry で返したポインタが無効にならないよう deque に置く)
+        std::deque<BushuAssocEntryImpl> bscEntries;
+
+        // キー文字から bscEntries の位置へのインデックス
+        utils::FlatHashMap<mchar_t, size_t> entryIndex;
 
         bool bDirty = false;
 
-    public:
-        BushuAssocDicImpl() { }
+        BushuAssocEntryImpl* findEntry(mchar_t k) {
+            auto pIdx = entryIndex.find(k);
+            return pIdx ? &bscEntries[*pIdx] : nullptr;
+        }
 
-        ~BushuAssocDicImpl() {
-            for (const auto& pair : bscEntries) {
-                delete pair.second;
+        // k のエントリを返す。なければ作成する
+        BushuAssocEntryImpl* findOrAddEntry(mchar_t k) {
+            auto entp = findEntry(k);
+            if (!entp) {
+                entryIndex[k] = bscEntries.size();
+                bscEntries.emplace_back(&listPool, k);
+                entp = &bscEntries.back();
             }
+            return entp;
         }
 
+        // 全エントリを records の内容で作り直す(連想リストの格納領域も詰め直される)
+        void rebuildEntries(const std::vector<BushuAssocRecord>& records) {
+            bscEntries.clear();
+            entryIndex.clear();
+            listPool.clear();
+            entryIndex.reserve(records.size());
+            for (const auto& rec : records) {
+                findOrAddEntry(rec.key)->Assign(rec);
+            }
+        }
+
+        // 辞書ファイルの内容をキー順に並べて返す(同じキーの定義が複数あれば後勝ち)
+        static std::vector<BushuAssocRecord> readRecords(const std::vector<String>& lines) {
+            std::vector<BushuAssocRecord> records;
+            for (auto& _ln : lines) {
+                auto line = utils::strip(_ln);
+                if (line.empty() || isDelim(line[0]) || line[0] == '#') continue;   // 空行や # で始まる行は読み飛ばす
+
+                records.emplace_back();
+                records.back().ReadLine(line);
+            }
+            std::stable_sort(records.begin(), records.end(), [](const auto& a, const auto& b) { return a.key < b.key; });
+            // 同じキーは最後のものだけを残す
+            std::vector<BushuAssocRecord> result;
+            for (size_t i = 0; i < records.size(); ++i) {
+                if (i + 1 < records.size() && records[i + 1].key == records[i].key) continue;
+                result.push_back(std::move(records[i]));
+            }
+            return result;
+        }
+
+    public:
+        BushuAssocDicImpl() { }
+
+        ~BushuAssocDicImpl() { }
+
 
         /**
         * 部首連想入力辞書ファイルの読み込み
@@ -217,13 +285,8 @@ namespace {
         * 空行は無視。
         */
         void ReadFile(const std::vector<String>& lines) {
-            for (auto& _ln : lines) {
-                auto line = utils::strip(_ln);
-                if (line.empty() || isDelim(line[0]) || line[0] == '#') continue;   // 空行や # で始まる行は読み飛ばす
-
-                BushuAssocEntryImpl* entp = new BushuAssocEntryImpl();
-                entp->ReadLine(line);
-                bscEntries[entp->GetKey()] = entp;
+            for (const auto& rec : readRecords(lines)) {
+                findOrAddEntry(rec.key)->Assign(rec);
             }
             // ReadFileの直後ならクリーン状態である(辞書保存は不要)
             bDirty = false;
@@ -239,52 +302,46 @@ namespace {
         }
 
         // 辞書ファイルの内容を既に読み込んだリストにマージする
+        // ファイルの内容と現状のエントリをそれぞれキー順に並べてからマージする
         void MergeFile(const std::vector<String>& lines) {
-            // 現状のものを保存
-            std::map<mchar_t, BushuAssocEntryImpl*> tempEntries;
-            std::copy(bscEntries.begin(), bscEntries.end(), std::inserter(tempEntries, tempEntries.end()));
+            std::vector<BushuAssocRecord> fileRecords = readRecords(lines);
+            std::vector<mchar_t> currentKeys = entryIndex.sortedKeys();
 
-            // ファイルの内容を読み込む
-            bscEntries.clear();
-            ReadFile(lines);
-
-            // 読み込んだものと同じ文字を削除しておく
-            for (const auto& pair : bscEntries) {
-                mchar_t m = pair.first;
-                auto iter = tempEntries.find(m);
-                if (iter != tempEntries.end()) {
-                    if (iter->second->DeleteSameChars(pair.second)) {
-                        bDirty = true;
-                    }
-                }
-            }
-            // 残った文字をコピーする
-            for (auto& pair : tempEntries) {
-                mchar_t ch = pair.first;
-                auto iter = bscEntries.find(ch);
-                if (iter != bscEntries.end()) {
-                    if (iter->second->MergeChars(pair.second)) {
-                        bDirty = true;
-                    }
-                } else {
-                    // ファイルに記述されていないものだったので、戻しておく
+            std::vector<BushuAssocRecord> merged;
+            merged.reserve(fileRecords.size() + currentKeys.size());
+
+            size_t i = 0;
+            size_t j = 0;
+            while (i < fileRecords.size() || j < currentKeys.size()) {
+                if (i >= fileRecords.size() || (j < currentKeys.size() && currentKeys[j] < fileRecords[i].key)) {
+                    // ファイルに記述されていないものだったので、現状のものを残しておく
                     // @fixme: 本当に削除したいときにどうするか
-                    bscEntries[ch] = pair.second;
-                    pair.second = nullptr;  // 下のクリーンアップで削除されないように
+                    merged.push_back(findEntry(currentKeys[j++])->ToRecord());
+                } else if (j >= currentKeys.size() || fileRecords[i].key < currentKeys[j]) {
+                    merged.push_back(std::move(fileRecords[i++]));
+                } else {
+                    // ファイルの内容の後ろに、現状のリストのうちファイルにない文字を追加する
+                    BushuAssocRecord rec = std::move(fileRecords[i++]);
+                    MStringView current = findEntry(currentKeys[j++])->GetListView();
+                    size_t fileLen = rec.list.size();
+                    for (auto x : current) {
+                        if (x != 0 && std::find(rec.list.begin(), rec.list.begin() + fileLen, x) == rec.list.begin() + fileLen) {
+                            rec.list.push_back(x);
+                        }
+                    }
+                    merged.push_back(std::move(rec));
                 }
             }
-            // 残ったゴミをクリーンアアップ
-            for (const auto& pair : tempEntries) delete pair.second;
+
+            rebuildEntries(merged);
 
             bDirty = true;
         }
 
         // ファイルへの保存
         void WriteFile(utils::OfstreamWriter& writer) {
-            for (const auto& pair : bscEntries) {
-                if (pair.second) {
-                    writer.writeLine(pair.second->MakeDicLine());
-                }
+            for (auto key : entryIndex.sortedKeys()) {
+                writer.writeLine(findEntry(key)->MakeDicLine());
             }
             bDirty = false;
         }
@@ -295,36 +352,25 @@ namespace {
             auto line = utils::strip(ln);
             if (line.empty() || isDelim(line[0]) || line[0] == '#') return;   // 空行や # で始まる行は無視
 
-            auto entp = new BushuAssocEntryImpl();
-            entp->ReadLine(line);
-            auto iter = bscEntries.find(entp->GetKey());
-            if (iter == bscEntries.end()) {
-                bscEntries[entp->GetKey()] = entp;
-            } else {
-                delete iter->second;
-                iter->second = entp;
-            }
+            BushuAssocRecord rec;
+            rec.ReadLine(line);
+            findOrAddEntry(rec.key)->Assign(rec);
             bDirty = true;
         }
 
         BushuAssocEntry* GetEntry(mchar_t k) {
             LOG_DEBUGH(L"ENTER: key={}", to_wstr(k));
-            BushuAssocEntryImpl* entp = 0;
-
-            auto iter = bscEntries.find(k);
-            if (iter == bscEntries.end()) {
-                entp = new BushuAssocEntryImpl(k);
-                bscEntries[k] = entp;
+            BushuAssocEntryImpl* entp = findEntry(k);
+            if (!entp) {
+                entp = findOrAddEntry(k);
                 bDirty = true;
-            } else {
-                entp = iter->second;
             }
             // 合成辞書から連想入力リストを集めてくる
             if (entp->GatherDerivedChars()) {
                 bDirty = true;
             }
 
-            LOG_DEBUGH(L"LEAVE: list={}", entp ? to_wstr(entp->GetList().data()) : L"empty");
+            LOG_DEBUGH(L"LEAVE: list={}", listToWstr(entp->GetListView().data(), entp->GetListView().size()));
             return entp;
         }
 
@@ -10,8 +10,11 @@ public:
     // 連想リストの元となるキー文字を返す
     virtual mchar_t GetKey() const = 0;
 
-    // startPos 番から n 個の候補を文字列としてコピーする。startPos が list の範囲を超えていたら false を返す
-    virtual bool CopySubList(std::vector<MString>&, size_t startPos, size_t n, bool bIncludeBar = false) = 0;
+    // 連想リスト全体を返す(辞書内部の領域を直接参照するので、辞書が更新されるまでの間だけ有効)
+    virtual MStringView GetListView() const = 0;
+
+    // 固定位置文字数を返す
+    virtual size_t GetPosFixed() const = 0;
 
     // 指定された tgt を選択する。存在しなければ末尾に追加する。dirtyフラグを返す
     virtual bool SelectTarget(mchar_t tgt) = 0;
@@ -135,7 +135,8 @@ bool BushuCompNode::ReduceByAutoBushu(mchar_t tailChar, mchar_t thisChar, MStrin
         //if (prevTotalCnt + 1 == firstStrokeCnt) {
             //mchar_t m1 = OUTPUT_STACK->LastOutStackChar(0);
             //mchar_t m2 = mstr[0];
-            mchar_t m = BUSHU_DIC->FindAutoComposite(tailChar, thisChar);
+            // 自動合成文字が登録されている可能性がなければ、辞書を引かない
+            mchar_t m = BUSHU_DIC->MayHaveAutoComposite(tailChar, thisChar) ? BUSHU_DIC->FindAutoComposite(tailChar, thisChar) : 0;
             PrevBushu1 = tailChar;
             PrevBushu2 = thisChar;
             PrevComp = m;
@@ -160,6 +161,18 @@ bool BushuCompNode::ReduceByAutoBushu(mchar_t tailChar, mchar_t thisChar, MStrin
     return false;
 }
 
+// 自動部首合成をしなかった (合成文字がなかった) ときの状態にする
+void BushuCompNode::SetAutoBushuNotFound(mchar_t tailChar, mchar_t thisChar) {
+    if (BUSHU_DIC && tailChar != '\0' && thisChar != '\0') {
+        PrevTotalCount = STATE_COMMON->GetTotalDecKeyCount();
+        PrevBushu1 = tailChar;
+        PrevBushu2 = thisChar;
+        PrevComp = 0;
+        IsPrevAuto = false;
+        IsPrevAutoCancel = false;
+    }
+}
+
 // 後置部首合成機能ノードのSingleton
 // unique_ptr による管理は下記 BushuCompNodeBuilder の呼び出し側で行う
 std::unique_ptr<BushuCompNode> BushuCompNode::_singleton;
@@ -35,6 +35,10 @@ public:
     // 自動部首合成の実行
     bool ReduceByAutoBushu(mchar_t tailChar, mchar_t thisChar, MStringResult& result);
 
+    // 自動部首合成をしなかった (合成文字がなかった) ときの状態にする
+    // (合成できないと分かっている組について、辞書を引かずに ReduceByAutoBushu と同じ状態にするため)
+    void SetAutoBushuNotFound(mchar_t tailChar, mchar_t thisChar);
+
 public:
     // 後置部首合成機能ノードのSingletonを取得
     static BushuCompNode* Singleton();
@@ -2,6 +2,7 @@
 #include "string_utils.h"
 #include "file_utils.h"
 #include "path_utils.h"
+#include "flat_hash_map.h"
 
 #include "Constants.h"
 #include "Settings.h"
@@ -39,6 +40,11 @@ namespace {
                 parts[1] = b;
             }
 
+            explicit parts_t(uint32_t v) : data(v) {
+                parts[0] = (wchar_t)(v >> 16);
+                parts[1] = (wchar_t)(v & 0xffff);
+            }
+
             inline void set(wchar_t a, wchar_t b) {
                 data = (a << 16) + b;
                 parts[0] = a;
@@ -57,39 +63,63 @@ namespace {
 
             inline bool empty() const { return data == 0; }
             inline bool notEmpty() const { return data != 0; }
+
+            inline uint32_t value() const { return data; }
+        };
+
+        // BMP 文字の集合を表すビットマップ (BMP 外の文字は常に含まれるものとして扱う)
+        class CharBitmap {
+            std::vector<uint64_t> bits = std::vector<uint64_t>(0x10000 / 64, 0);
+
+        public:
+            inline void set(mchar_t c) { if (c < 0x10000) bits[c >> 6] |= 1ULL << (c & 63); }
+            inline bool test(mchar_t c) const { return c >= 0x10000 || (bits[c >> 6] & (1ULL << (c & 63))) != 0; }
+            inline void clear() { std::fill(bits.begin(), bits.end(), 0); }
         };
 
         const wchar_t FirstKanji = FIRST_KANJI;
 
         // 本体から部品へのマップ
-        std::map<mchar_t, parts_t> entries;
+        utils::FlatHashMap<mchar_t, parts_t> entries;
 
         // ストローク可能文字か否かを示すマップ
-        std::map<mchar_t, bool> strokableMap;
+        utils::FlatHashMap<mchar_t, bool> strokableMap;
 
         // 等価マップ
-        std::map<mchar_t, std::set<wchar_t>> equivMap;
+        utils::FlatHashMap<mchar_t, std::set<wchar_t>> equivMap;
 
         std::set<wchar_t> emptyEquiv;
 
         inline const std::set<wchar_t>& findEquiv(mchar_t c) {
-            auto it = equivMap.find(c);
-            return it == equivMap.end() ? emptyEquiv : it->second;
+            auto p = equivMap.find(c);
+            return p ? *p : emptyEquiv;
         }
 
         inline void addEquiv(mchar_t a, mchar_t b) {
-            auto it = equivMap.find(a);
-            if (it == equivMap.end()) {
-                equivMap[a] = std::set<wchar_t>();
-            }
             equivMap[a].insert((wchar_t)b);
         }
 
-        // 合成辞書
-        std::map<parts_t, mchar_t> compMap;
+        // 合成辞書 (キーは parts_t::value())
+        utils::FlatHashMap<uint32_t, mchar_t> compMap;
+
+        // 合成結果の事前計算テーブル (キーは parts_t(ca, cb).value())
+        // 等価文字を使った足し算(findCompSub の A1～C2)までで見つかる最優先の合成文字を、辞書読み込み時に展開しておく
+        utils::FlatHashMap<uint32_t, mchar_t> directCompMap;
+
+        // findCompSub の全探索結果のキャッシュ (優先順に並べた、重複のない合成文字の列)
+        utils::FlatHashMap<uint64_t, std::vector<mchar_t>> compCandsCache;
+
+        // 合成辞書が変更されたので、事前計算テーブルを作り直す必要がある
+        bool bCompTableDirty = false;
+
+        // 全探索用の作業領域
+        std::vector<mchar_t> workCands;
+
+        // 部首合成に関与しうる文字 (本体・部品・等価文字のいずれかとして辞書に現れる文字)
+        CharBitmap composableChars;
 
         // 部品から本体集合(キー文字を部品とする本体文字の集合)へのマップ
-        std::map<mchar_t, std::set<mchar_t>> partsBodiesMap;
+        utils::FlatHashMap<mchar_t, std::set<mchar_t>> partsBodiesMap;
 
         // 保存時に辞書ファイルに追加されるエントリ
         std::vector<String> addedEntries;
@@ -108,36 +138,48 @@ namespace {
             size_t count;
         };
 
-        // 自動部首合成用辞書
-        std::map<MString, AutoBushuTarget> autoBushuDict;
+        // 自動部首合成用辞書 (キーは autoBushuKey(a, b))
+        utils::FlatHashMap<uint64_t, AutoBushuTarget> autoBushuDict;
+
+        static inline uint64_t autoBushuKey(mchar_t a, mchar_t b) { return ((uint64_t)a << 32) | b; }
+
+        static inline MString autoBushuKeyToMString(uint64_t key) { return make_mstring((mchar_t)(key >> 32), (mchar_t)(key & 0xffffffff)); }
+
+        // 部品が3文字以上の自動エントリ (キーは部品の並び)
+        // 合成で参照されることはないが、自動合成辞書ファイルを読み書きしても消えないように保持しておく
+        std::map<MString, AutoBushuTarget> longAutoBushuDict;
+
+        // 自動部首合成用辞書の第1部品・第2部品として現れる文字
+        CharBitmap autoFirstParts;
+        CharBitmap autoSecondParts;
 
         // 自動部首合成用辞書が修正された
         bool bAutoDirty = false;
 
         // 当文字を構成する部品に分解する
         inline parts_t findParts(mchar_t c) {
-            auto it = entries.find(c);
-            return it == entries.end() ? parts_t() : it->second;
+            auto p = entries.find(c);
+            return p ? *p : parts_t();
         }
 
         inline mchar_t findComp(wchar_t a, wchar_t b) {
             if (a == 0 || b == 0) return 0;
-            auto it = compMap.find(parts_t(a, b));
-            return it == compMap.end() ? 0 : it->second;
+            auto p = compMap.find(parts_t(a, b).value());
+            return p ? *p : 0;
         }
 
         inline mchar_t findComp(const std::set<wchar_t>& as, wchar_t b) {
             for (auto a : as) {
-                auto it = compMap.find(parts_t(a, b));
-                return it == compMap.end() ? 0 : it->second;
+                auto p = compMap.find(parts_t(a, b).value());
+                return p ? *p : 0;
             }
             return 0;
         }
 
         inline mchar_t findComp(wchar_t a, const std::set<wchar_t>& bs) {
             for (auto b : bs) {
-                auto it = compMap.find(parts_t(a, b));
-                return it == compMap.end() ? 0 : it->second;
+                auto p = compMap.find(parts_t(a, b).value());
+                return p ? *p : 0;
             }
             return 0;
         }
@@ -145,24 +187,20 @@ namespace {
         inline mchar_t findComp(const std::set<wchar_t>& as, const std::set<wchar_t>& bs) {
             for (auto a : as) {
                 for (auto b : bs) {
-                    auto it = compMap.find(parts_t(a, b));
-                    return it == compMap.end() ? 0 : it->second;
+                    auto p = compMap.find(parts_t(a, b).value());
+                    return p ? *p : 0;
                 }
             }
             return 0;
         }
 
         inline void addBody(mchar_t ch, mchar_t body) {
-            auto it = partsBodiesMap.find(ch);
-            if (it == partsBodiesMap.end()) {
-                partsBodiesMap[ch] = std::set<mchar_t>();
-            }
             partsBodiesMap[ch].insert(body);
         }
 
         inline const std::set<mchar_t>& getBodies(mchar_t ch) {
-            auto it = partsBodiesMap.find(ch);
-            return it == partsBodiesMap.end() ? emptySet : it->second;
+            auto p = partsBodiesMap.find(ch);
+            return p ? *p : emptySet;
         }
 
 #define _PARTS_MAX 100
@@ -204,6 +242,8 @@ namespace {
                 if (Reporting::Logger::IsInfoEnabled()) lastLine = line;
             }
 
+            makeCompTable();
+
             LOG_INFO(_T("LEAVE: last line={}"), lastLine);
         }
 
@@ -229,6 +269,9 @@ namespace {
 
             // 各マップをクリアしておく(再読み込みのため)
             autoBushuDict.clear();
+            longAutoBushuDict.clear();
+            autoFirstParts.clear();
+            autoSecondParts.clear();
             bAutoDirty = false;
 
             for (auto& line : lines) {
@@ -245,9 +288,12 @@ namespace {
 
         // 自動合成辞書内容の保存
         void WriteAutoDicFile(utils::OfstreamWriter& writer) {
-            LOG_INFO(_T("CALLED: autoBushuDict.size()={}"), autoBushuDict.size());
+            LOG_INFO(_T("CALLED: autoBushuDict.size()={}, longAutoBushuDict.size()={}"), autoBushuDict.size(), longAutoBushuDict.size());
             std::set<String> set_;
             for (const auto& pair : autoBushuDict) {
+                set_.insert(std::format(_T("{}\t{}"), to_wstr(MString(1, pair.second.target) + autoBushuKeyToMString(pair.first)), pair.second.count));
+            }
+            for (const auto& pair : longAutoBushuDict) {
                 set_.insert(std::format(_T("{}\t{}"), to_wstr(MString(1, pair.second.target) + pair.first), pair.second.count));
             }
             for (const auto& s : set_) {
@@ -261,7 +307,7 @@ namespace {
         }
 
         void MakeStrokableMap() override {
-            for (auto pair : partsBodiesMap) {
+            for (const auto& pair : partsBodiesMap) {
                 strokableMap[pair.first] = STROKE_HELP->Find(pair.first);
             }
         }
@@ -283,17 +329,14 @@ namespace {
         // a と b を組み合わせてできる自動合成文字を探す。
         mchar_t FindAutoComposite(mchar_t ca, mchar_t cb) override {
             auto finder = [this](mchar_t a, mchar_t b) {
-                MString key;
-                key.push_back(a);
-                key.push_back(b);
-                _LOG_DEBUGH(_T("key={}"), to_wstr(key));
-                auto iter = autoBushuDict.find(key);
-                _LOG_DEBUGH(_T("iter->second.target={}"), ((iter != autoBushuDict.end()) ? iter->second.target : 0x20));
-                if (iter != autoBushuDict.end() && iter->second.target != '-' && iter->second.count >= SETTINGS->autoBushuCompMinCount) {
+                _LOG_DEBUGH(_T("key={}"), to_wstr(make_mstring(a, b)));
+                auto pTarget = autoBushuDict.find(autoBushuKey(a, b));
+                _LOG_DEBUGH(_T("pTarget->target={}"), (pTarget ? pTarget->target : 0x20));
+                if (pTarget && pTarget->target != '-' && pTarget->count >= SETTINGS->autoBushuCompMinCount) {
                     // 参照回数が閾値以上のエントリが見つかったので、さらに参照回数をインクリメントしておく
                     bAutoDirty = true;
-                    iter->second.count++;
-                    return iter->second.target;
+                    pTarget->count++;
+                    return pTarget->target;
                 }
                 return (mchar_t)0; // ターゲットが '-' だったり、最小呼び出し回数に達していなければ変換しない
             };
@@ -304,6 +347,11 @@ namespace {
             return finder(ca, cb);
         }
 
+        // a と b の組み合わせに自動合成文字が登録されている可能性があるか
+        bool MayHaveAutoComposite(mchar_t ca, mchar_t cb) override {
+            return autoFirstParts.test(ca) && autoSecondParts.test(cb);
+        }
+
     private:
         // エントリの追加
         void addBushuEntry(StringRef line) {
@@ -326,38 +374,117 @@ namespace {
                     parts_t comp = parts_t(a, b);
                     // 分解用のエントリは、同じ本体文字については先勝ち登録とする
                     // 例: 「爆火暴」「爆バク」という2つのエントリがあったら、先に記述されている「爆火暴」を優先する
-                    if (entries.find(c) == entries.end()) entries[c] = comp;
+                    entries.insert(c, comp);
                     // 合成用エントリはすべて登録(もし同じ組み合わせがあれば、後勝ちになる)
-                    compMap[comp] = c;
+                    compMap[comp.value()] = c;
                     addBody(b, c);
                 }
+                bCompTableDirty = true;
             }
         }
 
-        bool isInvalidAutoBushuKey(const MString& key) {
-            auto iter = autoBushuDict.find(key);
-            return iter != autoBushuDict.end() && iter->second.target == '-';
+#define COMP_CANDS_CACHE_MAX 10000
+
+        // 合成結果の事前計算テーブルを作成する
+        void makeCompTable() {
+            LOG_INFO(_T("ENTER: compMap.size()={}, equivMap.size()={}"), compMap.size(), equivMap.size());
+
+            directCompMap.clear();
+            compCandsCache.clear();
+            bCompTableDirty = false;
+
+            composableChars.clear();
+            for (const auto& pair : entries) composableChars.set(pair.first);
+            for (const auto& pair : equivMap) composableChars.set(pair.first);
+            for (const auto& pair : partsBodiesMap) composableChars.set(pair.first);
+
+            // 等価文字集合の先頭文字から、それを先頭に持つ文字への逆引き (findComp(const std::set<wchar_t>&, ...) は先頭要素しか見ないため)
+            std::map<wchar_t, std::vector<wchar_t>> firstEquivRevMap;
+            for (const auto& pair : equivMap) {
+                if (!pair.second.empty()) firstEquivRevMap[*pair.second.begin()].push_back((wchar_t)pair.first);
+            }
+
+            auto expand = [&firstEquivRevMap](wchar_t x) {
+                std::vector<wchar_t> result(1, x);
+                auto it = firstEquivRevMap.find(x);
+                if (it != firstEquivRevMap.end()) result.insert(result.end(), it->second.begin(), it->second.end());
+                return result;
+            };
+
+            auto addDirect = [this](wchar_t ca, wchar_t cb) {
+                uint32_t key = parts_t(ca, cb).value();
+                if (!directCompMap.contains(key)) {
+                    gatherCompCands(ca, cb, workCands, true);
+                    if (!workCands.empty()) directCompMap[key] = workCands.front();
+                }
+            };
+
+            // A1～C2 で合成文字が見つかる (ca, cb) は、いずれかの compMap エントリの部品(またはその等価文字)の組になる
+            for (const auto& pair : compMap) {
+                parts_t parts(pair.first);
+                for (auto p : expand(parts.a())) {
+                    for (auto q : expand(parts.b())) {
+                        addDirect(p, q);
+                        addDirect(q, p);
+                    }
+                }
+            }
+
+            LOG_INFO(_T("LEAVE: directCompMap.size()={}"), directCompMap.size());
+        }
+
+        // (ca, cb) から合成可能な文字の列を優先順に返す(結果はキャッシュする)
+        const std::vector<mchar_t>& getCompCands(wchar_t ca, wchar_t cb) {
+            uint64_t key = ((uint64_t)parts_t(ca, cb).value() << 1) | (SETTINGS->yamanobeEnabled ? 1 : 0);
+            auto pCands = compCandsCache.find(key);
+            if (pCands) return *pCands;
+
+            if (compCandsCache.size() >= COMP_CANDS_CACHE_MAX) compCandsCache.clear();
+            auto& cands = compCandsCache[key];
+            gatherCompCands(ca, cb, cands, false);
+            return cands;
+        }
+
+        bool isInvalidAutoBushuKey(mchar_t a, mchar_t b) {
+            auto pTarget = autoBushuDict.find(autoBushuKey(a, b));
+            return pTarget && pTarget->target == '-';
+        }
+
+        // 既存の自動エントリ pTarget (なければ nullptr) に、ターゲット target を cnt 回分反映する
+        // 新しく登録し直すべきなら true を返す (そのときの参照回数は cnt に入れて返す)
+        bool mergeAutoBushuTarget(AutoBushuTarget* pTarget, mchar_t target, size_t& cnt, bool bForce, bool bDirty) {
+            if (bForce || target == '-' || !pTarget || pTarget->target != '-') {
+                // 強制または無効化または組合せが存在しないまたはターゲットが '-' でない組み合わせの場合に再登録する
+                if (target == '-') cnt = 0;
+                if (bDirty) bAutoDirty = true;
+                if (!bForce && pTarget) {
+                    if (pTarget->target == target) {
+                        pTarget->count += cnt;
+                    } else {
+                        pTarget->count = cnt;
+                    }
+                    return false;
+                }
+                return true;
+            }
+            return false;
         }
 
         // 自動エントリの追加 (形式は CAB)
+        // 参照されるのは2文字の組み合わせだけなので、部品が3文字以上のエントリは longAutoBushuDict に保存用として置いておく
         void addAutoBushuEntry(const MString& line, size_t cnt, bool bForce, bool bDirty) {
-            if (line.size() >= 3) {
-                mchar_t target = line[0];
+            if (line.size() == 3) {
+                auto key = autoBushuKey(line[1], line[2]);
+                if (mergeAutoBushuTarget(autoBushuDict.find(key), line[0], cnt, bForce, bDirty)) {
+                    autoBushuDict[key] = AutoBushuTarget{ line[0], cnt };
+                    autoFirstParts.set(line[1]);
+                    autoSecondParts.set(line[2]);
+                }
+            } else if (line.size() > 3) {
                 auto key = line.substr(1);
-                auto iter = autoBushuDict.find(key);
-                if (bForce || target == '-' || iter == autoBushuDict.end() || iter->second.target != '-') {
-                    // 強制または無効化または組合せが存在しないまたはターゲットが '-' でない組み合わせの場合に再登録する
-                    if (target == '-') cnt = 0;
-                    if (!bForce && iter != autoBushuDict.end()) {
-                        if (iter->second.target == target) {
-                            iter->second.count += cnt;
-                        } else {
-                            iter->second.count = cnt;
-                        }
-                    } else {
-                        autoBushuDict[key] = AutoBushuTarget{ line[0], cnt };
-                    }
-                    if (bDirty) bAutoDirty = true;
+                auto iter = longAutoBushuDict.find(key);
+                if (mergeAutoBushuTarget(iter != longAutoBushuDict.end() ? &iter->second : nullptr, line[0], cnt, bForce, bDirty)) {
+                    longAutoBushuDict[key] = AutoBushuTarget{ line[0], cnt };
                 }
             }
         }
@@ -433,26 +560,45 @@ namespace {
         }
 
     private:
+        // prev == 0 なら最優先の合成文字を、そうでなければ prev の次の合成文字を返す
         mchar_t findCompSub(wchar_t ca, wchar_t cb, mchar_t prev) {
+            if (bCompTableDirty) makeCompTable();
+
+            // 辞書に現れない文字が含まれていれば、どの合成方法でも合成文字は得られない
+            if (!composableChars.test(ca) || !composableChars.test(cb)) return 0;
 
-            std::set<mchar_t> skipChars;
+            if (prev == 0) {
+                // まず事前計算テーブルを引く
+                auto pComp = directCompMap.find(parts_t(ca, cb).value());
+                if (pComp) {
+                    _LOG_INFO(_T("direct result={}"), to_wstr(*pComp));
+                    return *pComp;
+                }
+            }
 
-            bool bFound = prev == 0;
+            const auto& cands = getCompCands(ca, cb);
+            if (cands.empty()) return 0;
+            if (prev == 0) return cands.front();
+
+            auto iter = std::find(cands.begin(), cands.end(), prev);
+            return iter != cands.end() && iter + 1 != cands.end() ? *(iter + 1) : 0;
+        }
+
+        // a と b を組み合わせてできる合成文字を、探索順に重複なく cands に集める。
+        // bDirectOnly なら、等価文字を使った足し算までで打ち切る。
+        void gatherCompCands(wchar_t ca, wchar_t cb, std::vector<mchar_t>& cands, bool bDirectOnly) {
+
+            cands.clear();
 
             mchar_t r;
 
 #define _NC(x) (x?x:0x20)
 #define MAKE_LSTR(x, y) L #x #y
-#define CHECK_AND_RETURN(tag, x) {\
+#define CHECK_AND_ADD(tag, x) {\
         r = (x);\
-        if (r != 0 && r != ca && r != cb) { \
-            if (r == prev) { \
-                bFound = true; \
-            } else if (bFound && skipChars.find(r) == skipChars.end()) { \
-                _LOG_INFO(MAKE_LSTR(tag, "result={}"), to_wstr(r)); \
-                return (mchar_t)r; \
-            } \
-            skipChars.insert(r); \
+        if (r != 0 && r != ca && r != cb && std::find(cands.begin(), cands.end(), r) == cands.end()) { \
+            _LOG_INFO(MAKE_LSTR(tag, "result={}"), to_wstr(r)); \
+            cands.push_back(r); \
         }\
     }
 
@@ -461,20 +607,22 @@ namespace {
             const std::set<wchar_t>& eqb = findEquiv(cb);
 
             // まず、足し算(逆順の足し算も先にやっておく)
-            CHECK_AND_RETURN("A1", findComp(ca, cb));
-            CHECK_AND_RETURN("A2", findComp(cb, ca));
+            CHECK_AND_ADD("A1", findComp(ca, cb));
+            CHECK_AND_ADD("A2", findComp(cb, ca));
 
             _LOG_INFO(_T("EQUIV: eqa={}, eqb={}"), eqa.empty() ? '-' : *eqa.begin(), eqb.empty() ? '-' : *eqb.begin());
 
             // 等価文字を使って足し算
-            CHECK_AND_RETURN("B1", findComp(ca, eqb));
-            CHECK_AND_RETURN("B2", findComp(eqa, cb));
-            CHECK_AND_RETURN("B3", findComp(eqb, ca));
-            CHECK_AND_RETURN("B4", findComp(cb, eqa));
+            CHECK_AND_ADD("B1", findComp(ca, eqb));
+            CHECK_AND_ADD("B2", findComp(eqa, cb));
+            CHECK_AND_ADD("B3", findComp(eqb, ca));
+            CHECK_AND_ADD("B4", findComp(cb, eqa));
 
             // 等価文字同士で足し算
-            CHECK_AND_RETURN("C1", findComp(eqa, eqb));
-            CHECK_AND_RETURN("C2", findComp(eqb, eqa));
+            CHECK_AND_ADD("C1", findComp(eqa, eqb));
+            CHECK_AND_ADD("C2", findComp(eqb, eqa));
+
+            if (bDirectOnly) return;
 
             // ここまでで合成文字が見つからなければ、部品を使う
             wchar_t a1, a2, b1, b2;
@@ -485,13 +633,13 @@ namespace {
 
             // 引き算
             if (a1 && a2) {
-                if (a2 == cb || eqb.find(a2) != eqb.end()) CHECK_AND_RETURN("F1", a1);     // a1 = ca - cb(eqb)
-                if (a1 == cb || eqb.find(a1) != eqb.end()) CHECK_AND_RETURN("F2", a2);     // a2 = ca - cb(eqb)
+                if (a2 == cb || eqb.find(a2) != eqb.end()) CHECK_AND_ADD("F1", a1);     // a1 = ca - cb(eqb)
+                if (a1 == cb || eqb.find(a1) != eqb.end()) CHECK_AND_ADD("F2", a2);     // a2 = ca - cb(eqb)
             }
             // 引き算(逆順)
             if (b1 && b2) {
-                if (b2 == ca || eqa.find(b2) != eqa.end()) CHECK_AND_RETURN("G1", b1);     // b1 = cb - ca(eqa)
-                if (b1 == ca || eqa.find(b1) != eqa.end()) CHECK_AND_RETURN("G2", b2);     // b2 = cb - ca(eqa)
+                if (b2 == ca || eqa.find(b2) != eqa.end()) CHECK_AND_ADD("G1", b1);     // b1 = cb - ca(eqa)
+                if (b1 == ca || eqa.find(b1) != eqa.end()) CHECK_AND_ADD("G2", b2);     // b2 = cb - ca(eqa)
             }
 
             if (SETTINGS->yamanobeEnabled) {
@@ -502,13 +650,13 @@ namespace {
                     mchar_t z; \
                     if ((z = findComp(x1, y)) != 0) { \
                         _LOG_INFO(MAKE_LSTR(tag, "1-Y-ADD(x1+y)={}"), (wchar_t)z); \
-                        CHECK_AND_RETURN(#tag "1-Y-ADD((x1+y)+x2):", findComp((wchar_t)z, x2)); /* X = X1 + X2 のとき、 (X1 + Y) + X2 を出したい */ \
-                        CHECK_AND_RETURN(#tag  "1-Y-ADD(x2+(x1+y)):", findComp(x2, (wchar_t)z)); /* X = X1 + X2 のとき、 X2 + (X1 + Y) を出したい */ \
+                        CHECK_AND_ADD(#tag "1-Y-ADD((x1+y)+x2):", findComp((wchar_t)z, x2)); /* X = X1 + X2 のとき、 (X1 + Y) + X2 を出したい */ \
+                        CHECK_AND_ADD(#tag  "1-Y-ADD(x2+(x1+y)):", findComp(x2, (wchar_t)z)); /* X = X1 + X2 のとき、 X2 + (X1 + Y) を出したい */ \
                     } \
                     if ((z = findComp(x2, y)) != 0) { \
                         _LOG_INFO(MAKE_LSTR(tag, "1-Y-ADD(x2+y)={}"), (wchar_t)z); \
-                        CHECK_AND_RETURN(#tag  "1-Y-ADD(x1+(x2+y)):", findComp(x1, (wchar_t)z)); /* X = X1 + X2 のとき、 X1 + (X2 + Y) を出したい */ \
-                        CHECK_AND_RETURN(#tag  "1-Y-ADD((x2+y)+x1):", findComp((wchar_t)z, x1)); /* X = X1 + X2 のとき、 (X2 + Y) + X1 を出したい */ \
+                        CHECK_AND_ADD(#tag  "1-Y-ADD(x1+(x2+y)):", findComp(x1, (wchar_t)z)); /* X = X1 + X2 のとき、 X1 + (X2 + Y) を出したい */ \
+                        CHECK_AND_ADD(#tag  "1-Y-ADD((x2+y)+x1):", findComp((wchar_t)z, x1)); /* X = X1 + X2 のとき、 (X2 + Y) + X1 を出したい */ \
                     } \
                 }
 #define YAMANOBE_ADD_B(tag, x, y1, y2) { \
@@ -516,13 +664,13 @@ namespace {
                     mchar_t z; \
                     if ((z = findComp(x, y1)) != 0) { \
                         _LOG_INFO(MAKE_LSTR(tag, "2-Y-ADD(x+y1)={}"), (wchar_t)z); \
-                        CHECK_AND_RETURN(#tag  "2-Y-ADD((x+y1)+y2):", findComp((wchar_t)z, y2)); /* Y = Y1 + Y2 のとき、 (X + Y1) + Y2 を出したい */ \
-                        CHECK_AND_RETURN(#tag  "2-Y-ADD(y2+(x+y1)):", findComp(y2, (wchar_t)z)); /* Y = Y1 + Y2 のとき、 Y2 + (X + Y1) を出したい */ \
+                        CHECK_AND_ADD(#tag  "2-Y-ADD((x+y1)+y2):", findComp((wchar_t)z, y2)); /* Y = Y1 + Y2 のとき、 (X + Y1) + Y2 を出したい */ \
+                        CHECK_AND_ADD(#tag  "2-Y-ADD(y2+(x+y1)):", findComp(y2, (wchar_t)z)); /* Y = Y1 + Y2 のとき、 Y2 + (X + Y1) を出したい */ \
                     } \
                     if ((z = findComp(x, y2)) != 0) { \
                         _LOG_INFO(MAKE_LSTR(tag, "2-Y-ADD(x+y2)={}"), (wchar_t)z); \
-                        CHECK_AND_RETURN(#tag  "2-Y-ADD(y1+(x+y2)):", findComp(y1, (wchar_t)z)); /* Y = Y1 + Y2 のとき、 Y1 + (X + Y2) を出したい */ \
-                        CHECK_AND_RETURN(#tag  "2-Y-ADD((x+y2)+y1):", findComp((wchar_t)z, y1)); /* Y = Y1 + Y2 のとき、 (X + Y2) + Y1 を出したい */ \
+                        CHECK_AND_ADD(#tag  "2-Y-ADD(y1+(x+y2)):", findComp(y1, (wchar_t)z)); /* Y = Y1 + Y2 のとき、 Y1 + (X + Y2) を出したい */ \
+                        CHECK_AND_ADD(#tag  "2-Y-ADD((x+y2)+y1):", findComp((wchar_t)z, y1)); /* Y = Y1 + Y2 のとき、 (X + Y2) + Y1 を出したい */ \
                     } \
                 }
 
@@ -544,10 +692,10 @@ namespace {
                 // たとえば、準 = 淮十、隼 = 隹十 のとき、シ準 ⇒ 隼 を出したい
 #define YAMANOBE_SUBTRACT(tag, x, x1, x2, y, y1, y2, z1, z2) \
                 _LOG_INFO(L #tag "-Y-SUB: x={}, x1={}, x2={}, y={}, y1={}, y2={}, z1={}, z2={}", _NC(x), _NC(x1), _NC(x2), _NC(y), _NC(y1), _NC(y2), _NC(z1), _NC(z2)); \
-                if ((z1 != 0 && x2 == z1) || (z2 != 0 && x2 == z2)) CHECK_AND_RETURN(#tag  "-Y-SUB(x1,y):", findComp(x1, y));  /* A := (X1 + X2) + Y && X2 == B ならば X1 + Y (= A - X2) を出したい */ \
-                if ((z1 != 0 && x1 == z1) || (z2 != 0 && x1 == z2)) CHECK_AND_RETURN(#tag  "-Y-SUB(x2,y):", findComp(x2, y));  /* A := (X1 + X2) + Y && X1 == B ならば X2 + Y (= A - X1) を出したい */ \
-                if ((z1 != 0 && y2 == z1) || (z2 != 0 && y2 == z2)) CHECK_AND_RETURN(#tag  "-Y-SUB(x,y1):", findComp(x, y1));  /* A := X + (Y1 + Y2) && Y2 == B ならば X + Y1 (= A - Y2) を出したい */ \
-                if ((z1 != 0 && y1 == z1) || (z2 != 0 && y1 == z2)) CHECK_AND_RETURN(#tag  "-Y-SUB(x,y2):", findComp(x, y2));  /* A := X + (Y1 + Y2) && Y1 == B ならば X + Y2 (= A - Y1) を出したい */
+                if ((z1 != 0 && x2 == z1) || (z2 != 0 && x2 == z2)) CHECK_AND_ADD(#tag  "-Y-SUB(x1,y):", findComp(x1, y));  /* A := (X1 + X2) + Y && X2 == B ならば X1 + Y (= A - X2) を出したい */ \
+                if ((z1 != 0 && x1 == z1) || (z2 != 0 && x1 == z2)) CHECK_AND_ADD(#tag  "-Y-SUB(x2,y):", findComp(x2, y));  /* A := (X1 + X2) + Y && X1 == B ならば X2 + Y (= A - X1) を出したい */ \
+                if ((z1 != 0 && y2 == z1) || (z2 != 0 && y2 == z2)) CHECK_AND_ADD(#tag  "-Y-SUB(x,y1):", findComp(x, y1));  /* A := X + (Y1 + Y2) && Y2 == B ならば X + Y1 (= A - Y2) を出したい */ \
+                if ((z1 != 0 && y1 == z1) || (z2 != 0 && y1 == z2)) CHECK_AND_ADD(#tag  "-Y-SUB(x,y2):", findComp(x, y2));  /* A := X + (Y1 + Y2) && Y1 == B ならば X + Y2 (= A - Y1) を出したい */
 
                 if (a1 && a2) {
                     wchar_t a11, a12, a21, a22;
@@ -566,29 +714,29 @@ namespace {
             }
 
             // 一方が部品による足し算(直後に逆順をやる)
-            CHECK_AND_RETURN("J1", findComp(ca, b1));
-            CHECK_AND_RETURN("K5", findComp(b1, ca));
+            CHECK_AND_ADD("J1", findComp(ca, b1));
+            CHECK_AND_ADD("K5", findComp(b1, ca));
 
-            CHECK_AND_RETURN("J2", findComp(ca, b2));
-            CHECK_AND_RETURN("K6", findComp(b2, ca));
+            CHECK_AND_ADD("J2", findComp(ca, b2));
+            CHECK_AND_ADD("K6", findComp(b2, ca));
 
-            CHECK_AND_RETURN("J3", findComp(eqa, b1));
-            CHECK_AND_RETURN("K7", findComp(b1, eqa));
+            CHECK_AND_ADD("J3", findComp(eqa, b1));
+            CHECK_AND_ADD("K7", findComp(b1, eqa));
 
-            CHECK_AND_RETURN("J4", findComp(eqa, b2));
-            CHECK_AND_RETURN("K8", findComp(b2, eqa));
+            CHECK_AND_ADD("J4", findComp(eqa, b2));
+            CHECK_AND_ADD("K8", findComp(b2, eqa));
 
-            CHECK_AND_RETURN("J5", findComp(a1, cb));
-            CHECK_AND_RETURN("K1", findComp(cb, a1));
+            CHECK_AND_ADD("J5", findComp(a1, cb));
+            CHECK_AND_ADD("K1", findComp(cb, a1));
 
-            CHECK_AND_RETURN("J6", findComp(a2, cb));
-            CHECK_AND_RETURN("K2", findComp(cb, a2));
+            CHECK_AND_ADD("J6", findComp(a2, cb));
+            CHECK_AND_ADD("K2", findComp(cb, a2));
 
-            CHECK_AND_RETURN("J7", findComp(a1, eqb));
-            CHECK_AND_RETURN("K3", findComp(eqb, a1));
+            CHECK_AND_ADD("J7", findComp(a1, eqb));
+            CHECK_AND_ADD("K3", findComp(eqb, a1));
 
-            CHECK_AND_RETURN("J8", findComp(a2, eqb));
-            CHECK_AND_RETURN("K4", findComp(eqb, a2));
+            CHECK_AND_ADD("J8", findComp(a2, eqb));
+            CHECK_AND_ADD("K4", findComp(eqb, a2));
 
             if (SETTINGS->yamanobeEnabled) {
                 // YAMANOBE_ADD (Bが部品)
@@ -620,25 +768,25 @@ namespace {
             }
 
             // 両方が部品による足し算(直後に逆順をやる)
-            CHECK_AND_RETURN("N1", findComp(a1, b1));
-            CHECK_AND_RETURN("O1", findComp(b1, a1));
+            CHECK_AND_ADD("N1", findComp(a1, b1));
+            CHECK_AND_ADD("O1", findComp(b1, a1));
 
-            CHECK_AND_RETURN("N1", findComp(a1, b2));
-            CHECK_AND_RETURN("O1", findComp(b2, a1));
+            CHECK_AND_ADD("N1", findComp(a1, b2));
+            CHECK_AND_ADD("O1", findComp(b2, a1));
 
-            CHECK_AND_RETURN("N1", findComp(a2, b1));
-            CHECK_AND_RETURN("O1", findComp(b1, a2));
+            CHECK_AND_ADD("N1", findComp(a2, b1));
+            CHECK_AND_ADD("O1", findComp(b1, a2));
 
-            CHECK_AND_RETURN("N1", findComp(a2, b2));
-            CHECK_AND_RETURN("O1", findComp(b2, a2));
+            CHECK_AND_ADD("N1", findComp(a2, b2));
+            CHECK_AND_ADD("O1", findComp(b2, a2));
 
             // 部品による引き算
-            if (a2 == b1 || a2 == b2) CHECK_AND_RETURN("P1", a1);
-            if (a1 == b1 || a1 == b2) CHECK_AND_RETURN("P1", a2);
+            if (a2 == b1 || a2 == b2) CHECK_AND_ADD("P1", a1);
+            if (a1 == b1 || a1 == b2) CHECK_AND_ADD("P1", a2);
 
             // 部品による引き算(逆順)
-            if (b2 == a1 || b2 == a2) CHECK_AND_RETURN("Q1", a1);
-            if (b1 == a1 || b1 == a2) CHECK_AND_RETURN("Q1", a2);
+            if (b2 == a1 || b2 == a2) CHECK_AND_ADD("Q1", a1);
+            if (b1 == a1 || b1 == a2) CHECK_AND_ADD("Q1", a2);
 
             if (SETTINGS->yamanobeEnabled) {
                 // YAMANOBE_SUBTRACT (Bが部品)
@@ -661,17 +809,17 @@ namespace {
             // (瞳=目+童 という定義があるとき、目+立 または 目+里 で 瞳 を合成する)
             // ただし、等価文字およびひらがな部品は除く
 #define ADD_BY_COMPOSITE1(tag, cz, eqz, x) \
-            if (cz) CHECK_AND_RETURN(#tag  "(cz,x)", findComp(cz, x)); \
-            if (!eqz.empty()) CHECK_AND_RETURN(#tag  "(eqz,x)", findComp(eqz, x)); \
-            if (cz) CHECK_AND_RETURN(#tag  "(x,cz)", findComp(x, cz)); \
-            if (!eqz.empty()) CHECK_AND_RETURN(#tag  "(x,eqz)", findComp(x, eqz))
+            if (cz) CHECK_AND_ADD(#tag  "(cz,x)", findComp(cz, x)); \
+            if (!eqz.empty()) CHECK_AND_ADD(#tag  "(eqz,x)", findComp(eqz, x)); \
+            if (cz) CHECK_AND_ADD(#tag  "(x,cz)", findComp(x, cz)); \
+            if (!eqz.empty()) CHECK_AND_ADD(#tag  "(x,eqz)", findComp(x, eqz))
 
 #define ADD_BY_COMPOSITE2(tag, cz, z, x) \
             _LOG_INFO(MAKE_LSTR(tag, ": cz={}, z={}, x={}"), _NC(cz), _NC(z), _NC(x)); \
-            if (cz) CHECK_AND_RETURN(#tag  "(cz,x)", findComp(cz, x)); \
-            if (z && z != cz) CHECK_AND_RETURN(#tag  "(z,x)", findComp(z, x)); \
-            if (cz) CHECK_AND_RETURN(#tag  "(x,cz)", findComp(x, cz)); \
-            if (z && z != cz) CHECK_AND_RETURN(#tag  "(x,z)", findComp(x, z))
+            if (cz) CHECK_AND_ADD(#tag  "(cz,x)", findComp(cz, x)); \
+            if (z && z != cz) CHECK_AND_ADD(#tag  "(z,x)", findComp(z, x)); \
+            if (cz) CHECK_AND_ADD(#tag  "(x,cz)", findComp(x, cz)); \
+            if (z && z != cz) CHECK_AND_ADD(#tag  "(x,z)", findComp(x, z))
 
             if (isComposableParts(cb)) {
                 for (auto x : getBodies(cb)) {
@@ -729,14 +877,13 @@ namespace {
             }
 
             // 同じ文字同士の合成の場合は、等価文字を出力する
-            if (ca == cb && !eqa.empty()) CHECK_AND_RETURN("V", *eqa.begin());
+            if (ca == cb && !eqa.empty()) CHECK_AND_ADD("V", *eqa.begin());
 
-            LOG_DEBUGH(_T("result: NULL"));
-            return 0;
+            if (cands.empty()) LOG_DEBUGH(_T("result: NULL"));
         }
 #undef _NC
 #undef _LOG_INFO
-#undef CHECK_AND_RETURN
+#undef CHECK_AND_ADD
 #undef YAMANOBE_ADD_A
 #undef YAMANOBE_ADD_B
 #undef YAMANOBE_SUBTRACT
@@ -763,7 +910,7 @@ namespace {
             wchar_t a, b;
             decompose(m, a, b);
             // m 自身と、それの部品のうち頻度の低い方でやる
-            mchar_t chrs[] = { m, a };
+            mchar_t chrs[] = { m, (mchar_t)a };
             //// 両方の部品を使う
             //mchar_t chrs[] = { m, a, b };
             if (a != 0 && a != m) addIfAbsent(a, list, ms);
@@ -821,9 +968,9 @@ namespace {
             L"徽鷺丙閏榮琥爲櫂斤杷祁穣芹寬橙庚柾珀梧朔弐琢豹皐徠竣枇苺桧彪謄繭璽勺錘銑頒"
             ;
 
-        std::map<mchar_t, size_t> fullPopularCharMap;
+        utils::FlatHashMap<mchar_t, size_t> fullPopularCharMap;
 
-        std::map<mchar_t, size_t> freqPopularCharMap;
+        utils::FlatHashMap<mchar_t, size_t> freqPopularCharMap;
 
 #define FREQ_POPULAR_CHAR_NUM 500
 #define MAX_SIZE_T  static_cast<size_t>(-1)
@@ -834,9 +981,9 @@ namespace {
                 size_t idx = 0;
                 while (*p) {
                     wchar_t ch = *p++;
-                    if (fullPopularCharMap.find(ch) == fullPopularCharMap.end()) fullPopularCharMap[ch] = idx;
+                    fullPopularCharMap.insert(ch, idx);
                     if (idx < FREQ_POPULAR_CHAR_NUM) {
-                        if (freqPopularCharMap.find(ch) == freqPopularCharMap.end()) freqPopularCharMap[ch] = idx;
+                        freqPopularCharMap.insert(ch, idx);
                     }
                     ++idx;
                 }
@@ -845,8 +992,8 @@ namespace {
 
         inline size_t popularIndex(mchar_t ch) {
             if (fullPopularCharMap.empty()) { gatherPopularChars(); }
-            auto pair = fullPopularCharMap.find(ch);
-            return pair == fullPopularCharMap.end() ? MAX_SIZE_T : pair->second;
+            auto pIdx = fullPopularCharMap.find(ch);
+            return pIdx ? *pIdx : MAX_SIZE_T;
         }
 
         inline bool isPopular(mchar_t ch) {
@@ -855,8 +1002,8 @@ namespace {
 
         inline size_t freqPopularIndex(mchar_t ch) {
             if (freqPopularCharMap.empty()) { gatherPopularChars(); }
-            auto pair = freqPopularCharMap.find(ch);
-            return pair == freqPopularCharMap.end() ? -1 : pair->second;
+            auto pIdx = freqPopularCharMap.find(ch);
+            return pIdx ? *pIdx : -1;
         }
 
         inline bool isFreqPopular(mchar_t ch) {
@@ -1061,26 +1208,28 @@ namespace {
 
             // 自動部首合成組み合わせの出力
             if (SETTINGS->autoBushuCompMinCount > 0) {
-                for (const auto& pair : autoBushuDict) {
+                for (auto key : autoBushuDict.sortedKeys()) {
                     if (writer.count() >= MAX_LINES) break;
-                    if (pair.first.size() == 2 && pair.second.target != '-' && pair.second.count >= SETTINGS->autoBushuCompMinCount) {
-                        mchar_t a = pair.first[0];
-                        mchar_t b = pair.first[1];
+                    const auto& target = *autoBushuDict.find(key);
+                    if (target.target != '-' && target.count >= SETTINGS->autoBushuCompMinCount) {
+                        MString parts = autoBushuKeyToMString(key);
+                        mchar_t a = parts[0];
+                        mchar_t b = parts[1];
                         if (isEasyOrFreqPopular(a) && isEasyOrFreqPopular(b)) {
                             writer.writeLine(utils::utf8_encode(
                                 std::format(_T("{}" TAB_TAB "{}"),
                                     to_wstr(a) + VkbTableMaker::ConvCharToStrokeString(b),
-                                    to_wstr(pair.second.target))));
-                            doneSet.insert(to_wstr(pair.first));
+                                    to_wstr(target.target))));
+                            doneSet.insert(to_wstr(parts));
                         }
                     }
                 }
             }
 
             // 部首合成組み合わせの出力
-            for (const auto& pair : compMap) {
-                parts_t parts = pair.first;
-                mchar_t c = pair.second;
+            for (auto key : compMap.sortedKeys()) {
+                parts_t parts(key);
+                mchar_t c = *compMap.find(key);
                 if (isStrokableOrNumeral(c) && isEasyOrFreqPopular(c)) continue;       // ストローク可能で頻度が高ければ対象外
 
                 if (!isPopular(c)) continue;                            // 常用・人名でなければ対象外
@@ -60,6 +60,9 @@ public:
     // a と b を組み合わせてできる自動合成文字を探す。
     virtual mchar_t FindAutoComposite(mchar_t ca, mchar_t cb) = 0;
 
+    // a と b の組み合わせに自動合成文字が登録されている可能性があるか (false なら確実に登録されていない)
+    virtual bool MayHaveAutoComposite(mchar_t ca, mchar_t cb) = 0;
+
     //仮想鍵盤に部首合成ヘルプの情報を設定する
     virtual bool CopyBushuCompHelpToVkbFaces(mchar_t ch, wchar_t* faces, size_t kbLen, size_t kbNum, bool bSetAssoc = false) = 0;
 
@@ -10,6 +10,7 @@
 #include "KanchokuIni.h"
 
 #include "Decoder.h"
+#include "DecoderCommand.h"
 #include "deckey_id_defs.h"
 #include "KeysAndChars/DeckeyToChars.h"
 #include "KeysAndChars/VkbTableMaker.h"
@@ -41,7 +42,7 @@
 #include "StrokeMerger/Merger.h"
 #include "StrokeMerger/StrokeMergerHistoryResidentState.h"
 
-#include "Dymazin/MorphBridge.h"
+#include "DyMazin/MorphBridge.h"
 #include "Ngram/NgramBridge.h"
 #include "Llama/LlamaBridge.h"
 
@@ -129,11 +130,13 @@ public:
     DecoderImpl() : OutParams(0)
     {
         LOG_INFOH(_T("CALLED"));
+        registerCommands();
     }
 
     // デストラクタ
     ~DecoderImpl() {
         LOG_INFOH(_T("CALLED"));
+        DECODER_COMMAND_TABLE->Clear();
         STROKE_MERGER_NODE.reset(0);
     }
 
@@ -250,7 +253,8 @@ public:
     }
     
     // settings の再ロードとストローク木の再構築
-    void reloadSettings(bool bPreLoad = true) {
+    // bBackground なら、ローマ字定義と後置書き換えマップはバックグラウンドで構築してから差し替える
+    void reloadSettings(bool bPreLoad = true, bool bBackground = false) {
         LOG_INFOH(_T("ENTER"));
        
         // settings の事前ロード
@@ -262,7 +266,7 @@ public:
         createDeckeyToCharsInstance();
 
         // ローマ字定義ファイルのロード
-        RomanToKatakana::ReadRomanDefFile(_T("kwroman.def.txt"));
+        if (!bBackground) RomanToKatakana::ReadRomanDefFile(_T("kwroman.def.txt"));
 
         // ストローク木の構築
         createStrokeTrees(L"");
@@ -282,8 +286,22 @@ public:
         // ユーザー単語コストファイルの読み込み
         Lattice2::reloadUserCostFile();
 
-        // グローバルな後置書き換えマップファイルの読み込み
-        Lattice2::reloadGlobalPostRewriteMapFile();
+        if (bBackground) {
+            // ローマ字定義と後置書き換えマップを構築し、差し替えてからユーザー辞書を開き直す
+            String rootDir = SETTINGS->rootDir;
+            DecoderCommandTable::PostReload(_T("reloadSettings"), [rootDir]() -> std::function<void()> {
+                auto installRoman = RomanToKatakana::PrepareRomanDefFile(rootDir, _T("kwroman.def.txt"));
+                auto installRewrite = Lattice2::prepareReloadGlobalPostRewriteMapFile(rootDir);
+                return [installRoman, installRewrite]() {
+                    installRoman();
+                    installRewrite();
+                    MorphBridge::morphReopenUserDics();
+                };
+            });
+        } else {
+            // グローバルな後置書き換えマップファイルの読み込み
+            Lattice2::reloadGlobalPostRewriteMapFile();
+        }
 
         LOG_INFOH(_T("LEAVE"));
     }
@@ -395,6 +413,304 @@ public:
         LOG_INFOH(_T("LEAVE"));
     }
 
+    // コマンドの登録
+    // 重いコマンド(ファイルへの保存など、UI側に結果を返さないもの)は bHeavy = true で登録し、バックグラウンドで実行する
+    void registerCommands() {
+        auto* table = DECODER_COMMAND_TABLE;
+        auto reg = [table](StringRef name, DecoderCommandHandler handler, bool bHeavy = false) { table->Register(name, handler, bHeavy); };
+
+        reg(_T("presendSettings"), [this](const DecoderCommandArgs& args, DecoderOutParams*) {
+            // 設定の先行送出
+            if (args.has(2)) presendSettings(utils::toLower(args.str(1)) == _T("true"), args.str(2));
+        });
+        reg(_T("initializeDecoder"), [this](const DecoderCommandArgs&, DecoderOutParams*) {
+            initializeDecoder();
+        });
+        reg(_T("reloadSettings"), [this](const DecoderCommandArgs&, DecoderOutParams*) {
+            // 設定の再読み込み (辞書類はバックグラウンドで構築してから差し替える)
+            reloadSettings(true, true);
+        });
+        reg(_T("setLogLevel"), [this](const DecoderCommandArgs& args, DecoderOutParams*) {
+            // ログレベルの設定 (引数: logLevel)
+            setLogLevel(args.size() >= 2 ? utils::strToInt(args.str(1)) : Reporting::Logger::LogLevelWarnH);
+        });
+        reg(_T("compileAndLoadUserDic"), [](const DecoderCommandArgs& args, DecoderOutParams*) {
+            // ユーザー交ぜ書き辞書のコンパイルと読み込み (引数: dicDir, ソースファイル名)
+            if (args.size() > 2) MorphBridge::morphCompileAndLoadUserDic(args.str(1), args.str(2));
+        });
+
+        // 履歴・部首合成・部首連想辞書
+        reg(_T("addHistEntry"), [](const DecoderCommandArgs& args, DecoderOutParams*) {
+            // 履歴登録
+            if (!HISTORY_DIC) return;
+            if (args.has(1)) {
+                HISTORY_DIC->AddNewEntryAnyway(args.mstr(1));
+            } else {
+                HISTORY_DIC->AddNewEntryAnyway(OUTPUT_STACK->GetLastJapaneseKey<MString>(32));
+            }
+        });
+        reg(_T("saveHistoryDic"), [](const DecoderCommandArgs&, DecoderOutParams*) {
+            // 履歴辞書の保存
+            if (BUSHU_ASSOC_DIC && HISTORY_DIC) HISTORY_DIC->WriteHistoryDic();
+        }, true);
+        reg(_T("readBushuDic"), [](const DecoderCommandArgs&, DecoderOutParams*) {
+            // 部首合成辞書の再読み込み
+            if (BUSHU_DIC) BushuDic::ReadBushuDic(SETTINGS->bushuFile);
+        });
+        reg(_T("saveBushuDic"), [](const DecoderCommandArgs&, DecoderOutParams*) {
+            // 部首合成辞書の保存
+            if (BUSHU_DIC) BUSHU_DIC->WriteBushuDic();
+        }, true);
+        reg(_T("addBushuEntry"), [](const DecoderCommandArgs& args, DecoderOutParams*) {
+            // 部首合成エントリの追加
+            if (BUSHU_DIC && args.has(1)) BUSHU_DIC->AddBushuEntry(args.str(1));
+        });
+        reg(_T("addAutoBushuEntry"), [](const DecoderCommandArgs& args, DecoderOutParams*) {
+            // 自動部首合成エントリの追加
+            if (BUSHU_DIC && args.has(1)) BUSHU_DIC->AddAutoBushuEntry(args.str(1));
+        });
+        reg(_T("readAutoBushuDic"), [](const DecoderCommandArgs&, DecoderOutParams*) {
+            // 自動部首合成辞書の再読み込み
+            if (BUSHU_DIC) BushuDic::ReadAutoBushuDic(SETTINGS->autoBushuFile);
+        });
+        reg(_T("saveAutoBushuDic"), [](const DecoderCommandArgs&, DecoderOutParams*) {
+            // 自動部首合成辞書の保存
+            if (BUSHU_DIC) BUSHU_DIC->WriteAutoBushuDic();
+        }, true);
+        reg(_T("mergeBushuAssoc"), [](const DecoderCommandArgs&, DecoderOutParams*) {
+            // 部首連想辞書マージ
+            if (BUSHU_ASSOC_DIC) BushuAssocDic::MergeBushuAssocDic(SETTINGS->bushuAssocFile);
+        });
+        reg(_T("mergeBushuAssocEntry"), [](const DecoderCommandArgs& args, DecoderOutParams*) {
+            // 部首連想エントリマージ
+            if (BUSHU_ASSOC_DIC && args.has(1)) BUSHU_ASSOC_DIC->MergeEntry(args.str(1));
+        });
+        reg(_T("saveBushuAssocDic"), [](const DecoderCommandArgs&, DecoderOutParams*) {
+            // 部首連想辞書の保存
+            if (BUSHU_ASSOC_DIC) BUSHU_ASSOC_DIC->WriteBushuAssocDic();
+        }, true);
+        reg(_T("readBushuAssoc"), [this](const DecoderCommandArgs& args, DecoderOutParams* outParams) {
+            // 連想辞書から定義文字列を読み出してくる
+            readBushuAssoc(args.str(1), outParams->faceStrings);
+        });
+
+        // Lattice と Ngram
+        reg(_T("saveRealtimeNgramFile"), [](const DecoderCommandArgs&, DecoderOutParams*) {
+            // リアルタイムNgramファイルの保存
+            // UI側はこの直後に設定を変更・再読み込みする (保存先のファイル名も変わりうる) ので、同期的に実行する
+            Lattice2::saveRealtimeNgramFile();
+        });
+        reg(_T("saveLatticeRelatedFiles"), [](const DecoderCommandArgs&, DecoderOutParams*) {
+            // リアルタイムNgramファイルの保存
+            // UI側はこの直後に設定を再読み込みする (保存先のファイル名も変わりうる) ので、同期的に実行する
+            Lattice2::saveLatticeRelatedFiles();
+        });
+        reg(_T("reloadNgramFiles"), [](const DecoderCommandArgs&, DecoderOutParams*) {
+            // 単語コストファイルとNgramファイルの読み込み (バックグラウンドで構築してから差し替える)
+            // 読み込むファイル名は SETTINGS によって決まるので、ここで取得しておく
+            String rootDir = SETTINGS->rootDir;
+            NgramFileNames files = Lattice2::currentNgramFileNames();
+            DecoderCommandTable::PostReload(_T("reloadNgramFiles"), [rootDir, files]() { return Lattice2::prepareReloadNgramFiles(rootDir, files); });
+        });
+        reg(_T("doMorphAndNgramAnalysis"), [](const DecoderCommandArgs& args, DecoderOutParams*) {
+            // 形態素解析とNgram解析の実行 (引数: 解析対象文字列)
+            Lattice2::doMorphAndNgramAnalysis(args.mstr(1));
+        });
+        reg(_T("enableCandidateLog"), [](const DecoderCommandArgs&, DecoderOutParams*) {
+            // 融合候補の表示を有効化する
+            WORD_LATTICE->enableCandidateLog(true);
+        });
+        reg(_T("disableCandidateLog"), [](const DecoderCommandArgs&, DecoderOutParams*) {
+            // 融合候補の表示を無効化する
+            WORD_LATTICE->enableCandidateLog(false);
+        });
+        reg(_T("saveCandidateLog"), [](const DecoderCommandArgs&, DecoderOutParams*) {
+            // 解候補ログをファイルに書き出す
+            // UI側はこの直後にファイルを読むので、同期的に実行する
+            WORD_LATTICE->saveCandidateLog();
+        });
+        reg(_T("clearMultiStream"), [](const DecoderCommandArgs& args, DecoderOutParams*) {
+            // 融合ストリームのクリア
+            WORD_LATTICE->updateRealtimeNgram(args.mstr(1));
+            WORD_LATTICE->clearAll();
+        });
+
+        // ヘルプと出力の操作
+        reg(_T("showStrokeHelp"), [this](const DecoderCommandArgs& args, DecoderOutParams*) {
+            // ストロークヘルプの表示
+            if (STROKE_HELP) makeStrokeHelp(args.str(1));
+        });
+        reg(_T("showBushuCompHelp"), [this](const DecoderCommandArgs& args, DecoderOutParams*) {
+            // 部首合成ヘルプの表示
+            if (BUSHU_DIC) makeBushuCompHelp(args.str(1));
+        });
+        reg(_T("clearTailRomanStr"), [this](const DecoderCommandArgs&, DecoderOutParams*) {
+            // 末尾のローマ字列を削除
+            clearTailRomanStr();
+        });
+        reg(_T("clearTailHiraganaStr"), [this](const DecoderCommandArgs&, DecoderOutParams*) {
+            // 末尾のひらがな列を削除
+            clearTailHiraganaStr();
+        });
+        reg(_T("setHiraganaBlocker"), [this](const DecoderCommandArgs&, DecoderOutParams*) {
+            // 末尾にひらがなブロッカーを設定
+            setHiraganaBlocker();
+        });
+        reg(_T("setBackspaceBlocker"), [this](const DecoderCommandArgs&, DecoderOutParams*) {
+            // Backspace Blocker のセット
+            setBackspaceBlocker();
+        });
+        reg(_T("cancelRewrite"), [](const DecoderCommandArgs&, DecoderOutParams*) {
+            // 書き換えをキャンセルする
+            OUTPUT_STACK->cancelRewritable();
+        });
+        reg(_T("deleteRemainingState"), [this](const DecoderCommandArgs&, DecoderOutParams*) {
+            // 居残っている一時状態の削除
+            deleteRemainingState();
+        });
+        reg(_T("commitHistory"), [this](const DecoderCommandArgs&, DecoderOutParams*) {
+            // 履歴のコミットと初期化
+            commitHistory();
+        });
+        reg(_T("readUserRomanFile"), [](const DecoderCommandArgs&, DecoderOutParams*) {
+            // ユーザー定義ローマ字辞書ファイルの読み込み
+            HISTORY_DIC->ReadUserRomanFile();
+        });
+
+        // 仮想鍵盤用のストローク表
+        auto regFaces = [reg](StringRef name, void (*maker)(wchar_t*)) {
+            reg(name, [maker](const DecoderCommandArgs&, DecoderOutParams* outParams) { maker(outParams->faceStrings); });
+        };
+        // 主テーブルの外字(左→左または右→右でどちらかに数字キーを含むもの)を集めたストローク表を作成する
+        regFaces(_T("makeExtraCharsStrokePositionTable"), VkbTableMaker::MakeExtraCharsStrokePositionTable1);
+        regFaces(_T("makeExtraCharsStrokePositionTable1"), VkbTableMaker::MakeExtraCharsStrokePositionTable1);
+        // 副テーブルの外字を集めたストローク表を作成する
+        regFaces(_T("makeExtraCharsStrokePositionTable2"), VkbTableMaker::MakeExtraCharsStrokePositionTable2);
+        // 第3テーブルの外字を集めたストローク表を作成する
+        regFaces(_T("makeExtraCharsStrokePositionTable3"), VkbTableMaker::MakeExtraCharsStrokePositionTable3);
+        // アンシフトキー文字配列をストロークの位置に従って並べる
+        regFaces(_T("makeStrokePosition"), VkbTableMaker::MakeKeyCharsStrokePositionTable);
+        regFaces(_T("makeStrokePosition1"), VkbTableMaker::MakeKeyCharsStrokePositionTable);
+        // 第2テーブルから、アンシフトキー文字配列をストロークの位置に従って並べる
+        regFaces(_T("makeStrokePosition2"), VkbTableMaker::MakeKeyCharsStrokePositionTable2);
+        // 第3テーブルから、アンシフトキー文字配列をストロークの位置に従って並べる
+        regFaces(_T("makeStrokePosition3"), VkbTableMaker::MakeKeyCharsStrokePositionTable3);
+        // 同時打鍵のキー文字配列をストロークの位置に従って並べる
+        regFaces(_T("makeComboStrokePosition"), VkbTableMaker::MakeCombinationKeyCharsStrokePositionTable);
+
+        auto regShiftPlane = [reg](StringRef name, void (*maker)(wchar_t*, size_t), int fixedPlane) {
+            reg(name, [maker, fixedPlane](const DecoderCommandArgs& args, DecoderOutParams* outParams) {
+                maker(outParams->faceStrings, fixedPlane > 0 ? fixedPlane : args.toInt(1, 0));
+            });
+        };
+        // シフト面(1: シフト, 2: シフトA, 3: シフトB)のキー文字配列をストロークの位置に従って並べる
+        regShiftPlane(_T("makeShiftStrokePosition1"), VkbTableMaker::MakeShiftPlaneKeyCharsStrokePositionTable1, 1);
+        regShiftPlane(_T("makeShiftAStrokePosition1"), VkbTableMaker::MakeShiftPlaneKeyCharsStrokePositionTable1, 2);
+        regShiftPlane(_T("makeShiftBStrokePosition1"), VkbTableMaker::MakeShiftPlaneKeyCharsStrokePositionTable1, 3);
+        // 指定のシフト面(引数: シフト面)のキー文字配列をストロークの位置に従って並べる (主・副・第3テーブル)
+        regShiftPlane(_T("makeShiftPlaneStrokePosition1"), VkbTableMaker::MakeShiftPlaneKeyCharsStrokePositionTable1, 0);
+        regShiftPlane(_T("makeShiftPlaneStrokePosition2"), VkbTableMaker::MakeShiftPlaneKeyCharsStrokePositionTable2, 0);
+        regShiftPlane(_T("makeShiftPlaneStrokePosition3"), VkbTableMaker::MakeShiftPlaneKeyCharsStrokePositionTable3, 0);
+
+        reg(_T("makeStrokeKeysTable"), [](const DecoderCommandArgs& args, DecoderOutParams* outParams) {
+            // 指定の文字配列をストロークキー配列に変換
+            if (args.has(1)) VkbTableMaker::MakeStrokeKeysTable(outParams->faceStrings, args.str(1));
+        });
+        for (int n = 0; n <= 2; ++n) {
+            // 指定の文字配列を第1ストロークの位置に従って並べかえる
+            reg(n == 0 ? String(_T("reorderByFirstStrokePosition")) : std::format(_T("reorderByFirstStrokePosition{}"), n),
+                [n](const DecoderCommandArgs& args, DecoderOutParams* outParams) {
+                    if (args.has(1)) VkbTableMaker::ReorderByFirstStrokePosition(outParams->faceStrings, args.str(1), n);
+                });
+        }
+        reg(_T("makeHiraganaTable"), [this](const DecoderCommandArgs&, DecoderOutParams* outParams) {
+            // ひらがな50音図の作成
+            makeHiraganaTable(outParams);
+        });
+        reg(_T("makeKatakanaTable"), [this](const DecoderCommandArgs&, DecoderOutParams* outParams) {
+            // カタカナ50音図の作成
+            makeKatakanaTable(outParams);
+        });
+        reg(_T("makeNextStrokeTable"), [this](const DecoderCommandArgs& args, DecoderOutParams*) {
+            // 指定キーに対する次打鍵テーブルの作成
+            if (args.has(1)) makeNextStrokeTable(args.toInt(1, -1), args.toInt(2, -1));
+        });
+        reg(_T("getCharsOrderedByDeckey"), [this](const DecoderCommandArgs&, DecoderOutParams* outParams) {
+            // Deckey順に並んだ通常文字列とシフト文字列を返す
+            getCharsOrderedByDeckey(outParams);
+        });
+
+        // ストローク木
+        reg(_T("createStrokeTrees"), [this](const DecoderCommandArgs& args, DecoderOutParams*) {
+            // ストローク木の再構築
+            createStrokeTrees(args.str(1));
+        });
+        reg(_T("updateStrokeNodes"), [this](const DecoderCommandArgs& args, DecoderOutParams*) {
+            // 後から部分的にストローク定義を解析してストローク木に差し込む
+            updateStrokeNodes(args.str(1));
+        });
+        reg(_T("exchangeCodeTable"), [](const DecoderCommandArgs&, DecoderOutParams* outParams) {
+            // 主・副テーブルを切り替える
+            outParams->strokeTableNum = StrokeTableNode::ExchangeStrokeTable();
+        });
+        reg(_T("useCodeTable1"), [](const DecoderCommandArgs&, DecoderOutParams* outParams) {
+            // 主テーブルに切り替える
+            outParams->strokeTableNum = StrokeTableNode::UseStrokeTable1();
+        });
+        reg(_T("useCodeTable2"), [](const DecoderCommandArgs&, DecoderOutParams* outParams) {
+            // 副テーブルに切り替える
+            outParams->strokeTableNum = StrokeTableNode::UseStrokeTable2();
+        });
+        reg(_T("useCodeTable3"), [](const DecoderCommandArgs&, DecoderOutParams* outParams) {
+            // 第3テーブルに切り替える
+            outParams->strokeTableNum = StrokeTableNode::UseStrokeTable3();
+        });
+
+        // モード・設定の問い合わせと変更
+        reg(_T("isKatakanaMode"), [](const DecoderCommandArgs&, DecoderOutParams* outParams) {
+            // カタカナモードか
+            if (STATE_COMMON->FindRunningState(_T("KatakanaState"))) outParams->resultFlags |= (UINT32)ResultFlags::CurrentModeIsKatakana;
+        });
+        reg(_T("setAutoHistSearchEnabled"), [](const DecoderCommandArgs& args, DecoderOutParams*) {
+            // 自動履歴検索のON/OFF
+            SETTINGS->autoHistSearchEnabled = args.toBool(1);
+        });
+        reg(_T("setKanaTrainingMode"), [](const DecoderCommandArgs& args, DecoderOutParams*) {
+            // かな入力練習モードのON/OFF
+            SETTINGS->kanaTrainingMode = args.toBool(1);
+        });
+
+        // ファイルへの保存
+        reg(_T("saveDictFiles"), [this](const DecoderCommandArgs&, DecoderOutParams*) {
+            // ファイル保存
+            SaveDicts();
+        }, true);
+        reg(_T("SaveRomanStrokeTable"), [](const DecoderCommandArgs& args, DecoderOutParams*) {
+            // ローマ字テーブルを作成してファイルに書き出す
+            VkbTableMaker::SaveRomanStrokeTable(args.str(1), args.str(2));
+        }, true);
+        reg(_T("SaveEelllJsTable"), [](const DecoderCommandArgs&, DecoderOutParams*) {
+            // eelll/JS用テーブルを作成してファイルに書き出す
+            VkbTableMaker::SaveEelllJsTable();
+        }, true);
+        reg(_T("SaveDumpTable"), [](const DecoderCommandArgs&, DecoderOutParams*) {
+            // デバッグ用テーブルを作成してファイルに書き出す
+            VkbTableMaker::SaveDumpTable();
+        }, true);
+
+        // ログ
+        reg(_T("saveTraceLog"), [](const DecoderCommandArgs&, DecoderOutParams*) {
+            Reporting::Logger::SaveLog();
+        }, true);
+        reg(_T("saveMorphLog"), [](const DecoderCommandArgs&, DecoderOutParams*) {
+            MorphBridge::morphSaveLog();
+            NgramBridge::ngramSaveLog();
+        }, true);
+        reg(_T("closeLogger"), [](const DecoderCommandArgs&, DecoderOutParams*) {
+            Reporting::Logger::Close();
+        });
+    }
+
     // コマンド実行
     // cmdParams->inOutData に "コマンド\t引数" の形でコマンドラインが格納されている
     // 結果は outParams で返す
@@ -407,261 +723,10 @@ public:
 
         OutParams = outParams;
 
-        auto items = utils::split(cmdParams->inOutData, '\t');
-        if (!items.empty()) {
-            const auto& cmd = items[0];
-            LOG_INFOH(_T("cmd={}, items.size()={}"), cmd, items.size());
-            if (cmd == _T("presendSettings")) {
-                // 設定の先行送出
-                if (items.size() > 2 && !items[2].empty()) presendSettings(utils::toLower(items[1]) == _T("true"), items[2]);
-            } else if (cmd == _T("initializeDecoder")) {
-                initializeDecoder();
-            } else if (cmd == _T("reloadSettings")) {
-                // 設定の再読み込み
-                //if (items.size() > 1 && !items[1].empty()) reloadSettings(items[1]);
-                reloadSettings();
-                MorphBridge::morphReopenUserDics();
-            } else if (cmd == _T("setLogLevel")) {
-                // ログレベルの設定 (引数: logLevel)
-                int logLevel = Reporting::Logger::LogLevelWarnH;
-                if (items.size() >= 2) {
-                    logLevel = utils::strToInt(items[1]);
-                }
-                setLogLevel(logLevel);
-            } else if (cmd == _T("compileAndLoadUserDic")) {
-                // ユーザー交ぜ書き辞書のコンパイルと読み込み (引数: dicDir, ソースファイル名)
-                if (items.size() > 2) {
-                    MorphBridge::morphCompileAndLoadUserDic(items[1], items[2]);
-                }
-            } else if (cmd == _T("addHistEntry") && HISTORY_DIC) {
-                // 履歴登録
-                if (items.size() >= 2 && !items[1].empty()) {
-                    HISTORY_DIC->AddNewEntryAnyway(to_mstr(items[1]));
-                } else {
-                    HISTORY_DIC->AddNewEntryAnyway(OUTPUT_STACK->GetLastJapaneseKey<MString>(32));
-                }
-            } else if (cmd == _T("saveHistoryDic") && BUSHU_ASSOC_DIC) {
-                // 履歴辞書の保存
-                if (HISTORY_DIC) HISTORY_DIC->WriteHistoryDic();
-            } else if (cmd == _T("readBushuDic") && BUSHU_DIC) {
-                // 部首合成辞書の再読み込み
-                BushuDic::ReadBushuDic(SETTINGS->bushuFile);
-            } else if (cmd == _T("saveBushuDic") && BUSHU_DIC) {
-                // 部首合成辞書の保存
-                BUSHU_DIC->WriteBushuDic();
-            } else if (cmd == _T("addBushuEntry") && BUSHU_DIC && items.size() >= 2 && !items[1].empty()) {
-                // 部首合成エントリの追加
-                BUSHU_DIC->AddBushuEntry(items[1]);
-            } else if (cmd == _T("addAutoBushuEntry") && BUSHU_DIC && items.size() >= 2 && !items[1].empty()) {
-                // 自動部首合成エントリの追加
-                BUSHU_DIC->AddAutoBushuEntry(items[1]);
-            } else if (cmd == _T("readAutoBushuDic") && BUSHU_DIC) {
-                // 自動部首合成辞書の再読み込み
-                BushuDic::ReadAutoBushuDic(SETTINGS->autoBushuFile);
-            } else if (cmd == _T("saveAutoBushuDic") && BUSHU_DIC) {
-                // 自動部首合成辞書の保存
-                BUSHU_DIC->WriteAutoBushuDic();
-            } else if (cmd == _T("mergeBushuAssoc") && BUSHU_ASSOC_DIC) {
-                // 部首連想辞書マージ
-                BushuAssocDic::MergeBushuAssocDic(SETTINGS->bushuAssocFile);
-            } else if (cmd == _T("mergeBushuAssocEntry") && BUSHU_ASSOC_DIC) {
-                // 部首連想エントリマージ
-                if (items.size() >= 2 && !items[1].empty()) {
-                    BUSHU_ASSOC_DIC->MergeEntry(items[1]);
-                }
-            } else if (cmd == _T("saveBushuAssocDic") && BUSHU_ASSOC_DIC) {
-                // 部首連想辞書の保存
-                BUSHU_ASSOC_DIC->WriteBushuAssocDic();
-            //} else if (cmd == _T("addMazegakiEntry")) {
-            //    LOG_DEBUGH(_T("addMazegakiEntry: {}"), items.size() >= 2 && !items[1].empty() ? items[1] : _T("none"));
-            //    if (MAZEGAKI_DIC && items.size() >= 2 && !items[1].empty()) {
-            //        // 交ぜ書きエントリの追加
-            //        MAZEGAKI_DIC->AddMazeDicEntry(items[1], true, false);
-            //    }
-            //} else if (cmd == _T("readMazegakiDic") && BUSHU_ASSOC_DIC) {
-            //    // 交ぜ書き辞書の読み込み
-            //    if (MAZEGAKI_DIC) MAZEGAKI_DIC->ReadMazegakiDic(items[1]);
-            //} else if (cmd == _T("saveMazegakiDic") && BUSHU_ASSOC_DIC) {
-            //    // 交ぜ書き辞書の保存
-            //    if (MAZEGAKI_DIC) MAZEGAKI_DIC->WriteMazegakiDic();
-            } else if (cmd == _T("saveRealtimeNgramFile")) {
-                // リアルタイムNgramファイルの保存
-                Lattice2::saveRealtimeNgramFile();
-            } else if (cmd == _T("saveLatticeRelatedFiles")) {
-                // リアルタイムNgramファイルの保存
-                Lattice2::saveLatticeRelatedFiles();
-            } else if (cmd == _T("reloadNgramFiles")) {
-                // 単語コストファイルとNgramファイルの読み込み
-                Lattice2::reloadNgramFiles();
-            } else if (cmd == _T("doMorphAndNgramAnalysis")) {
-                // 形態素解析とNgram解析の実行 (引数: 解析対象文字列)
-                Lattice2::doMorphAndNgramAnalysis(to_mstr(items.size() > 1 ? items[1] : _T("")));
-            } else if (cmd == _T("showStrokeHelp") && STROKE_HELP) {
-                // ストロークヘルプの表示
-                //OutParams = outParams;
-                makeStrokeHelp(items.size() > 1 ? items[1] : _T(""));
-            } else if (cmd == _T("showBushuCompHelp") && BUSHU_DIC) {
-                // 部首合成ヘルプの表示
-                //OutParams = outParams;
-                makeBushuCompHelp(items.size() > 1 ? items[1] : _T(""));
-            } else if (cmd == _T("clearTailRomanStr")) {
-                // 末尾のローマ字列を削除
-                clearTailRomanStr();
-            } else if (cmd == _T("clearTailHiraganaStr")) {
-                // 末尾のひらがな列を削除
-                clearTailHiraganaStr();
-            } else if (cmd == _T("setHiraganaBlocker")) {
-                // 末尾にひらがなブロッカーを設定
-                setHiraganaBlocker();
-            } else if (cmd == _T("makeExtraCharsStrokePositionTable") || cmd == _T("makeExtraCharsStrokePositionTable1")) {
-                // 主テーブルの外字(左→左または右→右でどちらかに数字キーを含むもの)を集めたストローク表を作成する
-                VkbTableMaker::MakeExtraCharsStrokePositionTable1(outParams->faceStrings);
-            } else if (cmd == _T("makeExtraCharsStrokePositionTable2")) {
-                // 副テーブルの外字(左→左または右→右でどちらかに数字キーを含むもの)を集めたストローク表を作成する
-                VkbTableMaker::MakeExtraCharsStrokePositionTable2(outParams->faceStrings);
-            } else if (cmd == _T("makeExtraCharsStrokePositionTable3")) {
-                // 第3テーブルの外字(左→左または右→右でどちらかに数字キーを含むもの)を集めたストローク表を作成する
-                VkbTableMaker::MakeExtraCharsStrokePositionTable3(outParams->faceStrings);
-            } else if (cmd == _T("makeStrokePosition") || cmd == _T("makeStrokePosition1")) {
-                // アンシフトキー文字配列をストロークの位置に従って並べる
-                VkbTableMaker::MakeKeyCharsStrokePositionTable(outParams->faceStrings);
-            } else if (cmd == _T("makeStrokePosition2")) {
-                // 第2テーブルから、アンシフトキー文字配列をストロークの位置に従って並べる
-                VkbTableMaker::MakeKeyCharsStrokePositionTable2(outParams->faceStrings);
-            } else if (cmd == _T("makeStrokePosition3")) {
-                // 第3テーブルから、アンシフトキー文字配列をストロークの位置に従って並べる
-                VkbTableMaker::MakeKeyCharsStrokePositionTable3(outParams->faceStrings);
-            } else if (cmd == _T("makeShiftStrokePosition1")) {
-                // シフトキー文字配列をストロークの位置に従って並べる
-                VkbTableMaker::MakeShiftPlaneKeyCharsStrokePositionTable1(outParams->faceStrings, 1);
-            } else if (cmd == _T("makeShiftAStrokePosition1")) {
-                // シフトA面のキー文字配列をストロークの位置に従って並べる
-                VkbTableMaker::MakeShiftPlaneKeyCharsStrokePositionTable1(outParams->faceStrings, 2);
-            } else if (cmd == _T("makeShiftBStrokePosition1")) {
-                // シフトB面のキー文字配列をストロークの位置に従って並べる
-                VkbTableMaker::MakeShiftPlaneKeyCharsStrokePositionTable1(outParams->faceStrings, 3);
-            } else if (cmd == _T("makeShiftPlaneStrokePosition1")) {
-                // 指定のシフト面のキー文字配列をストロークの位置に従って並べる
-                size_t shiftPlane = items.size() >= 2 ? utils::strToInt(items[1]) : 0;
-                VkbTableMaker::MakeShiftPlaneKeyCharsStrokePositionTable1(outParams->faceStrings, shiftPlane);
-            } else if (cmd == _T("makeShiftPlaneStrokePosition2")) {
-                // 副テーブルの指定のシフト面のキー文字配列をストロークの位置に従って並べる
-                size_t shiftPlane = items.size() >= 2 ? utils::strToInt(items[1]) : 0;
-                VkbTableMaker::MakeShiftPlaneKeyCharsStrokePositionTable2(outParams->faceStrings, shiftPlane);
-            } else if (cmd == _T("makeShiftPlaneStrokePosition3")) {
-                // 第3テーブルの指定のシフト面のキー文字配列をストロークの位置に従って並べる
-                size_t shiftPlane = items.size() >= 2 ? utils::strToInt(items[1]) : 0;
-                VkbTableMaker::MakeShiftPlaneKeyCharsStrokePositionTable3(outParams->faceStrings, shiftPlane);
-            } else if (cmd == _T("makeComboStrokePosition")) {
-                // シフトキー文字配列をストロークの位置に従って並べる
-                VkbTableMaker::MakeCombinationKeyCharsStrokePositionTable(outParams->faceStrings);
-            } else if (cmd == _T("makeStrokeKeysTable") && items.size() >= 2 && !items[1].empty()) {
-                // 指定の文字配列をストロークキー配列に変換
-                VkbTableMaker::MakeStrokeKeysTable(outParams->faceStrings, items[1]);
-            } else if (cmd == _T("reorderByFirstStrokePosition") && items.size() >= 2 && !items[1].empty()) {
-                // 指定の文字配列を第1ストロークの位置に従って並べかえる
-                VkbTableMaker::ReorderByFirstStrokePosition(outParams->faceStrings, items[1], 0);
-            } else if (cmd == _T("reorderByFirstStrokePosition1") && items.size() >= 2 && !items[1].empty()) {
-                // 指定の文字配列を第1ストロークの位置に従って並べかえる
-                VkbTableMaker::ReorderByFirstStrokePosition(outParams->faceStrings, items[1], 1);
-            } else if (cmd == _T("reorderByFirstStrokePosition2") && items.size() >= 2 && !items[1].empty()) {
-                // 指定の文字配列を第1ストロークの位置に従って並べかえる
-                VkbTableMaker::ReorderByFirstStrokePosition(outParams->faceStrings, items[1], 2);
-            } else if (cmd == _T("makeHiraganaTable")) {
-                // ひらがな50音図の作成
-                makeHiraganaTable(outParams);
-            } else if (cmd == _T("makeKatakanaTable")) {
-                // カタカナ50音図の作成
-                makeKatakanaTable(outParams);
-            } else if (cmd == _T("makeNextStrokeTable")) {
-                // 指定キーに対する次打鍵テーブルの作成
-                if (items.size() > 1 && !items[1].empty()) {
-                    //OutParams = outParams;
-                    int deckey1 = utils::strToInt(items[1], -1);
-                    int deckey2 = items.size() > 2 && !items[2].empty() ? utils::strToInt(items[2], -1) : -1;
-                    makeNextStrokeTable(deckey1, deckey2);
-                }
-            } else if (cmd == _T("getCharsOrderedByDeckey")) {
-                // Deckey順に並んだ通常文字列とシフト文字列を返す
-                getCharsOrderedByDeckey(outParams);
-            } else if (cmd == _T("createStrokeTrees")) {
-                // ストローク木の再構築
-                createStrokeTrees(items.size() >= 2 ? items[1] : L"");
-            } else if (cmd == _T("saveDictFiles")) {
-                // ファイル保存
-                SaveDicts();
-            } else if (cmd == _T("setBackspaceBlocker")) {
-                // Backspace Blocker のセット
-                setBackspaceBlocker();
-            } else if (cmd == _T("SaveRomanStrokeTable")) {
-                // ローマ字テーブルを作成してファイルに書き出す
-                VkbTableMaker::SaveRomanStrokeTable(items.size() >= 2 ? items[1] : L"", items.size() >= 3 ? items[2] : L"");
-            } else if (cmd == _T("SaveEelllJsTable")) {
-                // eelll/JS用テーブルを作成してファイルに書き出す
-                VkbTableMaker::SaveEelllJsTable();
-            } else if (cmd == _T("SaveDumpTable")) {
-                // デバッグ用テーブルを作成してファイルに書き出す
-                VkbTableMaker::SaveDumpTable();
-            } else if (cmd == _T("enableCandidateLog")) {
-                // 融合候補の表示を有効化する
-                WORD_LATTICE->enableCandidateLog(true);
-            } else if (cmd == _T("disableCandidateLog")) {
-                // 融合候補の表示を無効化する
-                WORD_LATTICE->enableCandidateLog(false);
-            } else if (cmd == _T("saveCandidateLog")) {
-                // 解候補ログをファイルに書き出す
-                WORD_LATTICE->saveCandidateLog();
-            } else if (cmd == _T("clearMultiStream")) {
-                // 融合ストリームのクリア
-                WORD_LATTICE->updateRealtimeNgram(items.size() >= 2 ? to_mstr(items[1]) : EMPTY_MSTR);
-                WORD_LATTICE->clearAll();
-            } else if (cmd == _T("exchangeCodeTable")) {
-                // 主・副テーブルを切り替える
-                outParams->strokeTableNum = StrokeTableNode::ExchangeStrokeTable();
-            } else if (cmd == _T("useCodeTable1")) {
-                // 主テーブルに切り替える
-                outParams->strokeTableNum = StrokeTableNode::UseStrokeTable1();
-            } else if (cmd == _T("useCodeTable2")) {
-                // 副テーブルに切り替える
-                outParams->strokeTableNum = StrokeTableNode::UseStrokeTable2();
-            } else if (cmd == _T("useCodeTable3")) {
-                // 第3テーブルに切り替える
-                outParams->strokeTableNum = StrokeTableNode::UseStrokeTable3();
-            } else if (cmd == _T("isKatakanaMode")) {
-                // カタカナモードか
-                if (STATE_COMMON->FindRunningState(_T("KatakanaState"))) outParams->resultFlags |=  (UINT32)ResultFlags::CurrentModeIsKatakana;
-            } else if (cmd == _T("readBushuAssoc")) {
-                // 連想辞書から定義文字列を読み出してくる
-                readBushuAssoc(items[1], outParams->faceStrings);
-            } else if (cmd == _T("updateStrokeNodes")) {
-                // 後から部分的にストローク定義を解析してストローク木に差し込む
-                updateStrokeNodes(items[1]);
-            } else if (cmd == _T("cancelRewrite")) {
-                // 書き換えをキャンセルする
-                OUTPUT_STACK->cancelRewritable();
-            } else if (cmd == _T("setAutoHistSearchEnabled")) {
-                // 自動履歴検索のON/OFF
-                SETTINGS->autoHistSearchEnabled = (items.size() >= 2 && items[1] == _T("true"));
-            } else if (cmd == _T("setKanaTrainingMode")) {
-                // かな入力練習モードのON/OFF
-                SETTINGS->kanaTrainingMode = (items.size() >= 2 && items[1] == _T("true"));
-            } else if (cmd == _T("deleteRemainingState")) {
-                // 居残っている一時状態の削除
-                deleteRemainingState();
-            } else if (cmd == _T("commitHistory")) {
-                // 履歴のコミットと初期化
-                commitHistory();
-            } else if (cmd == _T("readUserRomanFile")) {
-                // ユーザー定義ローマ字辞書ファイルの読み込み
-                HISTORY_DIC->ReadUserRomanFile();
-            } else if (cmd == _T("saveTraceLog")) {
-                Reporting::Logger::SaveLog();
-            } else if (cmd == _T("saveMorphLog")) {
-                MorphBridge::morphSaveLog();
-                NgramBridge::ngramSaveLog();
-            } else if (cmd == _T("closeLogger")) {
-                Reporting::Logger::Close();
-            }
+        DecoderCommandArgs args(utils::split(cmdParams->inOutData, '\t'));
+        if (args.size() > 0) {
+            LOG_INFOH(_T("cmd={}, items.size()={}"), args.name(), args.size());
+            DECODER_COMMAND_TABLE->Dispatch(std::move(args), outParams);
         }
     }
 
@@ -865,7 +930,7 @@ public:
                 for (; i < s.size(); ++i) {
                     if (pos + i >= maxlen) break;
                     if (i >= LONG_VKEY_CHAR_SIZE) {
-                        OutParams->candidateStrings[pos + i - 1] = (wchar_t)'…';
+                        OutParams->candidateStrings[pos + i - 1] = L'…';
                         break;
                     }
                     OutParams->candidateStrings[pos + i] = s[i];
@@ -1084,15 +1149,22 @@ public:
                 LOG_INFO(_T("CALL: BUSHU_ASSOC_DIC->GetEntry({})"), ws[0]);
                 BushuAssocEntry* entry = BUSHU_ASSOC_DIC->GetEntry(ws[0]);
                 if (entry) {
-                    std::vector<MString> list(11);
-                    entry->CopySubList(list, 0, list.size(), true);
+                    // 固定位置の '|' も含めて先頭の11要素を、連想リストをコピーせずに書き出す
+                    const size_t maxItems = 11;
+                    MStringView view = entry->GetListView();
+                    size_t posFixed = entry->GetPosFixed();
+                    size_t nItems = 0;
                     size_t i = 0;
-                    for (auto ms : list) {
-                        if (!ms.empty()) {
-                            auto mp = decomp_mchar(ms[0]);
-                            if (mp.first != 0) buffer[i++] = mp.first;
-                            if (mp.second != 0) buffer[i++] = mp.second;
+                    for (size_t n = 0; !view.empty() && n <= view.size() && nItems < maxItems; ++n) {
+                        if (n == posFixed) {
+                            buffer[i++] = '|';
+                            if (++nItems >= maxItems) break;
                         }
+                        if (n == view.size()) break;
+                        auto mp = decomp_mchar(view[n]);
+                        if (mp.first != 0) buffer[i++] = mp.first;
+                        if (mp.second != 0) buffer[i++] = mp.second;
+                        ++nItems;
                     }
                     buffer[i] = 0;
                 }
@@ -1147,6 +1219,7 @@ namespace {
     template<typename F>
     int invokeDecoderMethod(F method_call, DecoderCommandParams* params) {
         int result = 0;
+        auto lock = DecoderCommandTable::LockDecoder();     // バックグラウンドで実行中の重いコマンドと排他する
         try {
             ERROR_HANDLER->Clear();
             method_call();
@@ -1187,11 +1260,14 @@ int InitializeDecoder(void* , DecoderCommandParams* ) {
 
 // デコーダを終了する
 int FinalizeDecoder(void* pDecoder) {
+    // 実行待ちの重いコマンド(辞書の保存など)を済ませておく
+    DecoderCommandTable::StopWorker();
     auto method_call = [pDecoder]() {
         Decoder* p = (Decoder*)pDecoder;
         p->Destroy();
         delete p;       // デコーダの終了時にデコーダインスタンスを破棄する
         LOG_INFO_UC(_T("======== kw-uni TERMINATED ========\n"));
+        Reporting::Logger::Shutdown();
         Reporting::Logger::Close();
     };
     return invokeDecoderMethod(method_call, nullptr);
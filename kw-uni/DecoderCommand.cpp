@@ -0,0 +1,224 @@
+#include <thread>
+#include <condition_variable>
+
+#include "Logger.h"
+#include "string_utils.h"
+
+#include "ErrorHandler.h"
+#include "DecoderCommand.h"
+
+namespace {
+    DEFINE_LOCAL_LOGGER(DecoderCommand);
+
+    // UI側から呼ばれる関数と重いコマンドの実行とを排他するためのロック
+    std::mutex decoderMutex;
+
+    // -------------------------------------------------------------------
+    // 重いコマンドを実行するバックグラウンドのスレッド
+    // 最初に重いコマンドが投入されたときに起動し、投入順に1つずつ実行する
+    class CommandWorker {
+        std::mutex queueMutex;
+        std::condition_variable queueCond;
+        std::deque<std::function<void()>> tasks;
+        std::thread worker;
+        bool bStopRequested = false;
+
+        void run() {
+            while (true) {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(queueMutex);
+                    queueCond.wait(lock, [this]() { return bStopRequested || !tasks.empty(); });
+                    if (tasks.empty()) break;       // 停止要求があり、かつ実行待ちがない
+                    task = std::move(tasks.front());
+                    tasks.pop_front();
+                }
+                task();
+            }
+        }
+
+    public:
+        void Post(std::function<void()>&& task) {
+            {
+                std::lock_guard<std::mutex> lock(queueMutex);
+                if (!worker.joinable()) {
+                    bStopRequested = false;
+                    worker = std::thread([this]() { run(); });
+                }
+                tasks.push_back(std::move(task));
+            }
+            queueCond.notify_one();
+        }
+
+        void Stop() {
+            {
+                std::lock_guard<std::mutex> lock(queueMutex);
+                if (!worker.joinable()) return;
+                bStopRequested = true;
+            }
+            queueCond.notify_one();
+            worker.join();
+            worker = std::thread();
+        }
+    };
+
+    // DLL のアンロード時にスレッドの join を待つことのないよう、インスタンスは破棄しない
+    CommandWorker& commandWorker() {
+        static CommandWorker* p = new CommandWorker();
+        return *p;
+    }
+
+    // 例外を捕捉してログに出す (バックグラウンドのスレッドから呼び出し元に返す手段がないため)
+    template<typename F>
+    void invokeSafely(const String& name, F func) {
+        try {
+            func();
+        }
+        catch (ErrorHandler* pErr) {
+            if (pErr) LOG_ERROR(_T("{}: {}"), name, pErr->GetErrorMsg());
+        }
+        catch (String msg) {
+            LOG_ERROR(_T("{}: {}"), name, msg);
+        }
+        catch (const std::exception& e) {
+            LOG_ERROR(_T("{}: {}"), name, utils::utf8_decode(e.what()));
+        }
+        catch (...) {
+            LOG_ERROR(_T("{}: Some exception caught"), name);
+        }
+    }
+
+    // 重いコマンドをデコーダのロックを取得して実行する (エラーはログに出すだけ)
+    void runHeavyCommand(const DecoderCommandHandler& handler, const DecoderCommandArgs& args) {
+        std::lock_guard<std::mutex> lock(decoderMutex);
+        LOG_INFOH(_T("ENTER: cmd={}"), args.name());
+        invokeSafely(args.name(), [&handler, &args]() {
+            ERROR_HANDLER->Clear();
+            handler(args, nullptr);
+            if (ERROR_HANDLER->GetErrorLevel() < 0) {
+                LOG_WARN(_T("cmd={}: {}"), args.name(), ERROR_HANDLER->GetErrorMsg());
+            }
+        });
+        LOG_INFOH(_T("LEAVE: cmd={}"), args.name());
+    }
+
+    // 新しい世代をロックなしで構築し、ロックを取得して差し替える
+    void runReload(const String& name, const DecoderReloadPreparer& prepare) {
+        LOG_INFOH(_T("ENTER: {}"), name);
+        std::function<void()> install;
+        invokeSafely(name, [&prepare, &install]() { install = prepare(); });
+        if (install) {
+            std::lock_guard<std::mutex> lock(decoderMutex);
+            invokeSafely(name, install);
+            LOG_INFOH(_T("INSTALLED: {}"), name);
+        }
+        // 古い世代は install とともにここで(ロックの外で)破棄される
+        LOG_INFOH(_T("LEAVE: {}"), name);
+    }
+}
+
+// -------------------------------------------------------------------
+// DecoderCommandTable - デコーダコマンド表
+DEFINE_CLASS_LOGGER(DecoderCommandTable);
+
+DecoderCommandTable* DecoderCommandTable::Singleton() {
+    static DecoderCommandTable table;
+    return &table;
+}
+
+uint64_t DecoderCommandTable::calcHash(const wchar_t* name, size_t len, uint64_t seed) {
+    // FNV-1a に seed を混ぜ、最後に上位ビットを下位に落とす
+    uint64_t h = 0xcbf29ce484222325ULL ^ (seed * 0x9E3779B97F4A7C15ULL);
+    for (size_t i = 0; i < len; ++i) {
+        h ^= (uint64_t)name[i];
+        h *= 0x100000001b3ULL;
+    }
+    h ^= h >> 29;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 32;
+    return h;
+}
+
+// 全コマンド名が衝突しない seed とテーブルサイズを探す
+void DecoderCommandTable::rebuildIndex() {
+    size_t tableSize = 16;
+    while (tableSize < entries.size() * 4) tableSize *= 2;
+
+    while (true) {
+        for (uint64_t s = 1; s <= 64; ++s) {
+            slots.assign(tableSize, -1);
+            bool ok = true;
+            for (size_t i = 0; i < entries.size(); ++i) {
+                const String& name = entries[i].name;
+                size_t pos = (size_t)calcHash(name.c_str(), name.size(), s) & (tableSize - 1);
+                if (slots[pos] >= 0) {
+                    ok = false;
+                    break;
+                }
+                slots[pos] = (int)i;
+            }
+            if (ok) {
+                seed = s;
+                mask = tableSize - 1;
+                bIndexDirty = false;
+                LOG_INFO(_T("commands={}, tableSize={}, seed={}"), entries.size(), tableSize, seed);
+                return;
+            }
+        }
+        tableSize *= 2;
+    }
+}
+
+const DecoderCommandTable::Entry* DecoderCommandTable::findEntry(const String& name) {
+    if (bIndexDirty) rebuildIndex();
+    if (slots.empty()) return 0;
+    int n = slots[(size_t)calcHash(name.c_str(), name.size(), seed) & mask];
+    return n >= 0 && entries[n].name == name ? &entries[n] : 0;
+}
+
+void DecoderCommandTable::Register(StringRef name, DecoderCommandHandler handler, bool bHeavy) {
+    for (auto& entry : entries) {
+        if (entry.name == name) {
+            entry.handler = handler;
+            entry.bHeavy = bHeavy;
+            return;
+        }
+    }
+    entries.push_back(Entry{ name, handler, bHeavy });
+    bIndexDirty = true;
+}
+
+void DecoderCommandTable::Clear() {
+    entries.clear();
+    slots.clear();
+    bIndexDirty = true;
+}
+
+bool DecoderCommandTable::Dispatch(DecoderCommandArgs&& args, DecoderOutParams* outParams) {
+    const Entry* entry = findEntry(args.name());
+    if (!entry) {
+        LOG_INFOH(_T("unknown command: {}"), args.name());
+        return false;
+    }
+    if (entry->bHeavy) {
+        // ハンドラと引数はコピーして渡す (実行までに表が変更されてもよいように)
+        LOG_INFOH(_T("post heavy command: {}"), args.name());
+        commandWorker().Post([handler = entry->handler, args = std::move(args)]() { runHeavyCommand(handler, args); });
+    } else {
+        entry->handler(args, outParams);
+    }
+    return true;
+}
+
+void DecoderCommandTable::PostReload(StringRef name, DecoderReloadPreparer prepare) {
+    LOG_INFOH(_T("post reload: {}"), name);
+    commandWorker().Post([name = String(name), prepare]() { runReload(name, prepare); });
+}
+
+void DecoderCommandTable::StopWorker() {
+    commandWorker().Stop();
+}
+
+std::unique_lock<std::mutex> DecoderCommandTable::LockDecoder() {
+    return std::unique_lock<std::mutex>(decoderMutex);
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "string_type.h"
+#include "string_utils.h"
+#include "Logger.h"
+
+struct DecoderOutParams;
+
+// -------------------------------------------------------------------
+// デコーダコマンドの引数
+// UI側から送られてきたコマンドラインをタブで分割したもの (0番目はコマンド名)
+class DecoderCommandArgs {
+    std::vector<String> items;
+
+    inline static const String emptyStr;
+
+public:
+    DecoderCommandArgs(std::vector<String>&& items) : items(std::move(items)) { }
+
+    inline size_t size() const { return items.size(); }
+
+    inline const String& name() const { return items.empty() ? emptyStr : items[0]; }
+
+    // n番目の引数が空でなく存在するか
+    inline bool has(size_t n) const { return n < items.size() && !items[n].empty(); }
+
+    // n番目の引数 (なければ空文字列)
+    inline const String& str(size_t n) const { return n < items.size() ? items[n] : emptyStr; }
+
+    inline MString mstr(size_t n) const { return to_mstr(str(n)); }
+
+    // n番目の引数を整数として取得 (空または数値でなければ defval)
+    inline int toInt(size_t n, int defval = 0) const { return has(n) ? utils::strToInt(items[n], defval) : defval; }
+
+    // n番目の引数が "true" か
+    inline bool toBool(size_t n) const { return str(n) == _T("true"); }
+};
+
+// コマンドハンドラ (重いコマンドでは outParams は nullptr になる)
+using DecoderCommandHandler = std::function<void(const DecoderCommandArgs& args, DecoderOutParams* outParams)>;
+
+// 再読み込みの準備関数
+// 辞書やテーブルの新しい世代を構築し、それを現在の世代と差し替える関数を返す
+// (デコーダの状態には触れず、必要なパスなどは呼び出し時に値として受け取っておくこと)
+using DecoderReloadPreparer = std::function<std::function<void()>()>;
+
+// -------------------------------------------------------------------
+// デコーダコマンド表
+// - コマンド名から完全ハッシュでハンドラを引く (登録後、最初の実行時にハッシュを作り直す)
+// - 各サブシステムは Register() で自分のコマンドを登録する
+// - bHeavy で登録したコマンドは、呼び出し元には即座に戻り、バックグラウンドのスレッドで
+//   デコーダのロックを取得してから実行する (打鍵処理とは同時に走らない)
+//   ERROR_HANDLER に設定されたエラーはログに出すだけで、呼び出し元 (inOutData) には返らない。
+//   UI側が実行直後にその結果 (書き出したファイルなど) を使うコマンドや、直後の設定変更の影響を受けるコマンドは bHeavy にしないこと
+class DecoderCommandTable {
+    DECLARE_CLASS_LOGGER;
+
+    struct Entry {
+        String name;
+        DecoderCommandHandler handler;
+        bool bHeavy;
+    };
+
+    std::vector<Entry> entries;
+
+    // 完全ハッシュ: (hash(name, seed) & mask) の位置に entries のインデックスを置く (空きは -1)
+    std::vector<int> slots;
+    uint64_t seed = 0;
+    size_t mask = 0;
+    bool bIndexDirty = true;
+
+    static uint64_t calcHash(const wchar_t* name, size_t len, uint64_t seed);
+
+    void rebuildIndex();
+
+    const Entry* findEntry(const String& name);
+
+public:
+    static DecoderCommandTable* Singleton();
+
+    // コマンドを登録する (同名のコマンドがあれば置き換える)
+    void Register(StringRef name, DecoderCommandHandler handler, bool bHeavy = false);
+
+    // すべてのコマンドの登録を解除する
+    void Clear();
+
+    // コマンドを実行する。登録されていないコマンドなら false を返す
+    bool Dispatch(DecoderCommandArgs&& args, DecoderOutParams* outParams);
+
+    // 再読み込みをバックグラウンドで行う
+    // prepare() はロックを取得せずに実行し、返された差し替え関数はデコーダのロックを取得して実行する
+    // 差し替えられた古い世代は、ロックを解放した後に差し替え関数とともに破棄される
+    static void PostReload(StringRef name, DecoderReloadPreparer prepare);
+
+    // 実行待ちの重いコマンドをすべて実行してから、バックグラウンドのスレッドを停止する
+    // (デコーダのロックを保持したまま呼んではならない)
+    static void StopWorker();
+
+    // デコーダのロック -- UI側から呼ばれる関数と重いコマンドの実行とを排他する
+    static std::unique_lock<std::mutex> LockDecoder();
+};
+
+#define DECODER_COMMAND_TABLE (DecoderCommandTable::Singleton())
@@ -11,6 +11,10 @@
 namespace DymazinBridge {
     DEFINE_LOCAL_LOGGER(DymazinBridge);
 
+    // 形態素解析の入出力バッファ (呼び出しごとに確保しないよう、スレッドごとに使い回す)
+    thread_local std::vector<wchar_t> analyzeInBuf;
+    thread_local std::vector<wchar_t> analyzeOutBuf;
+
     int dymazinInitialize(StringRef rcfile, StringRef dicdir, int unkMax, int mazePenalty, int mazeConnPenalty, int nonTerminalCost) {
         LOG_INFOH(_T("ENTER: rcfile={}, dicdir={}, unkMax={}, mazePenalty={}, mazeConnPenalty={}, nonTerminalCost={}, costWithoutEOS={}, -O{}"),
             rcfile, dicdir, unkMax, mazePenalty, mazeConnPenalty, nonTerminalCost, SETTINGS->morphCostWithoutEOS, SETTINGS->morphMazeFormat);
@@ -101,13 +105,25 @@ namespace DymazinBridge {
         //_LOG_TEMPW(L"ENTER");
         _LOG_DEBUGH(_T("ENTER: str={}"), to_wstr(str));
         const size_t BUFSIZE = 10000;
-        std::vector<wchar_t> wchbuf(BUFSIZE, L'\0');
+        std::vector<wchar_t>& inBuf = analyzeInBuf;
+        std::vector<wchar_t>& wchbuf = analyzeOutBuf;
+        inBuf.resize(str.size() * utils::WCHARS_MAX_PER_MCHAR + 1);
+        auto conv = utils::mchars_to_wchars(str, std::span<wchar_t>(inBuf.data(), inBuf.size() - 1));
+        inBuf[conv.written] = L'\0';
+        if (wchbuf.size() < BUFSIZE) wchbuf.resize(BUFSIZE);
+        wchbuf[0] = L'\0';
         const int ARRAY_SIZE = 1024;
         wchar_t errMsgBuf[ARRAY_SIZE] = { 0 };
-        int cost = DymazinAnalyze(to_wstr(str).c_str(), wchbuf.data(), BUFSIZE, mazePenalty, mazeConnPenalty, allowNonTerminal, false, errMsgBuf, ARRAY_SIZE);
+        int cost = DymazinAnalyze(inBuf.data(), wchbuf.data(), BUFSIZE, mazePenalty, mazeConnPenalty, allowNonTerminal, false, errMsgBuf, ARRAY_SIZE);
         _LOG_DEBUGH(_T("wchbuf:\n----------------\n{}\n----------------"), wchbuf.data());
-        for (const auto& s : utils::split(wchbuf.data(), L'\n')) {
-            morphs.push_back(to_mstr(s));
+        // 改行で区切られた形態素を、バッファから直接 MString に変換する (末尾の空行も含めて utils::split と同じく区切る)
+        std::wstring_view rest(wchbuf.data());
+        while (true) {
+            size_t pos = rest.find(L'\n');
+            morphs.emplace_back();
+            utils::append_wstr_to_mstr(rest.substr(0, pos), morphs.back());
+            if (pos == std::wstring_view::npos) break;
+            rest.remove_prefix(pos + 1);
         }
         _LOG_DEBUGH(_T("LEAVE: dymazinCost={}, morphs={}"), cost, to_wstr(utils::join(morphs, ' ')));
         //_LOG_TEMPW(L"LEAVE");
@@ -1,5 +1,3 @@
-#pragma once
-
 #include "utils/path_utils.h"
 #include "Reporting/Logger.h"
 #include "Settings/Settings.h"
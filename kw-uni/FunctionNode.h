@@ -4,6 +4,13 @@
 #include "Node.h"
 
 class FunctionNode : public Node {
+    // 生成時に FunctionNodeManager::CreateFunctionNode に渡された機能指定
+    String funcSpec;
+
 public:
     NodeType getNodeType() const { return NodeType::FunctionT; }
+
+    inline void setFuncSpec(StringRef spec) { funcSpec = spec; }
+
+    inline StringRef getFuncSpec() const { return funcSpec; }
 };
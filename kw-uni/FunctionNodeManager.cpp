@@ -2,6 +2,7 @@
 #include "Logger.h"
 
 #include "FunctionNodeManager.h"
+#include "FunctionNode.h"
 
 DEFINE_CLASS_LOGGER(FunctionNodeManager);
 
@@ -20,7 +21,11 @@ void FunctionNodeManager::addFunctionNodeBuilder(StringRef spec, StringRef name,
 Node* FunctionNodeManager::CreateFunctionNode(StringRef funcSpec) {
     auto builder = funcNodeMap.find(funcSpec);
     if (builder != funcNodeMap.end()) {
-        return builder->second->CreateNode();
+        Node* node = builder->second->CreateNode();
+        // コンパイル済みストロークテーブルから復元できるように、機能指定を覚えておく
+        FunctionNode* funcNode = dynamic_cast<FunctionNode*>(node);
+        if (funcNode) funcNode->setFuncSpec(funcSpec);
+        return node;
     } else {
         return 0;
     }
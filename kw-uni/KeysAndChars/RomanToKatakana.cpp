@@ -1,8 +1,11 @@
+#include <bitset>
+
 #include "Logger.h"
 #include "file_utils.h"
 #include "path_utils.h"
 #include "Settings.h"
 #include "Constants.h"
+#include "flat_hash_map.h"
 
 #include "RomanToKatakana.h"
 
@@ -306,15 +309,41 @@ namespace RomanToKatakana {
         }
     }
 
-    class RomanRewriteInfo {
+    // 1つのキーとして照合する最大文字数
+    const size_t MAX_KEY_LEN = 4;
+
+    // 文字クラス (例: "%$", "@^N")
+    // 定義の読み込み時に、ASCII文字に対する判定結果を表にしておく
+    class CharClass {
     private:
-        std::vector<String> preChars;      // 対象文字列より前の部分の文字クラス列
-        std::vector<String> postChars;     // 対象文字列より後の部分の文字クラス列
+        std::bitset<128> asciiMatch;    // ASCII文字に対する判定結果
+        bool hasHead = false;           // ^ より前の部分があるか
+        bool headConsonant = false;     // ^ より前の部分に % (子音) を含むか
+        bool tailConsonant = false;     // ^ より後の部分に % (子音) を含むか
+        String headOthers;              // ^ より前の部分に含まれる非ASCII文字
+        String tailOthers;              // ^ より後の部分に含まれる非ASCII文字
 
-        bool matchCharClass(wchar_t ch, StringRef cc) const {
-            LOG_DEBUGH(_T("CALLED: ch={}, cc={}"), ch, cc);
-            if (cc.empty()) return true;
+        static bool matchCharClass(wchar_t ch, StringRef cchead, StringRef cctail) {
             wchar_t co = ch == '$' ? '$' : isVowel(ch) ? '@' : '%';
+            if (!cchead.empty()) {
+                if (cchead.find(ch) == String::npos && cchead.find(co) == String::npos) return false;
+            }
+            if (!cctail.empty()) {
+                if (cctail.find(ch) != String::npos || cctail.find(co) != String::npos) return false;
+            }
+            return true;
+        }
+
+        static String nonAsciiChars(StringRef s) {
+            String result;
+            for (auto ch : s) {
+                if (ch >= 0x80) result.push_back(ch);
+            }
+            return result;
+        }
+
+    public:
+        CharClass(StringRef cc) {
             size_t hatPos = cc.find('^');
             String cchead;
             String cctail;
@@ -325,75 +354,126 @@ namespace RomanToKatakana {
             } else {
                 cchead = cc;
             }
-            if (!cchead.empty()) {
-                if (cchead.find(ch) == String::npos && cchead.find(co) == String::npos) return false;
-            }
-            if (!cctail.empty()) {
-                if (cctail.find(ch) != String::npos || cctail.find(co) != String::npos) return false;
+            for (wchar_t ch = 0; ch < 0x80; ++ch) {
+                asciiMatch[ch] = matchCharClass(ch, cchead, cctail);
             }
+            hasHead = !cchead.empty();
+            headConsonant = cchead.find('%') != String::npos;
+            tailConsonant = cctail.find('%') != String::npos;
+            headOthers = nonAsciiChars(cchead);
+            tailOthers = nonAsciiChars(cctail);
+        }
+
+        // 非ASCII文字は子音(%)として扱う
+        inline bool match(wchar_t ch) const {
+            if (ch < 0x80) return asciiMatch[ch];
+            if (hasHead && !headConsonant && headOthers.find(ch) == String::npos) return false;
+            if (tailConsonant || tailOthers.find(ch) != String::npos) return false;
             return true;
         }
+    };
 
-    public:
-        String katakanaStr;                // 変換後のカタカナ
+    // 変換対象の単語
+    // 元の文字列を、大文字化して前後に $ を付けたものとして参照する
+    class RomanWord {
+        const MString& str;
 
     public:
-        RomanRewriteInfo() {
-        }
+        RomanWord(const MString& s) : str(s) { }
 
-        RomanRewriteInfo(const RomanRewriteInfo& info)
-            : preChars(info.preChars), postChars(info.postChars), katakanaStr(info.katakanaStr) {
-        }
+        inline size_t size() const { return str.size() + 2; }
 
-        const RomanRewriteInfo& operator=(const RomanRewriteInfo& info) {
-            preChars = info.preChars;
-            postChars = info.postChars;
-            katakanaStr = info.katakanaStr;
-            return *this;
+        inline wchar_t operator[](size_t i) const {
+            return i == 0 || i > str.size() ? '$' : wchar_t(langedge::CtypeUtil::toUpper(str[i - 1]));
         }
+    };
+
+    class RomanRewriteInfo {
+    private:
+        std::vector<CharClass> preChars;      // 対象文字列より前の部分の文字クラス列
+        std::vector<CharClass> postChars;     // 対象文字列より後の部分の文字クラス列
+
+    public:
+        MString katakanaStr;                // 変換後のカタカナ
 
+    public:
         void addCharClass(StringRef cc, bool bPre) {
             if (bPre) {
-                preChars.push_back(cc);
+                preChars.push_back(CharClass(cc));
             } else {
-                postChars.push_back(cc);
+                postChars.push_back(CharClass(cc));
             }
         }
 
         void addTailConsonant() {
             if (postChars.empty()) {
-                postChars.push_back(_T("%$"));
+                postChars.push_back(CharClass(_T("%$")));
             }
         }
 
-        bool match(StringRef key, StringRef w, size_t pos) const {
-            LOG_DEBUGH(_T("CALLED: key={}, word={}, pos={}, pre={}, post={}"), key, w, pos, utils::join(preChars, _T(":")), utils::join(postChars, _T(":")));
+        // w の pos から始まる keyLen 文字のキーについて、前後の文字クラスが一致するか
+        bool match(const RomanWord& w, size_t pos, size_t keyLen) const {
             if (pos < preChars.size()) return false;
-            if (pos + key.size() + postChars.size() > w.size()) return false;
-            if (!preChars.empty()) {
-                LOG_DEBUGH(_T("Check preChars"));
-                size_t p = pos - preChars.size();
-                for (size_t i = 0; i < preChars.size(); ++i) {
-                    if (!matchCharClass(w[p + i], preChars[i])) return false;
-                }
+            if (pos + keyLen + postChars.size() > w.size()) return false;
+            size_t p = pos - preChars.size();
+            for (size_t i = 0; i < preChars.size(); ++i) {
+                if (!preChars[i].match(w[p + i])) return false;
             }
-            if (!postChars.empty()) {
-                LOG_DEBUGH(_T("Check postChars"));
-                size_t p = pos + key.size();
-                for (size_t i = 0; i < postChars.size(); ++i) {
-                    if (!matchCharClass(w[p + i], postChars[i])) return false;
-                }
+            p = pos + keyLen;
+            for (size_t i = 0; i < postChars.size(); ++i) {
+                if (!postChars[i].match(w[p + i])) return false;
             }
-            LOG_DEBUGH(_T("MATCH"));
             return true;
         }
+    };
+
+    // ローマ字キーのトライ
+    // ノード間の遷移は (ノード番号, 文字) をキーとしたハッシュで引く
+    class RomanTrie {
+    private:
+        std::vector<std::vector<RomanRewriteInfo>> nodeInfos;   // 各ノードで終わるキーに対する書き換え情報 (定義順)
+        utils::FlatHashMap<uint64_t, uint32_t> transitions;
+        size_t keyNum = 0;
+
+        static inline uint64_t transitionKey(size_t node, wchar_t ch) { return ((uint64_t)node << 32) | (uint32_t)ch; }
+
+    public:
+        RomanTrie() {
+            clear();
+        }
+
+        void clear() {
+            nodeInfos.assign(1, std::vector<RomanRewriteInfo>());
+            transitions.clear();
+            keyNum = 0;
+        }
 
-        String toString() {
-            return std::format(_T("pre={}, post={}, katakana={}"), utils::join(preChars, _T(":")), utils::join(postChars, _T(":")), katakanaStr);
+        inline bool empty() const { return keyNum == 0; }
+
+        void add(StringRef key, const RomanRewriteInfo& info) {
+            size_t node = 0;
+            for (auto ch : key) {
+                uint32_t& next = transitions[transitionKey(node, ch)];
+                if (next == 0) {
+                    next = (uint32_t)nodeInfos.size();
+                    nodeInfos.push_back(std::vector<RomanRewriteInfo>());
+                }
+                node = next;
+            }
+            if (nodeInfos[node].empty()) ++keyNum;
+            nodeInfos[node].push_back(info);
+        }
+
+        // node から ch で遷移した先のノードを返す。遷移できなければ 0 (ルート)
+        inline size_t next(size_t node, wchar_t ch) const {
+            const uint32_t* p = transitions.find(transitionKey(node, ch));
+            return p ? *p : 0;
         }
+
+        inline const std::vector<RomanRewriteInfo>& infos(size_t node) const { return nodeInfos[node]; }
     };
 
-    std::map<String, std::vector<RomanRewriteInfo>> romanKatakanaTbl;
+    RomanTrie romanKatakanaTbl;
 
     std::vector<String> _split(StringRef s) {
         std::vector<String> items;
@@ -412,15 +492,15 @@ namespace RomanToKatakana {
         return items;
     }
 
-    void loadRomanDefLines(const std::vector<String>& lines) {
-        romanKatakanaTbl.clear();
+    void loadRomanDefLines(const std::vector<String>& lines, RomanTrie& tbl) {
+        tbl.clear();
         for (const auto& line : lines) {
             if (!line.empty()) {
                 auto items = _split(utils::toUpper(line));
                 if (items.size() == 2 && !items[0].empty() && !items[1].empty() && items[0][0] != '#' ) {
                     RomanRewriteInfo info;
                     if (items[1] != _T("\"\"")) {
-                        info.katakanaStr = items[1];
+                        info.katakanaStr = to_mstr(items[1]);
                     }
                     String def = items[0];
                     String key;
@@ -450,14 +530,8 @@ namespace RomanToKatakana {
                     }
                     if (!key.empty()) {
                         if (!isVowel(key.back())) info.addTailConsonant();
-                        LOG_DEBUGH(_T("ADD: line={} {}, key={}, info={}"), items[0], items[1], key, info.toString());
-                        auto iter = romanKatakanaTbl.find(key);
-                        if (iter == romanKatakanaTbl.end()) {
-                            romanKatakanaTbl[key] = std::vector<RomanRewriteInfo>();
-                            romanKatakanaTbl[key].push_back(info);
-                        } else {
-                            iter->second.push_back(info);
-                        }
+                        LOG_DEBUGH(_T("ADD: line={} {}, key={}"), items[0], items[1], key);
+                        tbl.add(key, info);
                     }
                 }
             }
@@ -465,30 +539,29 @@ namespace RomanToKatakana {
 
     }
 
-    // ローマ字定義ファイルを読み込む
-    void ReadRomanDefFile(StringRef defFile) {
+    // ローマ字定義ファイルを現在の定義とは別に読み込み、それに差し替える関数を返す
+    std::function<void()> PrepareRomanDefFile(StringRef rootDir, StringRef defFile) {
         LOG_INFO(_T("open roman def file: {}"), defFile);
-        auto path = utils::joinPath(SETTINGS->rootDir, utils::joinPath(USER_FILES_FOLDER, defFile));
+        auto path = utils::joinPath(rootDir, utils::joinPath(USER_FILES_FOLDER, defFile));
         if (!utils::isFileExistent(path)) {
-            path = utils::joinPath(SETTINGS->rootDir, utils::joinPath(SYSTEM_FILES_FOLDER, defFile));
+            path = utils::joinPath(rootDir, utils::joinPath(SYSTEM_FILES_FOLDER, defFile));
         }
+        auto tbl = std::make_shared<RomanTrie>();
         utils::IfstreamReader reader(path);
         if (reader.success()) {
-            loadRomanDefLines(reader.getAllLines());
+            loadRomanDefLines(reader.getAllLines(), *tbl);
             LOG_INFO(_T("close roman def: {}"), path);
         } else {
-            //// ファイルがなかったらデフォルトを使う
-            //LOG_WARN(_T("Can't read roman def file: {}"), path);
-            //LOG_WARN(_T("Use default roman defs"));
-            //loadRomanDefLines(defaultRomanDef);
             // ファイルがなかったら定義テーブルをクリアする
-            //LOG_WARN(_T("Can't read roman def file: {}"), path);
-            //LOG_WARN(_T("Use default roman defs"));
-            //loadRomanDefLines(defaultRomanDef);
             LOG_WARN(_T("Can't read roman def file: {}"), path);
             LOG_WARN(_T("Clear roman defs"));
-            romanKatakanaTbl.clear();
         }
+        return [tbl]() { std::swap(romanKatakanaTbl, *tbl); };
+    }
+
+    // ローマ字定義ファイルを読み込む
+    void ReadRomanDefFile(StringRef defFile) {
+        PrepareRomanDefFile(SETTINGS->rootDir, defFile)();
     }
 
     // ローマ字をカタカタナに変換する
@@ -500,37 +573,39 @@ namespace RomanToKatakana {
             if (romanKatakanaTbl.empty()) {
                 result = str;
             } else {
-                // ws: strをwstringに変換して前後に $ を付ける
-                String ws = _T("$");
-                ws.append(utils::toUpperFromMS(str));
-                ws.append(_T("$"));
+                // w: strを大文字化して前後に $ を付けたもの
+                RomanWord w(str);
                 size_t pos = 1;     // 先頭の $ は読み飛ばす
-                LOG_DEBUGH(_T("CHECK START: ws={}, pos={}"), ws, pos);
-                while (pos < ws.size()) {
+                LOG_DEBUGH(_T("CHECK START: pos={}"), pos);
+                while (pos < w.size()) {
+                    // pos からトライを辿って、長さごとの到達ノードを得る
+                    size_t nodes[MAX_KEY_LEN + 1] = { 0 };
+                    size_t maxLen = 0;
+                    size_t node = 0;
+                    for (size_t n = 1; n <= MAX_KEY_LEN && pos + n <= w.size(); ++n) {
+                        node = romanKatakanaTbl.next(node, w[pos + n - 1]);
+                        if (node == 0) break;
+                        nodes[n] = node;
+                        maxLen = n;
+                    }
+                    // 長いキーから順に、前後の文字クラスが一致するものを探す
                     bool found = false;
-                    for (size_t n = 4; !found && n >= 1; --n) {
-                        LOG_DEBUGH(_T("CHECK: ws.size={}, pos={}, n={}"), ws.size(), pos, n);
-                        if (n <= ws.size() - pos) {
-                            String key = ws.substr(pos, n);
-                            LOG_DEBUGH(_T("CHECK: key={}"), key);
-                            auto iter = romanKatakanaTbl.find(key);
-                            if (iter != romanKatakanaTbl.end()) {
-                                for (const auto& info : iter->second) {
-                                    if (info.match(key, ws, pos)) {
-                                        result.append(to_mstr(info.katakanaStr));
-                                        pos += n;
-                                        found = true;
-                                        break;
-                                    }
-                                }
+                    for (size_t n = maxLen; !found && n >= 1; --n) {
+                        for (const auto& info : romanKatakanaTbl.infos(nodes[n])) {
+                            if (info.match(w, pos, n)) {
+                                LOG_DEBUGH(_T("MATCH: pos={}, len={}"), pos, n);
+                                result.append(info.katakanaStr);
+                                pos += n;
+                                found = true;
+                                break;
                             }
                         }
                     }
                     if (!found) {
                         // ローマ字に解釈できない文字があったら、先頭からその文字までを変換せずにそのまま使用する
                         // 例: "AA:Roma" → 「AA:ローマ」になる
-                        LOG_DEBUGH(_T("NOT MATCH: pos={}, char={}"), pos, ws[pos]);
-                        if (pos > 0 && pos < ws.size() - 1) {
+                        LOG_DEBUGH(_T("NOT MATCH: pos={}, char={}"), pos, w[pos]);
+                        if (pos > 0 && pos < w.size() - 1) {
                             result = str.substr(0, pos);
                         }
                         ++pos;
@@ -542,4 +617,3 @@ namespace RomanToKatakana {
         return result;
     }
 }
-
@@ -4,6 +4,10 @@ namespace RomanToKatakana {
     // ローマ字定義ファイルを読み込む
     void ReadRomanDefFile(StringRef defFilePath);
 
+    // ローマ字定義ファイルを現在の定義とは別に読み込み、それに差し替える関数を返す
+    // 読み込みはバックグラウンドで行ってよいが、差し替えはデコーダのロックを取得して行うこと
+    std::function<void()> PrepareRomanDefFile(StringRef rootDir, StringRef defFilePath);
+
     // ローマ字をカタカタナに変換する
     MString convertRomanToKatakana(const MString& s);
 }
@@ -5,7 +5,7 @@
 #include "StringNode.h"
 #include "FunctionNode.h"
 #include "MyPrevChar.h"
-#include "DecKeyToChars.h"
+#include "DeckeyToChars.h"
 #include "Settings/Settings.h"
 
 #include "VkbTableMaker.h"
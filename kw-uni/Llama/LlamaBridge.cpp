@@ -1,6 +1,11 @@
 #include "Logger.h"
 #include "LlamaBridge.h"
+
+#define USE_LLAMA 0
+
+#if USE_LLAMA
 #include "e:/Dev/Cpp/llama.cpp/examples/LlamaLoss/LlamaLoss.h"
+#endif
 
 #if 0
 #undef _LOG_INFOH
@@ -14,8 +19,6 @@
 #endif
 #endif
 
-#define USE_LLAMA 0
-
 namespace LlamaBridge {
     DEFINE_LOCAL_LOGGER(LlamaBridge);
 
@@ -15,6 +15,17 @@ namespace NgramBridge {
 
     bool initializeSucceeded = false;
 
+    // ngramCalcCost の作業領域 (呼び出しごとに確保しないよう、スレッドごとに使い回す)
+    thread_local String calcSentenceBuf;
+    thread_local String calcMainMorphsBuf;
+    thread_local String calcPenaltyMorphsBuf;
+    thread_local std::vector<String> calcResultsBuf;
+
+    // updateRealtimeEntries の作業領域
+    thread_local String updateSentenceBuf;
+    thread_local std::vector<size_t> updateWcharPosBuf;
+    thread_local std::vector<size_t> updateSpansBuf;
+
     int _ngramInitialize(StringRef dicdir, int unkMax) {
         LOG_INFOH(_T("ENTER: dicdir={}, unkMax={}"), dicdir, unkMax);
 
@@ -115,48 +126,57 @@ namespace NgramBridge {
         NgramCoreLib::NgramSaveLog(errMsgBuf, ARRAY_SIZE);
     }
 
+    // 形態素解析の結果の1行 (タブ区切り) から、表層形と3番目の項目(素性)を取り出す。項目が3つ未満なら false を返す
+    bool splitMorph(const MString& morph, MStringView& surf, MStringView& feat) {
+        size_t t1 = morph.find('\t');
+        if (t1 == MString::npos) return false;
+        size_t t2 = morph.find('\t', t1 + 1);
+        if (t2 == MString::npos) return false;
+        size_t t3 = morph.find('\t', t2 + 1);
+        MStringView view(morph);
+        surf = view.substr(0, t1);
+        feat = view.substr(t2 + 1, t3 == MString::npos ? MStringView::npos : t3 - t2 - 1);
+        return true;
+    }
+
     // Ngramの一時的な辞書エントリのために、形態素解析の結果から、未知語や交ぜ書き候補を除いた主要な形態素を抽出する
-    String pickMainMorphs(const std::vector<MString>& morphs) {
-        MString mainMorphs;
-        MString unkMarker = to_mstr(L":未知");
-        MString mazeMarker = to_mstr(L"MAZE");
+    void pickMainMorphs(const std::vector<MString>& morphs, String& mainMorphs) {
+        static const MString unkMarker = to_mstr(L":未知");
+        static const MString mazeMarker = to_mstr(L"MAZE");
+        mainMorphs.clear();
         bool first = true;
         for (const auto& morph : morphs) {
-            auto items = utils::split(morph, '\t');
-            if (items.size() > 2) {
-                const MString& surf = items[0];
+            MStringView surf, feat;
+            if (splitMorph(morph, surf, feat)) {
                 // かな配列だけの場合は、ひらがなのみの形態素や交ぜ書き候補も含める。
                 if (surf.size() >= 2) {
                     bool bHiraganaOK = surf.size() >= 4 || SETTINGS->isHiraganaTableOnly;
                     if (bHiraganaOK || utils::contains_kanji(surf)) {
-                        const MString& feat = items[2];
-                        if (feat.find(unkMarker) == std::string::npos && (bHiraganaOK || !utils::endsWith(feat, mazeMarker))) {
-                            if (!first) mainMorphs.append(MSTR_VERT_BAR);
+                        if (feat.find(unkMarker) == MStringView::npos && (bHiraganaOK || !feat.ends_with(mazeMarker))) {
+                            if (!first) mainMorphs.push_back(VERT_BAR);
                             first = false;
-                            mainMorphs.append(surf);
+                            utils::append_mstr_to_wstr(surf, mainMorphs);
                         }
                     }
                 }
             }
         }
-        _LOG_DEBUGH(_T("RESULT: mainMorphs={}"), to_wstr(mainMorphs));
-        return to_wstr(mainMorphs);
+        _LOG_DEBUGH(_T("RESULT: mainMorphs={}"), mainMorphs);
     }
 
 #define MIN_PENALTY_HIRAGANA_MORPH_NUM 5
 #define MAX_PENALTY_HIRAGANA_LEN 3
 
     // 形態素解析の結果から、ペナルティとなる形態素を抽出する。具体的には、単一ひらがなの4gram
-    String pickPenaltyMorphs(const std::vector<MString>& morphs) {
-        MString penaltyMorphs;
+    void pickPenaltyMorphs(const std::vector<MString>& morphs, String& penaltyMorphs) {
         MString hiraganaStr;
         size_t startPos = 0;
         size_t hiraganaCount = 0;
         bool first = true;
+        penaltyMorphs.clear();
         for (const auto& morph : morphs) {
-            auto items = utils::split(morph, '\t');
-            if (items.size() > 2) {
-                const MString& surf = items[0];
+            MStringView surf, feat;
+            if (splitMorph(morph, surf, feat)) {
                 // かな配列だけの場合は、ひらがなのみの形態素や交ぜ書き候補も含める。
                 if (!surf.empty() && surf.size() <= MAX_PENALTY_HIRAGANA_LEN &&
                     utils::is_hiragana(surf.front()) && (surf.size() == 1 || (utils::is_hiragana(surf[1]) && (surf.size() == 2 || utils::is_hiragana(surf[2]))))) {
@@ -165,9 +185,9 @@ namespace NgramBridge {
                     if (hiraganaStr.size() >= MIN_PENALTY_HIRAGANA_MORPH_NUM && hiraganaCount >= MIN_PENALTY_HIRAGANA_MORPH_NUM) {
                         // 1~L文字ひらがながN個以上続く場合は、ペナルティ対象とする
                         while (startPos + MIN_PENALTY_HIRAGANA_MORPH_NUM <= hiraganaStr.size()) {
-                            if (!first) penaltyMorphs.append(MSTR_VERT_BAR);
+                            if (!first) penaltyMorphs.push_back(VERT_BAR);
                             first = false;
-                            penaltyMorphs.append(hiraganaStr.substr(startPos, MIN_PENALTY_HIRAGANA_MORPH_NUM));
+                            utils::append_mstr_to_wstr(MStringView(hiraganaStr).substr(startPos, MIN_PENALTY_HIRAGANA_MORPH_NUM), penaltyMorphs);
                             ++startPos;
                         }
                     }
@@ -178,8 +198,7 @@ namespace NgramBridge {
                 }
             }
         }
-        _LOG_DEBUGH(_T("RESULT: penaltyMorphs={}"), to_wstr(penaltyMorphs));
-        return to_wstr(penaltyMorphs);
+        _LOG_DEBUGH(_T("RESULT: penaltyMorphs={}"), penaltyMorphs);
     }
 
     // リアルタイムNgram辞書のパラメータ設定
@@ -200,6 +219,13 @@ namespace NgramBridge {
         return NgramCoreLib::LoadUserNgram(ngramFilePath.c_str());
     }
 
+    // リアルタイムNgram辞書とユーザーNgram辞書を読み込み、差し替える関数を返す
+    // 差し替えた後は、古い辞書は返した関数とともに破棄される
+    std::function<void()> prepareNgramDicts(StringRef realtimeNgramPath, StringRef userNgramPath) {
+        auto generation = NgramCoreLib::PrepareNgramDicts(realtimeNgramPath, userNgramPath);
+        return [generation]() { NgramCoreLib::InstallNgramDicts(*generation); };
+    }
+
     // リアルタイムNgramファイルの保存
     // @param ngramFilePath リアルタイムNgramファイルのパス
     // @param rotationNum 過去履歴の保存数 (0 なら保存しない)
@@ -214,14 +240,46 @@ namespace NgramBridge {
         return NgramCoreLib::UpdateRealtimeEntry(word, delta);
     }
 
+    // リアルタイムNgramエントリの一括更新
+    // str を1度だけ wchar_t 列に変換し、spans の位置をその中の位置に読み替えて渡す
+    int updateRealtimeEntries(const MString& str, const std::vector<size_t>& spans, int delta) {
+        if (spans.empty()) return 0;
+        String& sentence = updateSentenceBuf;
+        sentence.clear();
+        utils::append_mstr_to_wstr(str, sentence);
+        // mchar_t の位置 → wchar_t の位置 (サロゲートペアは2、0 は出力されないので0)
+        std::vector<size_t>& wpos = updateWcharPosBuf;
+        wpos.resize(str.size() + 1);
+        wpos[0] = 0;
+        for (size_t i = 0; i < str.size(); ++i) {
+            wpos[i + 1] = wpos[i] + (str[i] == 0 ? 0 : str[i] > 0xffff ? 2 : 1);
+        }
+        std::vector<size_t>& wspans = updateSpansBuf;
+        wspans.clear();
+        for (size_t i = 0; i + 1 < spans.size(); i += 2) {
+            size_t pos = spans[i];
+            size_t len = spans[i + 1];
+            if (pos + len > str.size()) continue;
+            wspans.push_back(wpos[pos]);
+            wspans.push_back(wpos[pos + len] - wpos[pos]);
+        }
+        return NgramCoreLib::UpdateRealtimeEntries(sentence, wspans, delta);
+    }
+
     int ngramCalcCost(const MString& str, const std::vector<MString>& tempDictEntries, std::vector<MString>& ngrams, bool needNgrams) {
         if (!initializeSucceeded) return 0;
 
         //_LOG_TEMPW(L"ENTER");
         _LOG_DEBUGH(_T("ENTER: str={}, tempDic=<{}>"), to_wstr(str), to_wstr(utils::join(tempDictEntries, '|')));
-        std::vector<String> results;
+        String& sentence = calcSentenceBuf;
+        sentence.clear();
+        utils::append_mstr_to_wstr(str, sentence);
+        pickMainMorphs(tempDictEntries, calcMainMorphsBuf);
+        pickPenaltyMorphs(tempDictEntries, calcPenaltyMorphsBuf);
+        std::vector<String>& results = calcResultsBuf;
+        results.clear();
         String  errMsg;
-        int cost = NgramCoreLib::NgramAnalyze(to_wstr(str), pickMainMorphs(tempDictEntries), pickPenaltyMorphs(tempDictEntries), results, errMsg, needNgrams);
+        int cost = NgramCoreLib::NgramAnalyze(sentence, calcMainMorphsBuf, calcPenaltyMorphsBuf, results, errMsg, needNgrams);
         if (cost < 0) {
             LOG_WARN(_T("NgramAnalyze FAILED: result={}, errMsg={}"), cost, errMsg);
             return cost;
@@ -229,10 +287,11 @@ namespace NgramBridge {
         //int cost = NgramAnalyze(to_wstr(str).c_str(), wchbuf, BUFSIZE, mazePenalty, allowNonTerminal, false);
         if (needNgrams) {
             for (const auto& s : results) {
-                ngrams.push_back(to_mstr(s));
+                ngrams.emplace_back();
+                utils::append_wstr_to_mstr(s, ngrams.back());
             }
         }
-        _LOG_DEBUGH(_T("LEAVE: str={}, ngramCost={}, ngrams={}"), to_wstr(str), cost, to_wstr(utils::join(ngrams, ' ')));
+        _LOG_DEBUGH(_T("LEAVE: str={}, ngramCost={}, ngrams={}"), sentence, cost, to_wstr(utils::join(ngrams, ' ')));
         //_LOG_TEMPW(L"LEAVE");
         return cost;
     }
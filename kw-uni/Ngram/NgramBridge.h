@@ -28,11 +28,20 @@ namespace NgramBridge {
     // ユーザーNgram辞書のロード
     int loadUserNgram(StringRef ngramFilePath);
 
+    // リアルタイムNgram辞書とユーザーNgram辞書を現在の辞書とは別に読み込み、それらに差し替える関数を返す
+    // 読み込みはバックグラウンドで行ってよいが、差し替えはデコーダのロックを取得して行うこと
+    std::function<void()> prepareNgramDicts(StringRef realtimeNgramPath, StringRef userNgramPath);
+
     // リアルタイムNgramファイルの保存
     void saveRealtimeDict(StringRef ngramFilePath, int rotationNum);
 
     // リアルタイムNgramエントリの更新
     int updateRealtimeEntry(const String& word, int delta);
 
+    // リアルタイムNgramエントリの一括更新
+    // @param spans 更新する部分文字列の、str 中の (位置, 長さ) を順に詰めて並べたもの (mchar_t 単位)
+    // @return 更新したエントリの数
+    int updateRealtimeEntries(const MString& str, const std::vector<size_t>& spans, int delta);
+
     int ngramCalcCost(const MString& str, const std::vector<MString>& tempDictEntries, std::vector<MString>& ngrams, bool needNgrams);
 }
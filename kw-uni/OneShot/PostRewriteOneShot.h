@@ -1,6 +1,8 @@
 #pragma once
 
 #include "utils/misc_utils.h"
+#include "reversed_key_trie.h"
+#include "piece_alternatives.h"
 #include "Logger.h"
 
 #include "FunctionNode.h"
@@ -13,19 +15,36 @@ public:
     MString rewriteStr;
     size_t rewritableLen;
     StrokeTableNode* subTable = 0;
+    // rewriteStr を '|' で分割した候補 (rewriteStr を変更したら updateAlternatives() を呼ぶこと)
+    utils::PieceAlternatives alternatives;
 
     RewriteInfo() : rewriteStr(), rewritableLen(0) { }
 
     RewriteInfo(const RewriteInfo& info)
-        : rewriteStr(info.rewriteStr), rewritableLen(info.rewritableLen), subTable(info.subTable)
+        : rewriteStr(info.rewriteStr), rewritableLen(info.rewritableLen), subTable(info.subTable), alternatives(info.alternatives)
     {
     }
 
     RewriteInfo(const MString& ms, size_t rewLen, StrokeTableNode* pn)
-        : rewriteStr(ms), rewritableLen(rewLen), subTable(pn)
+        : rewriteStr(ms), rewritableLen(rewLen), subTable(pn), alternatives(ms)
     {
     }
 
+    RewriteInfo& operator=(const RewriteInfo& info) = default;
+
+    void updateAlternatives() {
+        alternatives.assign(rewriteStr);
+    }
+
+    size_t numAlternatives() const {
+        return alternatives.size();
+    }
+
+    // i 番目の候補
+    MStringView alternative(size_t i) const {
+        return alternatives.at(rewriteStr, i);
+    }
+
     size_t getOutStrLen() const {
         return rewritableLen >= rewriteStr.size() ? 0 : rewriteStr.size() - rewritableLen;
     }
@@ -42,6 +61,24 @@ public:
     }
 };
 
+// -------------------------------------------------------------------
+// 書き換え対象文字列を逆順に並べたトライ
+// 出力末尾から1文字ずつ遡るだけで、マッチする最長のキーが求まる
+class RewriteSuffixTrie {
+    utils::ReversedKeyTrie<RewriteInfo> trie;
+
+public:
+    // rewriteMap の要素を指すので、rewriteMap を変更したら作り直すこと
+    void build(const std::map<MString, RewriteInfo>& rewriteMap) { trie.build(rewriteMap); }
+
+    // str[0, len) の末尾にマッチする最長のキーの書き換え情報とキー長を返す
+    // bRollOver なら "+" を付加したキーを、同じ長さの "+" なしのキーよりも優先する
+    std::tuple<const RewriteInfo*, size_t> matchTail(const mchar_t* str, size_t len, bool bRollOver) const;
+
+    // str[0, len) にちょうど一致するキーの書き換え情報を返す
+    const RewriteInfo* findExact(const mchar_t* str, size_t len, bool bRollOver) const;
+};
+
 // PostRewriteOneShotNode
 class PostRewriteOneShotNode : public FunctionNode {
     DECLARE_CLASS_LOGGER;
@@ -49,6 +86,18 @@ class PostRewriteOneShotNode : public FunctionNode {
     // 書き換え情報マップ -- 前接する書き換え対象文字列がキーとなる
     std::map<MString, RewriteInfo> rewriteMap;
 
+    // rewriteMap から作った検索用トライ (rewriteMap が変更されたら、次の検索時に作り直す)
+    mutable RewriteSuffixTrie suffixTrie;
+    mutable bool bTrieDirty = true;
+
+    const RewriteSuffixTrie& getSuffixTrie() const {
+        if (bTrieDirty) {
+            suffixTrie.build(rewriteMap);
+            bTrieDirty = false;
+        }
+        return suffixTrie;
+    }
+
     RewriteInfo myRewriteInfo;
 
     // 生存管理のためのvector
@@ -76,13 +125,24 @@ public:
 
     const RewriteInfo& getRewriteInfo() const { return myRewriteInfo; }
 
-    void clearRewriteString() { myRewriteInfo.rewriteStr.clear(); }
+    void clearRewriteString() { myRewriteInfo.rewriteStr.clear(); myRewriteInfo.updateAlternatives(); }
 
     void addRewritePair(StringRef key, StringRef value, bool bBare, StrokeTableNode* pNode);
 
+    // 解析済みの書き換え情報を直接設定する (コンパイル済みストロークテーブルからの復元用)
+    void setRewriteInfo(const RewriteInfo& info) { myRewriteInfo = info; }
+
+    void addRewriteInfo(const MString& key, const RewriteInfo& info) {
+        if (info.subTable) subTables.push_back(info.subTable);
+        rewriteMap[key] = info;
+        bTrieDirty = true;
+    }
+
     void merge(PostRewriteOneShotNode& rewNode) {
         rewriteMap.insert(rewNode.rewriteMap.begin(), rewNode.rewriteMap.end());
         rewNode.rewriteMap.clear();
+        bTrieDirty = true;
+        rewNode.bTrieDirty = true;
         utils::append(subTables, rewNode.subTables);
         rewNode.subTables.clear();
     }
@@ -95,6 +155,11 @@ public:
     // 末尾文字列にマッチする RewriteInfo を取得する
     std::tuple<const RewriteInfo*, size_t> matchWithTailString() const;
 
+    // str[0, len) の末尾にマッチする最長の RewriteInfo とそのキー長を取得する
+    std::tuple<const RewriteInfo*, size_t> matchTail(const mchar_t* str, size_t len, bool bRollOver) const {
+        return getSuffixTrie().matchTail(str, len, bRollOver);
+    }
+
     const std::map<MString, RewriteInfo>& getRewriteMap() const { return rewriteMap; }
 
     size_t getSubTableNum() const { return subTables.size(); }
@@ -134,6 +134,37 @@ namespace {
 
 } // namespace
 
+// -------------------------------------------------------------------
+// RewriteSuffixTrie - 書き換え対象文字列の逆順トライ
+std::tuple<const RewriteInfo*, size_t> RewriteSuffixTrie::matchTail(const mchar_t* str, size_t len, bool bRollOver) const {
+    const RewriteInfo* info = nullptr;
+    size_t matchLen = 0;
+    if (trie.empty()) return { info, matchLen };
+
+    trie.walkBack(trie.ROOT, str, len, info, matchLen);
+    if (bRollOver) {
+        uint32_t plusNode = trie.next(trie.ROOT, '+');
+        if (plusNode != trie.ROOT) {
+            const RewriteInfo* plusInfo = nullptr;
+            size_t plusLen = 0;
+            trie.walkBack(plusNode, str, len, plusInfo, plusLen);
+            if (plusInfo && plusLen >= matchLen) return { plusInfo, plusLen };
+        }
+    }
+    return { info, matchLen };
+}
+
+const RewriteInfo* RewriteSuffixTrie::findExact(const mchar_t* str, size_t len, bool bRollOver) const {
+    if (trie.empty() || len == 0) return nullptr;
+    const RewriteInfo* info = nullptr;
+    if (bRollOver) {
+        uint32_t plusNode = trie.next(trie.ROOT, '+');
+        if (plusNode != trie.ROOT) info = trie.walkAll(plusNode, str, len);
+    }
+    if (!info) info = trie.walkAll(trie.ROOT, str, len);
+    return info;
+}
+
 // -------------------------------------------------------------------
 // PostRewriteOneShotNode - 書き換えノード
 DEFINE_CLASS_LOGGER(PostRewriteOneShotNode);
@@ -152,6 +183,7 @@ PostRewriteOneShotNode::PostRewriteOneShotNode(StringRef s, bool bBare)
     }
     myRewriteInfo.rewriteStr = to_mstr(rewStr);
     myRewriteInfo.rewritableLen = rewLen;
+    myRewriteInfo.updateAlternatives();
     LOG_DEBUGH(_T("LEAVE: myStr={}, myRewriteLen={}"), rewStr, rewLen);
 }
 
@@ -182,6 +214,7 @@ void PostRewriteOneShotNode::addRewritePair(StringRef key, StringRef value, bool
     }
 
     rewriteMap[to_mstr(key)] = RewriteInfo(to_mstr(rewStr), rewLen, pNode);
+    bTrieDirty = true;
 
     LOG_DEBUGH(_T("LEAVE: rewStr={}, rewLen={}"), rewStr, rewLen);
 }
@@ -189,16 +222,30 @@ void PostRewriteOneShotNode::addRewritePair(StringRef key, StringRef value, bool
 // 末尾文字列にマッチする RewriteInfo を取得する
 std::tuple<const RewriteInfo*, size_t> PostRewriteOneShotNode::matchWithTailString() const {
     size_t maxlen = SETTINGS->kanaTrainingMode && ROOT_STROKE_NODE->hasOnlyUsualRewriteNdoe() ? 0 : 8;     // かな入力練習モードで濁点のみなら書き換えをやらない
-    bool bRollOverStroke = STATE_COMMON->IsRollOverStroke();
+    if (maxlen == 0) return { 0, 0 };
+
+    bool bRollOverStroke = STATE_COMMON->IsRollOverStroke();        // ロールオーバー打ちのときは"+"を付加したエントリを優先する
+    const RewriteSuffixTrie& trie = getSuffixTrie();
+
+    if (!SETTINGS->googleCompatible) {
+        // 短い maxlen で取得した文字列は長い maxlen の文字列の末尾部分になるので、一度取得するだけでよい
+        const MString targetStr = OUTPUT_STACK->backStringUptoRewritableBlock(maxlen);
+        _LOG_DEBUGH(_T("targetStr={}"), to_wstr(targetStr));
+        auto result = trie.matchTail(targetStr.data(), targetStr.size(), bRollOverStroke);
+        if (std::get<0>(result)) {
+            _LOG_DEBUGH(_T("REWRITE_INFO found: outStr={}, rewritableLen={}, subTable={:p}"), to_wstr(std::get<0>(result)->rewriteStr), std::get<0>(result)->rewritableLen, (void*)std::get<0>(result)->subTable);
+        }
+        return result;
+    }
+
+    // google互換モードでは、maxlen によって書き換え可能ブロックの開始位置が変わりうるので、長さごとに取得し直す
     while (maxlen > 0) {
         _LOG_DEBUGH(_T("maxlen={}"), maxlen);
-        const MString targetStr = SETTINGS->googleCompatible ? OUTPUT_STACK->backStringWhileOnlyRewritable(maxlen) : OUTPUT_STACK->backStringUptoRewritableBlock(maxlen);
+        const MString targetStr = OUTPUT_STACK->backStringWhileOnlyRewritable(maxlen);
         _LOG_DEBUGH(_T("targetStr={}"), to_wstr(targetStr));
         if (targetStr.empty()) break;
 
-        const RewriteInfo* rewInfo = 0;
-        if (bRollOverStroke) rewInfo = getRewriteInfo(targetStr + MSTR_PLUS);        // ロールオーバー打ちのときは"+"を付加したエントリを検索
-        if (!rewInfo) rewInfo = getRewriteInfo(targetStr);
+        const RewriteInfo* rewInfo = trie.findExact(targetStr.data(), targetStr.size(), bRollOverStroke);
         if (rewInfo) {
             _LOG_DEBUGH(_T("REWRITE_INFO found: outStr={}, rewritableLen={}, subTable={:p}"), to_wstr(rewInfo->rewriteStr), rewInfo->rewritableLen, (void*)rewInfo->subTable);
             return { rewInfo, targetStr.size() };
@@ -1,3 +1,7 @@
+#include <atomic>
+#include <condition_variable>
+#include <thread>
+
 #include "string_utils.h"
 #include "path_utils.h"
 
@@ -108,9 +112,7 @@ namespace Reporting {
 		return true;
 	}
 
-	std::string getDatetimeStr() {
-		SYSTEMTIME st;
-		GetLocalTime(&st);
+	std::string getDatetimeStr(const SYSTEMTIME& st) {
 		return std::format("{:04d}/{:02d}/{:02d} {:02d}:{:02d}:{:02d}.{:03d}",
 			st.wYear,
 			st.wMonth,
@@ -121,11 +123,21 @@ namespace Reporting {
 			st.wMilliseconds);
 	}
 
-	std::string formatMessage(const std::string& level, const std::string& className, const std::string& method, int line, StringRef msg) {
-		return std::format("{} {} [{}.{}({})] {}\n", getDatetimeStr(), level, className, method, line, utils::utf8_encode(msg));
+	std::string getDatetimeStr() {
+		SYSTEMTIME st;
+		GetLocalTime(&st);
+		return getDatetimeStr(st);
+	}
+
+	std::string formatMessage(const std::string& datetime, const char* level, const std::string& className, const char* method, int line, StringRef msg) {
+		return std::format("{} {} [{}.{}({})] {}\n", datetime, level, className, method, line, utils::utf8_encode(msg));
+	}
+
+	std::string formatMessage(const char* level, const std::string& className, const char* method, int line, StringRef msg) {
+		return formatMessage(getDatetimeStr(), level, className, method, line, msg);
 	}
 
-	void _write_log(FileWriter& fw, const std::string& level, const std::string& className, const std::string& method, int line, StringRef msg) {
+	void _write_log(FileWriter& fw, const char* level, const std::string& className, const char* method, int line, StringRef msg) {
 		fw.WriteLog(formatMessage(level, className, method, line, msg));
 	}
 
@@ -137,8 +149,198 @@ namespace Reporting {
 		queue.push_back(msg);
 	}
 
-	void _write_log(Deque<std::string>& queue, const std::string& level, const std::string& className, const std::string& method, int line, StringRef msg) {
-		appendLog(queue, formatMessage(level, className, method, line, msg));
+	//-----------------------------------------------------------------------------
+	// トレースキューへの非同期書き込み
+	// - ログ出力側は、レコード(レベル、出力箇所、書式化済みメッセージ、時刻)をリングバッファに置くだけ
+	// - 日時の整形、UTF-8 への変換、トレースキューへの追加はバックグラウンドのスレッドで行う
+	// - リングバッファがあふれたら、そのレコードは捨てて件数だけを数えておく
+	// - 書き込みスレッドは、リングバッファが空になったら次のレコードが置かれるまで待機する
+	class TraceLogWriter {
+	public:
+		struct Record {
+			const char* level = 0;
+			const std::string* className = 0;
+			const char* method = 0;
+			int line = 0;
+			FILETIME time = { 0, 0 };
+			String msg;
+		};
+
+	private:
+		static const size_t RING_SIZE = 8192;		// 2のべき乗であること
+
+		// seq == pos なら空き、seq == pos + 1 なら書き込み済み (pos はそのスロットを使う通し番号)
+		struct Slot {
+			std::atomic<size_t> seq;
+			Record rec;
+		};
+
+		std::unique_ptr<Slot[]> _slots;
+
+		alignas(64) std::atomic<size_t> _enqueuePos;
+
+		// 以下は _consumerMutex で保護する
+		alignas(64) size_t _dequeuePos = 0;
+		std::mutex _consumerMutex;
+
+		std::atomic<size_t> _dropCount;
+
+		// 書き込みスレッドが前回リングバッファを空にした後にレコードが置かれたか
+		// (false から true にしたログ出力側だけが _wakeCond で書き込みスレッドを起こす)
+		std::atomic<bool> _pending;
+		std::mutex _wakeMutex;
+		std::condition_variable _wakeCond;
+
+		enum State { NotStarted, Running, Stopped };
+		std::atomic<int> _state;
+		std::mutex _stateMutex;
+		std::thread _thread;
+
+		bool tryPush(Record& rec) {
+			size_t pos = _enqueuePos.load(std::memory_order_relaxed);
+			while (true) {
+				Slot& slot = _slots[pos & (RING_SIZE - 1)];
+				size_t seq = slot.seq.load(std::memory_order_acquire);
+				if (seq == pos) {
+					if (_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+						slot.rec = std::move(rec);
+						slot.seq.store(pos + 1, std::memory_order_release);
+						return true;
+					}
+				} else if ((ptrdiff_t)(seq - pos) < 0) {
+					// 満杯
+					return false;
+				} else {
+					pos = _enqueuePos.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		bool tryPop(Record& rec) {
+			Slot& slot = _slots[_dequeuePos & (RING_SIZE - 1)];
+			if (slot.seq.load(std::memory_order_acquire) != _dequeuePos + 1) return false;
+			std::swap(rec.msg, slot.rec.msg);		// 文字列のバッファは使い回す
+			rec.level = slot.rec.level;
+			rec.className = slot.rec.className;
+			rec.method = slot.rec.method;
+			rec.line = slot.rec.line;
+			rec.time = slot.rec.time;
+			slot.seq.store(_dequeuePos + RING_SIZE, std::memory_order_release);
+			++_dequeuePos;
+			return true;
+		}
+
+		// レコードを整形してトレースキューに追加する (先頭の改行はそのまま出力する)
+		void appendRecord(const Record& rec) {
+			const String& msg = rec.msg;
+			size_t n = 0;
+			while (n < msg.size() && msg[n] == '\n') ++n;
+			if (n > 0) appendLog(Logger::_traceLogQueue, std::string(n, '\n'));
+			if (n < msg.size() || n == 0) {
+				FILETIME localTime;
+				SYSTEMTIME st;
+				FileTimeToLocalFileTime(&rec.time, &localTime);
+				FileTimeToSystemTime(&localTime, &st);
+				appendLog(Logger::_traceLogQueue, formatMessage(getDatetimeStr(st), rec.level, *rec.className, rec.method, rec.line, n == 0 ? msg : msg.substr(n)));
+			}
+		}
+
+		// リングバッファの中身をすべてトレースキューに移す (_consumerMutex を取得してから呼ぶこと)
+		size_t drainLocked() {
+			size_t count = 0;
+			Record rec;
+			while (tryPop(rec)) {
+				appendRecord(rec);
+				++count;
+			}
+			size_t dropped = _dropCount.exchange(0);
+			if (dropped > 0) {
+				appendLog(Logger::_traceLogQueue, std::format("{} WARN  [TraceLogWriter] {} records dropped (ring buffer overflow)\n", getDatetimeStr(), dropped));
+			}
+			return count;
+		}
+
+		// 書き込みスレッドを起こす
+		void wakeWriter() {
+			std::lock_guard<std::mutex> lock(_wakeMutex);
+			_wakeCond.notify_one();
+		}
+
+		void run() {
+			while (_state.load(std::memory_order_acquire) == Running) {
+				{
+					std::lock_guard<std::mutex> lock(_consumerMutex);
+					drainLocked();
+				}
+				// 次のレコードが置かれるか、停止を指示されるまで待つ
+				std::unique_lock<std::mutex> lock(_wakeMutex);
+				_wakeCond.wait(lock, [this]() {
+					return _pending.exchange(false, std::memory_order_acq_rel) || _state.load(std::memory_order_acquire) != Running;
+				});
+			}
+		}
+
+		void startIfNeeded() {
+			if (_state.load(std::memory_order_acquire) != NotStarted) return;
+			std::lock_guard<std::mutex> lock(_stateMutex);
+			if (_state.load(std::memory_order_relaxed) == NotStarted) {
+				_state.store(Running, std::memory_order_release);
+				_thread = std::thread([this]() { run(); });
+			}
+		}
+
+	public:
+		TraceLogWriter()
+			: _slots(new Slot[RING_SIZE]), _enqueuePos(0), _dropCount(0), _pending(false), _state(NotStarted)
+		{
+			for (size_t i = 0; i < RING_SIZE; ++i) _slots[i].seq.store(i, std::memory_order_relaxed);
+		}
+
+		void Push(const char* level, const std::string& className, const char* method, int line, String&& msg) {
+			Record rec;
+			rec.level = level;
+			rec.className = &className;
+			rec.method = method;
+			rec.line = line;
+			GetSystemTimeAsFileTime(&rec.time);
+			rec.msg = std::move(msg);
+
+			startIfNeeded();
+			if (_state.load(std::memory_order_acquire) == Running) {
+				if (!tryPush(rec)) _dropCount.fetch_add(1, std::memory_order_relaxed);
+				// 書き込みスレッドが待機中かもしれないときだけ起こす
+				if (!_pending.load(std::memory_order_relaxed) && !_pending.exchange(true, std::memory_order_acq_rel)) wakeWriter();
+			} else {
+				// 停止後は呼び出し側で直接書き込む
+				std::lock_guard<std::mutex> lock(_consumerMutex);
+				drainLocked();
+				appendRecord(rec);
+			}
+		}
+
+		// リングバッファを空にしたうえで、トレースキューのロックを返す
+		std::unique_lock<std::mutex> LockDrained() {
+			std::unique_lock<std::mutex> lock(_consumerMutex);
+			drainLocked();
+			return lock;
+		}
+
+		// 書き込みスレッドを停止する
+		void Stop() {
+			std::lock_guard<std::mutex> lock(_stateMutex);
+			if (_state.exchange(Stopped) == Running && _thread.joinable()) {
+				wakeWriter();
+				_thread.join();
+			}
+			std::lock_guard<std::mutex> consumerLock(_consumerMutex);
+			drainLocked();
+		}
+	};
+
+	// DLL のアンロード時に書き込みスレッドの join を待つことのないよう、インスタンスは破棄しない
+	TraceLogWriter& traceLogWriter() {
+		static TraceLogWriter* writer = new TraceLogWriter();
+		return *writer;
 	}
 
 	//-----------------------------------------------------------------------------
@@ -159,6 +361,7 @@ namespace Reporting {
 	}
 
 	void Logger::SaveLog() {
+		auto lock = traceLogWriter().LockDrained();
 		if (initializeFileWriter()) {
 			while (!_traceLogQueue.empty()) {
 				fileWriterPtr->WriteLog(_traceLogQueue.front());
@@ -169,6 +372,10 @@ namespace Reporting {
 		}
 	}
 
+	void Logger::Shutdown() {
+		traceLogWriter().Stop();
+	}
+
 	void Logger::Close() {
 		//_logFilename.clear();
 		fileWriterPtr.reset();
@@ -178,6 +385,7 @@ namespace Reporting {
 		//if (initializeFileWriter()) {
 		//	fileWriterPtr->WriteLog(msg);
 		//}
+		auto lock = traceLogWriter().LockDrained();
 		appendLog(_traceLogQueue, msg);
 	}
 
@@ -185,7 +393,7 @@ namespace Reporting {
 		WriteLog(utils::utf8_encode(msg));
 	}
 
-	void Logger::writeLogToFile(const std::string& level, const std::string& method, const std::string& /*file*/, int line, StringRef msg)
+	void Logger::writeLogToFile(const char* level, const char* method, const char* /*file*/, int line, StringRef msg)
 	{
 		if (initializeFileWriter()) {
 			if (msg.size() > 0 && msg[0] == '\n') {
@@ -204,19 +412,8 @@ namespace Reporting {
 		}
 	}
 
-	void Logger::writeLogToQueue(const std::string& level, const std::string& method, const std::string& /*file*/, int line, StringRef msg)
+	void Logger::writeLogToQueue(const char* level, const char* method, const char* /*file*/, int line, String&& msg)
 	{
-        if (msg.size() > 0 && msg[0] == '\n') {
-            std::string newlines;
-            size_t n = 0;
-            while (msg.size() > 0 && n < msg.size() && msg[n] == '\n') {
-                newlines.push_back('\n');
-                ++n;
-            }
-            appendLog(_traceLogQueue, newlines);
-            if (n < msg.size()) _write_log(_traceLogQueue, level, _className, method, line, msg.substr(n));
-        } else {
-            _write_log(_traceLogQueue, level, _className, method, line, msg);
-        }
+		traceLogWriter().Push(level, _className, method, line, std::move(msg));
 	}
 }
@@ -22,15 +22,28 @@
 //   - LOG_INFO(...)
 //   - LOG_DEBUG(...)
 //   - LOG_TRACE(...)
+// - ERROR と WARNH 以外のログはトレースキューに溜められ、saveTraceLog でファイルに書き出される
+//   ログ出力側では書式化したメッセージをリングバッファに置くだけで、日時やクラス名の付加と
+//   トレースキューへの追加はバックグラウンドのスレッドで行う
+// - コンパイル時に LOG_COMPILE_LEVEL を定義すると、それより詳細なレベルのログ出力はコードごと取り除かれる
+//   例: /D LOG_COMPILE_LEVEL=4 (LogLevelInfoH) なら、実行時のレベルにかかわらず LOG_INFO 以下は何もしない
 // -------------------------------------------------------------------
 
 #include "std_utils.h"
 #include "string_utils.h"
 
+// コンパイル時に残すログレベルの上限 (既定ではすべて残す)
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL 8
+#endif
+
 namespace Reporting {
     class FileWriter;
+    class TraceLogWriter;
 
     class Logger {
+        friend class TraceLogWriter;
+
         static int _saveLevel;
 
     public:
@@ -117,6 +130,9 @@ namespace Reporting {
 
         static void SaveLog();
 
+        // トレースキューに書き込むスレッドを停止する (以降はログ出力側で直接書き込む)
+        static void Shutdown();
+
     private:
         std::string _className;
         String _classNameT;
@@ -124,8 +140,8 @@ namespace Reporting {
         static std::unique_ptr<FileWriter> fileWriterPtr;
         static bool initializeFileWriter();
 
-        void writeLogToFile(const std::string& level, const std::string& method, const std::string& /*file*/, int line, StringRef msg);
-        void writeLogToQueue(const std::string& level, const std::string& method, const std::string& /*file*/, int line, StringRef msg);
+        void writeLogToFile(const char* level, const char* method, const char* /*file*/, int line, StringRef msg);
+        void writeLogToQueue(const char* level, const char* method, const char* /*file*/, int line, String&& msg);
 
     public:
         inline Logger(const std::string& className, StringRef classNameT)
@@ -141,42 +157,42 @@ namespace Reporting {
         inline const std::string& ClassName() const { return _className; }
         inline const String& ClassNameT() const { return _classNameT; }
 
-        inline void Trace(const String& msg, const std::string& method, const std::string& file, int line) {
-            writeLogToQueue("TRACE", method, file, line, msg);
+        inline void Trace(String msg, const char* method, const char* file, int line) {
+            writeLogToQueue("TRACE", method, file, line, std::move(msg));
         }
 
-        inline void Debug(const String& msg, const std::string& method, const std::string& file, int line) {
-            writeLogToQueue("DEBUG", method, file, line, msg);
+        inline void Debug(String msg, const char* method, const char* file, int line) {
+            writeLogToQueue("DEBUG", method, file, line, std::move(msg));
         }
 
-        inline void DebugH(const String& msg, const std::string& method, const std::string& file, int line) {
-            writeLogToQueue("DEBUH", method, file, line, msg);
+        inline void DebugH(String msg, const char* method, const char* file, int line) {
+            writeLogToQueue("DEBUH", method, file, line, std::move(msg));
         }
 
-        inline void Info(const String& msg, const std::string& method, const std::string& file, int line) {
-            writeLogToQueue("INFO ", method, file, line, msg);
+        inline void Info(String msg, const char* method, const char* file, int line) {
+            writeLogToQueue("INFO ", method, file, line, std::move(msg));
         }
 
-        inline void InfoFile(const String& msg, const std::string& method, const std::string& file, int line) {
+        inline void InfoFile(String msg, const char* method, const char* file, int line) {
             writeLogToFile("INFO ", method, file, line, msg);
         }
 
-        inline void InfoH(const String& msg, const std::string& method, const std::string& file, int line) {
-            writeLogToQueue("INFOH", method, file, line, msg);
+        inline void InfoH(String msg, const char* method, const char* file, int line) {
+            writeLogToQueue("INFOH", method, file, line, std::move(msg));
         }
 
-        inline void Warn(const String& msg, const std::string& method, const std::string& file, int line) {
-            writeLogToQueue("WARN ", method, file, line, msg);
+        inline void Warn(String msg, const char* method, const char* file, int line) {
+            writeLogToQueue("WARN ", method, file, line, std::move(msg));
         }
 
-        inline void WarnH(const String& msg, const std::string& method, const std::string& file, int line) {
+        inline void WarnH(String msg, const char* method, const char* file, int line) {
             writeLogToFile("WARNH", method, file, line, msg);
-            writeLogToQueue("WARNH", method, file, line, msg);
+            writeLogToQueue("WARNH", method, file, line, std::move(msg));
         }
 
-        inline void Error(const String& msg, const std::string& method, const std::string& file, int line) {
+        inline void Error(String msg, const char* method, const char* file, int line) {
             writeLogToFile("ERROR", method, file, line, msg);
-            writeLogToQueue("ERROR", method, file, line, msg);
+            writeLogToQueue("ERROR", method, file, line, std::move(msg));
         }
 
     };
@@ -194,18 +210,21 @@ namespace Reporting {
 #define DEFINE_LOCAL_LOGGER(name)       DEFINE_LOGGER_STR("LOCAL." #name)
 #define DEFINE_NAMESPACE_LOGGER(name)   DEFINE_LOGGER_STR("NAMESPACE." #name)
 
-#define IS_LOG_WARN_ENABLED     (Reporting::Logger::IsWarnEnabled()) 
-#define IS_LOG_INFOH_ENABLED    (Reporting::Logger::IsInfoHEnabled()) 
-#define IS_LOG_INFO_ENABLED     (Reporting::Logger::IsInfoEnabled()) 
-#define IS_LOG_DEBUGH_ENABLED   (Reporting::Logger::IsDebugHEnabled()) 
-#define IS_LOG_DEBUG_ENABLED    (Reporting::Logger::IsDebugEnabled())
+// level のログ出力がコンパイル時に残されているか
+#define LOG_LEVEL_COMPILED(level)         (Reporting::Logger::LogLevel ## level <= LOG_COMPILE_LEVEL)
+
+#define IS_LOG_WARN_ENABLED     (LOG_LEVEL_COMPILED(Warn) && Reporting::Logger::IsWarnEnabled()) 
+#define IS_LOG_INFOH_ENABLED    (LOG_LEVEL_COMPILED(InfoH) && Reporting::Logger::IsInfoHEnabled()) 
+#define IS_LOG_INFO_ENABLED     (LOG_LEVEL_COMPILED(Info) && Reporting::Logger::IsInfoEnabled()) 
+#define IS_LOG_DEBUGH_ENABLED   (LOG_LEVEL_COMPILED(DebugH) && Reporting::Logger::IsDebugHEnabled()) 
+#define IS_LOG_DEBUG_ENABLED    (LOG_LEVEL_COMPILED(Debug) && Reporting::Logger::IsDebugEnabled())
 
 #define _SAFE_CHAR(ch) (ch > 0 ? ch : ' ')
 
 #define LOG_REPORT(level, fmt, ...)       logger.level(__VA_OPT__(std::format)(fmt __VA_OPT__(,) __VA_ARGS__), __func__, __FILE__, __LINE__)
 
 #define LOG_LEVEL_ENABLED(level)          Is ## level ## Enabled
-#define LOG_REPORT_COND(level, fmt, ...)  if (Reporting::Logger::LOG_LEVEL_ENABLED(level)()) LOG_REPORT(level, fmt, __VA_ARGS__)
+#define LOG_REPORT_COND(level, fmt, ...)  if (LOG_LEVEL_COMPILED(level) && Reporting::Logger::LOG_LEVEL_ENABLED(level)()) LOG_REPORT(level, fmt, __VA_ARGS__)
 
 #ifndef _DEBUG
 #define LOG_TRACE(...)      {}
@@ -244,9 +263,9 @@ namespace Reporting {
 #define LOG_DEBUG_INFOH     LOG_DEBUG
 #else
 #define LOG_DEBUG_INFOH(fmt, ...) if (LOG_DEBUG_INFOH_FLAG) {\
-                                if (Reporting::Logger::IsInfoHEnabled()) logger.InfoH(__VA_OPT__(std::format)(fmt __VA_OPT__(,) __VA_ARGS__), __func__, __FILE__, __LINE__);\
+                                if (LOG_LEVEL_COMPILED(InfoH) && Reporting::Logger::IsInfoHEnabled()) logger.InfoH(__VA_OPT__(std::format)(fmt __VA_OPT__(,) __VA_ARGS__), __func__, __FILE__, __LINE__);\
                             } else {\
-                                if (Reporting::Logger::IsDebugEnabled()) logger.Debug(__VA_OPT__(std::format)(fmt __VA_OPT__(,) __VA_ARGS__), __func__, __FILE__, __LINE__);\
+                                if (LOG_LEVEL_COMPILED(Debug) && Reporting::Logger::IsDebugEnabled()) logger.Debug(__VA_OPT__(std::format)(fmt __VA_OPT__(,) __VA_ARGS__), __func__, __FILE__, __LINE__);\
                             }
 #endif
 }
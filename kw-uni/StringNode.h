@@ -13,6 +13,9 @@ public:
 
     StringNode(wchar_t ch);
 
+    // 解析済みの文字列と書き換え対象文字列長から作成する (コンパイル済みストロークテーブルからの復元用)
+    StringNode(const MString& ms, size_t rewLen) : str(ms), rewritableLen(rewLen) { }
+
     ~StringNode() override { }
 
     // 当ノードを処理する State インスタンスを作成する
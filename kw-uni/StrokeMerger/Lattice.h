@@ -16,6 +16,8 @@ class WordPiece {
     const PostRewriteOneShotNode* _rewriteNode;
     // 単語素片
     MString _pieceStr;
+    // 単語素片を '|' で分割した候補 (素片を K 個の候補に適用するときに、毎回分割しなくて済むように)
+    utils::PieceAlternatives _alternatives;
     // 書き換え対象文字数
     //size_t _rewritableLen;
     // 削除文字数
@@ -27,7 +29,7 @@ public:
     }
 
     WordPiece(const MString& ms, int len, int nBS)
-        : _rewriteNode(0), _pieceStr(ms), _strokeLen(len), _numBS(nBS) {
+        : _rewriteNode(0), _pieceStr(ms), _alternatives(ms), _strokeLen(len), _numBS(nBS) {
     }
 
     WordPiece(const PostRewriteOneShotNode* rewriteNode, int len)
@@ -67,6 +69,16 @@ public:
         return _rewriteNode ? _rewriteNode->getString() : _pieceStr;
     }
 
+    // 複数文字が設定されたストロークの候補数 (書き換えノードなら、そのノードの出力文字列のもの)
+    size_t numAlternatives() const {
+        return _rewriteNode ? _rewriteNode->getRewriteInfo().numAlternatives() : _alternatives.size();
+    }
+
+    // i 番目の候補
+    MStringView alternative(size_t i) const {
+        return _rewriteNode ? _rewriteNode->getRewriteInfo().alternative(i) : _alternatives.at(_pieceStr, i);
+    }
+
     int strokeLen() const {
         return _strokeLen;
     }
@@ -128,6 +140,14 @@ struct LatticeResult {
     String debugString() const;
 };
 
+// 読み込むNgramファイル (rootDir からの相対パス)
+// SETTINGS によって決まるので、バックグラウンドで読み込むときは呼び出し元のスレッドで取得しておく
+struct NgramFileNames {
+    String realtimeNgramFile;
+    String userNgramFile;
+    String selectedNgramFile;
+};
+
 //#define WORD_LATTICE Lattice::Singleton
 
 // Lattice2
@@ -197,6 +217,12 @@ public:
 
     static void reloadNgramFiles();
 
+    // 現在の設定で読み込むNgramファイル (SETTINGS を参照するので、デコーダのロックを保持して呼ぶこと)
+    static NgramFileNames currentNgramFileNames();
+
+    // Ngramファイルの新しい世代を構築し、それを差し替える関数を返す (デコーダのロックなしで呼んでよい)
+    static std::function<void()> prepareReloadNgramFiles(StringRef rootDir, const NgramFileNames& files);
+
     static void reloadUserCostFile();
 
     static void updateRealtimeNgram(const MString& str);
@@ -207,6 +233,9 @@ public:
 
     static void reloadGlobalPostRewriteMapFile();
 
+    // グローバルな後置書き換えマップを構築し、それを差し替える関数を返す (デコーダのロックなしで呼んでよい)
+    static std::function<void()> prepareReloadGlobalPostRewriteMapFile(StringRef rootDir);
+
     // リアルタイムNgram辞書のパラメータ設定
     static void setRealtimeDictParameters();
 
@@ -1,12 +1,13 @@
 #include "Logger.h"
 #include "file_utils.h"
 
-#include "settings.h"
+#include "Settings.h"
 #include "StateCommonInfo.h"
 
 #include "Lattice.h"
 #include "Lattice2_Common.h"
 #include "Lattice2_CandidateString.h"
+#include "Lattice2_CandidateLog.h"
 #include "Lattice2_Kbest.h"
 #include "Lattice2_Morpher.h"
 #include "Lattice2_Ngram.h"
@@ -44,7 +45,15 @@ namespace lattice2 {
 
         bool _candidateLogEnabled = false;
 
-        Deque<String> _candidateLogQueue;
+        // 解候補ログ (最初に有効になったときに作る)
+        std::unique_ptr<CandidateLog> _candidateLog;
+
+        // 解候補ログが有効なら、その記録先を返す
+        CandidateLog* activeCandidateLog() {
+            if (!_candidateLogEnabled && !SETTINGS->multiStreamDetailLog) return nullptr;
+            if (!_candidateLog) _candidateLog = std::make_unique<CandidateLog>();
+            return _candidateLog.get();
+        }
 
         String formatStringOfWordPieces(const std::vector<WordPiece>& pieces) {
             return utils::join(utils::select<String>(pieces, [](WordPiece p){return p.debugString();}), _T(" | "));
@@ -237,6 +246,11 @@ namespace lattice2 {
             //}
             //_LOG_DETAIL(L"_kBestList.size={}", _kBestList->size());
 
+            // 解候補ログの記録先 (無効なら nullptr)
+            CandidateLog* candLog = activeCandidateLog();
+            _kBestList->setCandidateLog(candLog);
+            if (candLog) candLog->beginStroke();
+
             // 候補リストの更新
             _kBestList->updateKBestList(pieces, prefType, useMorphAnalyzer, currentStrokeCount, strokeBack, bKatakanaConversion);
 
@@ -249,19 +263,16 @@ namespace lattice2 {
             _prevOutputStr = outStr;
             outStr = utils::safe_substr(outStr, commonLen);
 
-            _LOG_DETAIL(_T("OUTPUT: {}, numBS={}\n\n{}"), to_wstr(outStr), numBS, _kBestList->debugKBestString(1000));
-            if (_candidateLogEnabled || SETTINGS->multiStreamDetailLog) {
-                //const int DEBUG_LOG_SIZE = SETTINGS->multiStreamBeamSize * 2;
-                //while (_candidateLogQueue.size() >= DEBUG_LOG_SIZE) _candidateLogQueue.pop_front();
-                _candidateLogQueue.clear();
-                _candidateLogQueue.push_back(
-                    std::format(L"================================================================================\nENTER: currentStrokeCount={}, pieces: {}\n",
-                        currentStrokeCount, formatStringOfWordPieces(pieces)));
+            _LOG_DETAIL(_T("OUTPUT: {}, numBS={}\n\n{}{}"), to_wstr(outStr), numBS,
+                candLog ? candLog->debugCandidateCosts() : String(), _kBestList->debugKBestString(1000));
+            if (candLog) {
+                // 書式化はせずに、そのまま記録しておく (テキストにするのは saveCandidateLog のとき)
+                candLog->addStrokeHeader(currentStrokeCount, pieces);
                 if (pieces.back().numBS() <= 0) {
-                    _candidateLogQueue.push_back(
-                        std::format(L"\n{}\nOUTPUT: {}, numBS={}\n\n",
-                            _kBestList->debugKBestString(200), to_wstr(outStr), numBS));
+                    _kBestList->recordCandidates(*candLog, 200);
+                    candLog->addOutput(outStr, numBS);
                 }
+                candLog->endStroke();
             }
 
             //LOG_DEBUGH(L"H:faces={}", to_wstr(STATE_COMMON->GetFaces(), 20));
@@ -282,6 +293,11 @@ namespace lattice2 {
         void enableCandidateLog(bool enabled) override {
             LOG_INFOH(_T("CALLED: enabled={}"), enabled);
             _candidateLogEnabled = enabled;
+            if (!enabled && !SETTINGS->multiStreamDetailLog) {
+                // 無効にしたらリングバッファも解放する
+                _kBestList->setCandidateLog(nullptr);
+                _candidateLog.reset();
+            }
         }
 
         bool isCandidateLogEnabled() override {
@@ -290,19 +306,26 @@ namespace lattice2 {
         }
 
         // 融合候補の表示
+        // 直前の打鍵の分をテキストで書き出し、リングバッファ全体はバイナリで書き出す (candlog-dump でテキストにできる)
         void saveCandidateLog() override {
             LOG_INFOH(_T("ENTER"));
-            String result;
-            while (!_candidateLogQueue.empty()) {
-                result.append(_candidateLogQueue.front());
-                _candidateLogQueue.pop_front();
-            }
-            LOG_INFOH(L"result: {}", result);
-            utils::OfstreamWriter writer(utils::joinPath(SETTINGS->rootDir, SETTINGS->mergerCandidateFile));
+            candidate_log::Snapshot snap;
+            if (_candidateLog) snap = _candidateLog->snapshot();
+            std::string result = candidate_log::renderText(snap, true);
+            LOG_INFOH(L"result: {}", utils::utf8_decode(result));
+            String path = utils::joinPath(SETTINGS->rootDir, SETTINGS->mergerCandidateFile);
+            utils::OfstreamWriter writer(path);
             if (writer.success()) {
-                writer.writeLine(utils::utf8_encode(result));
+                writer.writeLine(result);
                 LOG_INFO(_T("result written"));
             }
+            if (_candidateLog) {
+                std::ofstream ofs(std::filesystem::path(path + _T(".bin")), std::ios_base::out | std::ios_base::binary);
+                if (ofs) {
+                    candidate_log::writeSnapshot(ofs, snap);
+                    LOG_INFO(_T("binary log written: records={}, strings={}"), snap.records.size(), snap.strings.size());
+                }
+            }
             LOG_INFOH(_T("LEAVE"));
         }
 
@@ -328,6 +351,14 @@ void Lattice2::reloadNgramFiles() {
     lattice2::loadNgramFiles();
 }
 
+NgramFileNames Lattice2::currentNgramFileNames() {
+    return lattice2::currentNgramFileNames();
+}
+
+std::function<void()> Lattice2::prepareReloadNgramFiles(StringRef rootDir, const NgramFileNames& files) {
+    return lattice2::prepareNgramFiles(rootDir, files);
+}
+
 void Lattice2::reloadUserCostFile() {
     //lattice2::loadCostAndNgramFile();
 }
@@ -349,6 +380,10 @@ void Lattice2::reloadGlobalPostRewriteMapFile() {
     lattice2::readGlobalPostRewriteMapFile();
 }
 
+std::function<void()> Lattice2::prepareReloadGlobalPostRewriteMapFile(StringRef rootDir) {
+    return lattice2::prepareGlobalPostRewriteMapFile(rootDir);
+}
+
 // リアルタイムNgram辞書のパラメータ設定
 void Lattice2::setRealtimeDictParameters() {
     lattice2::setRealtimeDictParameters();
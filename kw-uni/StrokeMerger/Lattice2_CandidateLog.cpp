@@ -0,0 +1,149 @@
+#include "Logger.h"
+
+#include "Lattice.h"
+#include "Lattice2_CandidateString.h"
+#include "Lattice2_CandidateLog.h"
+
+namespace {
+    DEFINE_LOGGER(Lattice2_CandidateLog);
+
+    // 文字列表の上限 (これを超えたら、次の打鍵の開始時に記録ごと捨てる)
+    const size_t MAX_STRING_TABLE_BYTES = 8 * 1024 * 1024;
+}
+
+namespace lattice2 {
+    using namespace candidate_log;
+
+    CandidateLog::CandidateLog(size_t capacity) : _ring(capacity > 0 ? capacity : 1) {
+    }
+
+    uint32_t CandidateLog::intern(const MString& s) {
+        auto [iter, bNew] = _stringIds.try_emplace(s, (uint32_t)_strings.size());
+        if (bNew) {
+            _strings.push_back(utils::utf8_encode(to_wstr(s)));
+            _stringBytes += _strings.back().size() + s.size() * sizeof(mchar_t);
+        }
+        return iter->second;
+    }
+
+    void CandidateLog::push(const Record& rec) {
+        _ring[_next] = rec;
+        if (++_next == _ring.size()) {
+            _next = 0;
+            _wrapped = true;
+        }
+    }
+
+    void CandidateLog::beginStroke() {
+        if (_stringBytes > MAX_STRING_TABLE_BYTES) {
+            LOG_INFO(_T("string table full: strings={}, bytes={}; clear log"), _strings.size(), _stringBytes);
+            _stringIds.clear();
+            _strings.clear();
+            _stringBytes = 0;
+            _next = 0;
+            _wrapped = false;
+        }
+        Record rec;
+        rec.kind = REC_BEGIN;
+        push(rec);
+    }
+
+    void CandidateLog::endStroke() {
+        Record rec;
+        rec.kind = REC_END;
+        push(rec);
+    }
+
+    void CandidateLog::addStrokeHeader(int strokeCount, const std::vector<WordPiece>& pieces) {
+        Record rec;
+        rec.kind = REC_HEADER;
+        rec.v[0] = strokeCount;
+        rec.v[1] = (int32_t)pieces.size();
+        push(rec);
+        for (const auto& piece : pieces) {
+            // WordPiece::debugString と同じ値を記録する
+            Record pr;
+            pr.kind = REC_PIECE;
+            pr.strId = intern(piece.getString());
+            pr.v[0] = piece.strokeLen();
+            pr.v[1] = piece.rewriteNode() ? (int32_t)piece.rewriteNode()->getRewritableLen() : 0;
+            pr.v[2] = piece.rewriteNode() ? 0 : piece.numBS();
+            push(pr);
+        }
+    }
+
+    void CandidateLog::addCandidateCost(const MString& candStr, int totalCost, int candCost, int morphCost, int ngramCost, const std::vector<MString>& morphs) {
+        Record rec;
+        rec.kind = REC_CAND_COST;
+        rec.strId = intern(candStr);
+        rec.v[0] = totalCost;
+        rec.v[1] = candCost;
+        rec.v[2] = morphCost;
+        rec.v[3] = ngramCost;
+        rec.v[4] = (int32_t)morphs.size();
+        push(rec);
+        for (const auto& morph : morphs) {
+            Record mr;
+            mr.kind = REC_MORPH;
+            mr.strId = intern(morph);
+            push(mr);
+        }
+    }
+
+    void CandidateLog::addKBest(const std::vector<CandidateString>& candidates, size_t maxLn) {
+        Record rec;
+        rec.kind = REC_KBEST_TOTAL;
+        rec.v[0] = (int32_t)candidates.size();
+        push(rec);
+        for (size_t i = 0; i < candidates.size() && i < maxLn; ++i) {
+            const auto& cand = candidates[i];
+            Record cr;
+            cr.kind = REC_KBEST_CAND;
+            cr.flags = cand.isPaddingDerived() ? FLAG_PADDING : 0;
+            cr.strId = intern(cand.string());
+            cr.strId2 = intern(cand.mazeFeat());
+            cr.v[0] = (int32_t)i;
+            cr.v[1] = cand.morphCost();
+            cr.v[2] = cand.ngramCost();
+            cr.v[3] = cand.penalty();
+            cr.v[4] = cand.strokeLen();
+            cr.v[5] = (int32_t)cand.followingPreferenceType();
+            push(cr);
+        }
+    }
+
+    void CandidateLog::addOutput(const MString& outStr, size_t numBS) {
+        Record rec;
+        rec.kind = REC_OUTPUT;
+        rec.strId = intern(outStr);
+        rec.v[0] = (int32_t)numBS;
+        push(rec);
+    }
+
+    Snapshot CandidateLog::snapshot() const {
+        Snapshot snap;
+        snap.strings = _strings;
+        if (_wrapped) {
+            snap.records.reserve(_ring.size());
+            snap.records.insert(snap.records.end(), _ring.begin() + _next, _ring.end());
+        }
+        snap.records.insert(snap.records.end(), _ring.begin(), _ring.begin() + _next);
+        return snap;
+    }
+
+    String CandidateLog::debugCandidateCosts() const {
+        // 最後の REC_BEGIN まで遡って、記録中の打鍵のレコードを古い順に並べる
+        std::vector<Record> recs;
+        size_t numRecords = _wrapped ? _ring.size() : _next;
+        for (size_t n = 1; n <= numRecords; ++n) {
+            const Record& rec = _ring[(_next + _ring.size() - n) % _ring.size()];
+            if (rec.kind == REC_BEGIN) break;
+            recs.push_back(rec);
+        }
+        std::reverse(recs.begin(), recs.end());
+        std::string result;
+        renderCandidateCosts(result, _strings, recs, 0, recs.size());
+        return utils::utf8_decode(result);
+    }
+
+} // namespace lattice2
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Lattice2_CandidateLogFormat.h"
+
+namespace lattice2 {
+    class CandidateString;
+
+    // 解候補ログ
+    // 打鍵ごとの候補のスナップショットを、文字列表のIDと整数のコストからなる固定長のレコードとして、
+    // 固定サイズのリングバッファに記録する (記録時には書式化もファイル出力もしない)
+    // テキストにするのは保存時 (saveCandidateLog) と、オフラインのダンプツール (candlog-dump) だけ
+    class CandidateLog {
+        // レコードのリングバッファ
+        std::vector<candidate_log::Record> _ring;
+        size_t _next = 0;
+        bool _wrapped = false;
+
+        // 文字列表 (MString => ID, ID => UTF-8)
+        std::unordered_map<MString, uint32_t> _stringIds;
+        std::vector<std::string> _strings;
+        size_t _stringBytes = 0;
+
+        uint32_t intern(const MString& s);
+
+        void push(const candidate_log::Record& rec);
+
+    public:
+        // 既定のリングバッファのレコード数 (40バイト x 64K)
+        static const size_t DEFAULT_CAPACITY = 1 << 16;
+
+        CandidateLog(size_t capacity = DEFAULT_CAPACITY);
+
+        // 打鍵の開始 (文字列表が大きくなりすぎていたら、記録ごと捨ててやり直す)
+        void beginStroke();
+
+        // 打鍵の終了
+        void endStroke();
+
+        // 入力された単語素片
+        void addStrokeHeader(int strokeCount, const std::vector<WordPiece>& pieces);
+
+        // 候補のコスト計算の結果
+        void addCandidateCost(const MString& candStr, int totalCost, int candCost, int morphCost, int ngramCost, const std::vector<MString>& morphs);
+
+        // K-best 候補 (先頭から maxLn 個まで)
+        void addKBest(const std::vector<CandidateString>& candidates, size_t maxLn);
+
+        // 出力文字列
+        void addOutput(const MString& outStr, size_t numBS);
+
+        // 記録を古い順に取り出す
+        candidate_log::Snapshot snapshot() const;
+
+        // 記録中の打鍵の、候補ごとのコストのテキスト (詳細ログ用)
+        String debugCandidateCosts() const;
+    };
+
+} // namespace lattice2
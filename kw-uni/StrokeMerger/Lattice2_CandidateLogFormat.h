@@ -0,0 +1,226 @@
+#pragma once
+
+// 解候補ログのバイナリ形式と、そのテキスト化
+// - デコーダ (Lattice2_CandidateLog) と、オフラインのダンプツール (candlog-dump) の両方から使うので、標準ライブラリだけに依存させる
+// - 文字列はすべて UTF-8 で、文字列表のIDで参照する
+
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace lattice2 {
+    namespace candidate_log {
+        // レコードの種別
+        enum RecordKind : uint8_t {
+            REC_BEGIN = 1,      // 打鍵の開始
+            REC_HEADER,         // v[0]=currentStrokeCount, v[1]=素片数
+            REC_PIECE,          // strId=素片文字列, v[0]=strokeLen, v[1]=rewLen, v[2]=numBS
+            REC_CAND_COST,      // strId=候補文字列, v[0]=totalCost, v[1]=candCost, v[2]=morphCost, v[3]=ngramCost, v[4]=形態素数
+            REC_MORPH,          // strId=形態素 (直前の REC_CAND_COST に続く)
+            REC_KBEST_TOTAL,    // v[0]=候補数
+            REC_KBEST_CAND,     // strId=候補文字列, strId2=mazeFeat, v[0]=順位, v[1]=morph, v[2]=ngram, v[3]=penalty, v[4]=strokeLen, v[5]=prefType
+            REC_OUTPUT,         // strId=出力文字列, v[0]=numBS
+            REC_END,            // 打鍵の終了
+        };
+
+        // REC_KBEST_CAND の flags
+        const uint8_t FLAG_PADDING = 1;
+
+        // 固定長のレコード
+        struct Record {
+            uint8_t kind = 0;
+            uint8_t flags = 0;
+            uint16_t reserved = 0;
+            uint32_t strId = 0;
+            uint32_t strId2 = 0;
+            int32_t v[7] = {};
+        };
+        static_assert(sizeof(Record) == 40, "Record must be 40 bytes");
+
+        // 保存された解候補ログ (レコードは古い順)
+        struct Snapshot {
+            std::vector<std::string> strings;
+            std::vector<Record> records;
+        };
+
+        const char FILE_MAGIC[8] = { 'K', 'W', 'C', 'A', 'N', 'D', 'L', 'G' };
+        const uint32_t FILE_VERSION = 1;
+
+        namespace detail {
+            inline void writeU32(std::ostream& os, uint32_t val) {
+                os.write(reinterpret_cast<const char*>(&val), sizeof(val));
+            }
+
+            inline bool readU32(std::istream& is, uint32_t& val) {
+                return (bool)is.read(reinterpret_cast<char*>(&val), sizeof(val));
+            }
+
+            inline const std::string& str(const std::vector<std::string>& strings, uint32_t id) {
+                static const std::string empty;
+                return id < strings.size() ? strings[id] : empty;
+            }
+
+            inline const std::string& str(const Snapshot& snap, uint32_t id) {
+                return str(snap.strings, id);
+            }
+
+            inline std::string prefTypeName(int prefType) {
+                // FollowingPreferenceType の to_string と同じ
+                switch (prefType) {
+                case 0: return "Any";
+                case 1: return "Kanji";
+                case 2: return "Hiragana";
+                default: return "Unknown";
+                }
+            }
+
+            // 形態素の区切りのタブは空白にして "> <" でつなぐ
+            inline void appendMorphs(std::string& out, const std::vector<std::string>& strings, const std::vector<Record>& recs, size_t first, size_t last) {
+                for (size_t i = first; i < last; ++i) {
+                    if (i > first) out.append("> <");
+                    for (char ch : str(strings, recs[i].strId)) out.push_back(ch == '\t' ? ' ' : ch);
+                }
+            }
+        }
+
+        // recs[begin, end) にある候補ごとのコスト (REC_CAND_COST とそれに続く REC_MORPH) を1行ずつテキストにする
+        inline void renderCandidateCosts(std::string& out, const std::vector<std::string>& strings, const std::vector<Record>& recs, size_t begin, size_t end) {
+            auto num = [](int v) { return std::to_string(v); };
+            for (size_t i = begin; i < end; ++i) {
+                const Record& r = recs[i];
+                if (r.kind != REC_CAND_COST) continue;
+                size_t morphEnd = i + 1;
+                while (morphEnd < end && morphEnd < i + 1 + (size_t)r.v[4] && recs[morphEnd].kind == REC_MORPH) ++morphEnd;
+                out.append("candStr=").append(detail::str(strings, r.strId)).append(", myTotalCost=").append(num(r.v[0]));
+                out.append(", candCost=").append(num(r.v[1])).append(" (morph=").append(num(r.v[2])).append(" [<");
+                detail::appendMorphs(out, strings, recs, i + 1, morphEnd);
+                out.append(">] , ngram = ").append(num(r.v[3])).append(")\n");
+            }
+        }
+
+        // ファイル形式: magic(8) version(4) 文字列数(4) {長さ(4) UTF-8}* レコード数(4) Record*
+        inline void writeSnapshot(std::ostream& os, const Snapshot& snap) {
+            os.write(FILE_MAGIC, sizeof(FILE_MAGIC));
+            detail::writeU32(os, FILE_VERSION);
+            detail::writeU32(os, (uint32_t)snap.strings.size());
+            for (const auto& s : snap.strings) {
+                detail::writeU32(os, (uint32_t)s.size());
+                os.write(s.data(), (std::streamsize)s.size());
+            }
+            detail::writeU32(os, (uint32_t)snap.records.size());
+            os.write(reinterpret_cast<const char*>(snap.records.data()), (std::streamsize)(snap.records.size() * sizeof(Record)));
+        }
+
+        inline bool readSnapshot(std::istream& is, Snapshot& snap) {
+            char magic[sizeof(FILE_MAGIC)];
+            uint32_t version = 0;
+            if (!is.read(magic, sizeof(magic)) || std::memcmp(magic, FILE_MAGIC, sizeof(magic)) != 0) return false;
+            if (!detail::readU32(is, version) || version != FILE_VERSION) return false;
+            uint32_t numStrings = 0;
+            if (!detail::readU32(is, numStrings)) return false;
+            snap.strings.assign(numStrings, std::string());
+            for (auto& s : snap.strings) {
+                uint32_t len = 0;
+                if (!detail::readU32(is, len)) return false;
+                s.resize(len);
+                if (len > 0 && !is.read(s.data(), len)) return false;
+            }
+            uint32_t numRecords = 0;
+            if (!detail::readU32(is, numRecords)) return false;
+            snap.records.resize(numRecords);
+            return numRecords == 0 || (bool)is.read(reinterpret_cast<char*>(snap.records.data()), (std::streamsize)(numRecords * sizeof(Record)));
+        }
+
+        // 1打鍵分 (REC_BEGIN から REC_END まで) をテキストにする (以前のテキスト形式の解候補ログと同じ)
+        inline void renderStroke(std::string& out, const Snapshot& snap, size_t begin, size_t end) {
+            const auto& recs = snap.records;
+            auto num = [](int v) { return std::to_string(v); };
+
+            // ヘッダと素片
+            bool hasOutput = false;
+            for (size_t i = begin; i < end; ++i) {
+                const Record& r = recs[i];
+                if (r.kind == REC_HEADER) {
+                    out.append("================================================================================\nENTER: currentStrokeCount=");
+                    out.append(num(r.v[0])).append(", pieces: ");
+                    size_t nPieces = 0;
+                    for (size_t j = i + 1; j < end && recs[j].kind == REC_PIECE; ++j) {
+                        const Record& p = recs[j];
+                        if (nPieces++ > 0) out.append(" | ");
+                        out.append("<'").append(detail::str(snap, p.strId)).append("', _strokeLen=").append(num(p.v[0]));
+                        if (p.v[0] < 0) out.append(" (PADDING)");
+                        out.append(", rewLen=").append(num(p.v[1])).append(", numBS=").append(num(p.v[2])).append(">");
+                    }
+                    out.append("\n");
+                } else if (r.kind == REC_OUTPUT) {
+                    hasOutput = true;
+                }
+            }
+            if (!hasOutput) return;
+
+            out.append("\n");
+            // 候補ごとのコスト
+            renderCandidateCosts(out, snap.strings, recs, begin, end);
+
+            // K-best 候補 (KBestList::debugCandidates と同じブロック表示)
+            const int maxLen = 1000;
+            int strokeLen = maxLen;
+            int n = 0;
+            bool firstBlock = true;
+            for (size_t i = begin; i < end; ++i) {
+                const Record& r = recs[i];
+                if (r.kind == REC_KBEST_TOTAL) {
+                    out.append("\nTotal candidates=").append(num(r.v[0])).append("\n\nKBest:\n");
+                } else if (r.kind == REC_KBEST_CAND) {
+                    if (r.v[4] != strokeLen) {
+                        if (strokeLen != maxLen) {
+                            out.append("--- StrokeLen: ").append(num(strokeLen)).append(", size=").append(num(n)).append(" ---\n");
+                            firstBlock = false;
+                        }
+                        n = 0;
+                        strokeLen = r.v[4];
+                    }
+                    ++n;
+                    if (firstBlock || n <= 5) {
+                        out.append(num(r.v[0])).append(": ").append(detail::str(snap, r.strId));
+                        out.append(" (totalCost=").append(num(r.v[1] + r.v[2] + r.v[3]));
+                        out.append("(_morph=").append(num(r.v[1])).append(",_ngram=").append(num(r.v[2]));
+                        out.append(",_penalty=").append(num(r.v[3])).append(",_padding=").append((r.flags & FLAG_PADDING) ? "1" : "0");
+                        out.append("), strokeLen=").append(num(r.v[4])).append(", prefType=").append(detail::prefTypeName(r.v[5]));
+                        out.append(", mazeFeat='").append(detail::str(snap, r.strId2)).append("')\n");
+                    }
+                } else if (r.kind == REC_OUTPUT) {
+                    if (strokeLen != maxLen) {
+                        out.append("--- StrokeLen: ").append(num(strokeLen)).append(", size=").append(num(n)).append(" ---\n");
+                    }
+                    out.append("\nOUTPUT: ").append(detail::str(snap, r.strId)).append(", numBS=").append(num(r.v[0])).append("\n\n");
+                }
+            }
+        }
+
+        // 記録をテキストにする
+        // lastStrokeOnly なら、最後に完了した打鍵の分だけを出力する (途中で切れた打鍵は出力しない)
+        inline std::string renderText(const Snapshot& snap, bool lastStrokeOnly) {
+            std::string out;
+            std::vector<std::pair<size_t, size_t>> strokes;
+            size_t begin = snap.records.size();
+            for (size_t i = 0; i < snap.records.size(); ++i) {
+                uint8_t kind = snap.records[i].kind;
+                if (kind == REC_BEGIN) {
+                    begin = i;
+                } else if (kind == REC_END && begin < i) {
+                    strokes.emplace_back(begin, i);
+                    begin = snap.records.size();
+                }
+            }
+            size_t first = lastStrokeOnly && !strokes.empty() ? strokes.size() - 1 : 0;
+            for (size_t k = first; k < strokes.size(); ++k) {
+                renderStroke(out, snap, strokes[k].first + 1, strokes[k].second);
+            }
+            return out;
+        }
+    }
+}
@@ -1,13 +1,14 @@
 #include "Logger.h"
 #include "file_utils.h"
+#include "reversed_key_trie.h"
 //
-#include "settings.h"
+#include "Settings.h"
 #include "StateCommonInfo.h"
 #include "BushuComp/BushuComp.h"
 #include "BushuComp/BushuDic.h"
 #include "KeysAndChars/EasyChars.h"
 //
-#include "Dymazin/MorphBridge.h"
+#include "DyMazin/MorphBridge.h"
 
 #include "Lattice.h"
 #include "Lattice2_Common.h"
@@ -23,12 +24,34 @@ namespace lattice2 {
 #define GLOBAL_POST_REWRITE_FILE    JOIN_USER_FILES_FOLDER(L"global-post-rewrite-map.txt")
 
     // グローバルな後置書き換えマップ
-    std::map<MString, MString> globalPostRewriteMap;
+    struct GlobalPostRewriteMap {
+        std::map<MString, MString> entries;
+        // entries のキーを逆順に並べたトライ (entries の要素を指すので、entries とともに差し替えること)
+        utils::ReversedKeyTrie<MString> trie;
+
+        // str の末尾 (1~maxlen 文字) に adder を付加したものに一致する最長のキーについて、
+        // その書き換え文字列と、キーのうち str 側の長さを返す (見つからなければ nullptr)
+        std::tuple<const MString*, size_t> matchTail(const MString& str, size_t maxlen, MStringView adder) const {
+            const MString* value = nullptr;
+            size_t matchLen = 0;
+            if (trie.empty()) return { value, matchLen };
+            uint32_t node = trie.ROOT;
+            for (size_t i = adder.size(); i > 0; --i) {
+                node = trie.next(node, adder[i - 1]);
+                if (node == trie.ROOT) return { value, matchLen };
+            }
+            size_t len = std::min(maxlen, str.size());
+            trie.walkBack(node, str.data() + str.size() - len, len, value, matchLen);
+            return { value, matchLen };
+        }
+    };
+    GlobalPostRewriteMap globalPostRewriteMap;
 
-    // グローバルな後置書き換えマップファイルの読み込み
-    void readGlobalPostRewriteMapFile() {
-        globalPostRewriteMap.clear();
-        auto path = utils::joinPath(SETTINGS->rootDir, GLOBAL_POST_REWRITE_FILE);
+    // グローバルな後置書き換えマップファイルを読み込み、差し替える関数を返す
+    // (検索用のトライも読み込みと同じスレッドで作っておく)
+    std::function<void()> prepareGlobalPostRewriteMapFile(StringRef rootDir) {
+        auto newMap = std::make_shared<GlobalPostRewriteMap>();
+        auto path = utils::joinPath(rootDir, GLOBAL_POST_REWRITE_FILE);
         LOG_INFO(_T("LOAD: {}"), path.c_str());
         utils::IfstreamReader reader(path);
         int count = 0;
@@ -40,12 +63,23 @@ namespace lattice2 {
                     items[0].size() >= 1 && items[1].size() >= 1 &&
                     items[0][0] != L'#' && items[0][0] != L';') {
 
-                   globalPostRewriteMap[to_mstr(items[0])] = to_mstr(items[1]);
+                   newMap->entries[to_mstr(items[0])] = to_mstr(items[1]);
                    ++count;
                 }
             }
         }
+        newMap->trie.build(newMap->entries);
         LOG_INFO(_T("LEAVE: count={}"), count);
+        // std::map の swap では要素は移動しないので、トライが指す先はそのまま有効
+        return [newMap]() {
+            globalPostRewriteMap.entries.swap(newMap->entries);
+            std::swap(globalPostRewriteMap.trie, newMap->trie);
+        };
+    }
+
+    // グローバルな後置書き換えマップファイルの読み込み
+    void readGlobalPostRewriteMapFile() {
+        prepareGlobalPostRewriteMapFile(SETTINGS->rootDir)();
     }
 
     DEFINE_CLASS_LOGGER(CandidateString);
@@ -56,41 +90,20 @@ namespace lattice2 {
         size_t maxlen = SETTINGS->kanaTrainingMode && ROOT_STROKE_NODE->hasOnlyUsualRewriteNdoe() ? 0 : 8;     // かな入力練習モードで濁点のみなら書き換えをやらない
         bool bRollOverStroke = STATE_COMMON->IsRollOverStroke();
         _LOG_DETAIL(_T("bRollOverStroke={}"), bRollOverStroke);
-        while (maxlen > 0) {
-            LOG_DEBUG(_T("maxlen={}"), maxlen);
 // TODO: OUTPUT_STACK への出力が正しくなるように修正する
-#if true
-            const MString targetStr = utils::safe_tailstr(_str, maxlen);
-#else
-            const MString targetStr = SETTINGS->googleCompatible ? OUTPUT_STACK->backStringWhileOnlyRewritable(maxlen) : OUTPUT_STACK->backStringUptoRewritableBlock(maxlen);
-#endif
-            LOG_DEBUG(_T("targetStr={}"), to_wstr(targetStr));
-            if (targetStr.empty()) break;
-
-            const RewriteInfo* rewInfo = 0;
-            if (bRollOverStroke) rewInfo = rewriteNode->getRewriteInfo(targetStr + MSTR_PLUS);        // ロールオーバー打ちのときは"+"を付加したエントリを検索
-            if (!rewInfo) rewInfo = rewriteNode->getRewriteInfo(targetStr);
-            if (rewInfo) {
-                LOG_DEBUG(_T("REWRITE_INFO found: outStr={}, rewritableLen={}, subTable={:p}"), to_wstr(rewInfo->rewriteStr), rewInfo->rewritableLen, (void*)rewInfo->subTable);
-                return { rewInfo, (int)targetStr.size() };
-            }
-
-            maxlen = targetStr.size() - 1;
+        // 末尾 maxlen 文字を逆順トライで遡り、最長のキーを求める(ロールオーバー打ちのときは"+"を付加したエントリを優先)
+        size_t len = std::min(maxlen, string().size());
+        const RewriteInfo* rewInfo;
+        size_t numBS;
+        std::tie(rewInfo, numBS) = rewriteNode->matchTail(string().data() + string().size() - len, len, bRollOverStroke);
+        if (rewInfo) {
+            LOG_DEBUG(_T("REWRITE_INFO found: outStr={}, rewritableLen={}, subTable={:p}"), to_wstr(rewInfo->rewriteStr), rewInfo->rewritableLen, (void*)rewInfo->subTable);
         }
-        return { 0, 0 };
+        return { rewInfo, (int)numBS };
     }
 
-    // 複数文字が設定されているストロークを1文字ずつに分解
-    std::vector<MString> CandidateString::split_piece_str(const MString& s) const {
-        if (s.size() == 1 && s.front() == '|') {
-            return std::vector<MString>(1, s);
-        } else {
-            return utils::split(s, '|');
-        }
-    }
-
-    MString CandidateString::convertoToKatakanaIfAny(const MString& str, bool bKatakana) const {
-        MString result = str;
+    MString CandidateString::convertoToKatakanaIfAny(MStringView str, bool bKatakana) const {
+        MString result(str);
         if (bKatakana) {
             for (size_t i = 0; i < result.size(); ++i) {
                 mchar_t ch = (wchar_t)result[i];
@@ -101,39 +114,46 @@ namespace lattice2 {
     }
 
     // グローバルな後置書き換えを適用する
-    MString CandidateString::applyGlobalPostRewrite(const MString& adder) const {
+    MString CandidateString::applyGlobalPostRewrite(MStringView adder) const {
         size_t maxlen = SETTINGS->kanaTrainingMode && ROOT_STROKE_NODE->hasOnlyUsualRewriteNdoe() ? 0 : 8;     // かな入力練習モードで濁点のみなら書き換えをやらない
-        if (maxlen > _str.size()) maxlen = _str.size();
-        for (size_t len = maxlen; len > 0; --len) {
-            MString key = utils::safe_tailstr(_str, len) + adder;
-            LOG_DEBUG(_T("key={}"), to_wstr(key));
-            auto iter = globalPostRewriteMap.find(key);
-            if (iter != globalPostRewriteMap.end()) {
-                // 書き換え文字列が見つかった
-                LOG_DEBUG(_T("FOUND: rewrite={}"), to_wstr(iter->second));
-                return len < _str.size() ? utils::safe_substr(_str, 0, _str.size() - len) + iter->second : iter->second;
-            }
+        // adder と末尾 maxlen 文字を逆順トライで遡り、最長のキーを求める
+        auto [rewrite, len] = globalPostRewriteMap.matchTail(string(), maxlen, adder);
+        if (rewrite) {
+            // 書き換え文字列が見つかった
+            LOG_DEBUG(_T("FOUND: key={}{}, rewrite={}"), to_wstr(utils::safe_tailstr(string(), len)), to_wstr(MString(adder)), to_wstr(*rewrite));
+            return len < string().size() ? utils::safe_substr(string(), 0, string().size() - len) + *rewrite : *rewrite;
         }
-        return _str + adder;
+        MString result;
+        result.reserve(string().size() + adder.size());
+        result.append(string()).append(adder);
+        return result;
     }
 
     // 自動部首合成の実行
-    std::tuple<MString, int> CandidateString::applyAutoBushu(const WordPiece& piece, int strokeCount) const {
-        LOG_DEBUG(_T("CALLED: _str={}, _strokeLen={}, piece={}, strokeCount={}"), to_wstr(_str), piece.debugString(), _strokeLen, strokeCount);
+    std::tuple<MString, int> CandidateString::applyAutoBushu(const WordPiece& piece, int strokeCount, AutoBushuMemo& memo) const {
+        LOG_DEBUG(_T("CALLED: _str={}, _strokeLen={}, piece={}, strokeCount={}"), to_wstr(string()), piece.debugString(), _strokeLen, strokeCount);
         MStringResult resultOut;
         if (_strokeLen + piece.strokeLen() == strokeCount) {
             if (SETTINGS->autoBushuCompMinCount > 0 && BUSHU_DIC) {
                 // 自動部首合成が有効である
                 const MString& pieceStr = piece.getString();
-                if (_str.size() > 0 && (pieceStr.size() == 1 || (pieceStr.size() > 1 && pieceStr[1] == '|'))) {
+                if (string().size() > 0 && (pieceStr.size() == 1 || (pieceStr.size() > 1 && pieceStr[1] == '|'))) {
                     // 自動部首合成の実行 (複数文字がある場合は先頭の文字だけを対象)
-                    LOG_DEBUG(L"CALL ReduceByAutoBushu({}, {})", (wchar_t)_str.back(), (wchar_t)pieceStr.front());
-                    BUSHU_COMP_NODE->ReduceByAutoBushu(_str.back(), pieceStr.front(), resultOut);
+                    if (memo.isMissed(string().back(), pieceStr.front())) {
+                        // この打鍵で既に合成できなかった組なので辞書は引かないが、後置部首合成ノードの状態は合成しなかった場合と同じにしておく
+                        BUSHU_COMP_NODE->SetAutoBushuNotFound(string().back(), pieceStr.front());
+                        return { resultOut.resultStr(), resultOut.numBS() };
+                    }
+                    LOG_DEBUG(L"CALL ReduceByAutoBushu({}, {})", (wchar_t)string().back(), (wchar_t)pieceStr.front());
+                    BUSHU_COMP_NODE->ReduceByAutoBushu(string().back(), pieceStr.front(), resultOut);
                     if (!resultOut.resultStr().empty()) {
-                        MString s(_str);
+                        // 合成できたので、後続の呼び出しで後置部首合成ノードの状態がリセットされるようにメモを捨てる
+                        memo.clear();
+                        MString s(string());
                         s.back() = resultOut.resultStr().front();
                         return { s, 1 };
                     }
+                    memo.addMissed(string().back(), pieceStr.front());
                     //mchar_t m = BUSHU_DIC->FindAutoComposite(_str.back(), piece.getString().front());
                     ////if (m == 0) m = BUSHU_DIC->FindComposite(_str.back(), piece.getString().front(), 0);
                     //LOG_DEBUG(_T("BUSHU_DIC->FindAutoComposite({}, {}) -> {}"),
@@ -153,13 +173,13 @@ namespace lattice2 {
     // 部首合成の実行
     MString CandidateString::applyBushuComp() const {
         if (BUSHU_DIC) {
-            if (_str.size() >= 2) {
+            if (string().size() >= 2) {
                 // 部首合成の実行
-                MString ms = BUSHU_COMP_NODE->ReduceByBushu(_str[_str.size() - 2], _str[_str.size() - 1]);
+                MString ms = BUSHU_COMP_NODE->ReduceByBushu(string()[string().size() - 2], string()[string().size() - 1]);
                 _LOG_DETAIL(_T("BUSHU_COMP_NODE->ReduceByBushu({}, {}) -> {}"),
-                    to_wstr(_str[_str.size() - 2]), to_wstr(_str[_str.size() - 1]), to_wstr(ms));
+                    to_wstr(string()[string().size() - 2]), to_wstr(string()[string().size() - 1]), to_wstr(ms));
                 if (!ms.empty()) {
-                    MString s(_str.substr(0, _str.size() - 2));
+                    MString s(string().substr(0, string().size() - 2));
                     s.append(1, ms[0]);
                     return s;
                 }
@@ -305,8 +325,8 @@ namespace lattice2 {
         std::vector<CandidateString> results;
         results.reserve(k);
         size_t j = 0;
-        for (const auto& it : items) {
-            results.push_back(CandidateString(it.str, strokeLen, it.feat));     // ムーブで取り出し
+        for (auto& it : items) {
+            results.push_back(CandidateString(std::move(it.str), strokeLen, std::move(it.feat)));     // ムーブで取り出し
             ++j;
             if (j >= k) break;
         }
@@ -418,23 +438,23 @@ namespace lattice2 {
 
     // 交ぜ書き変換の実行 (末尾の空白が削除される)
     std::vector<CandidateString> CandidateString::applyMazegaki() {
-        _LOG_DETAIL(L"ENTER: _str=<{}>", to_wstr(_str));
+        _LOG_DETAIL(L"ENTER: _str=<{}>", to_wstr(string()));
         // 末尾の空白を削除
-        _str = utils::strip_tail(_str);
-        _LOG_DETAIL(L"tail stripped: _str=<{}>", to_wstr(_str));
+        _str = utils::strip_tail(string());
+        _LOG_DETAIL(L"tail stripped: _str=<{}>", to_wstr(string()));
 
         EASY_CHARS->DumpEasyCharsMemory();
 
         // リアルタイムNgramの更新
-        updateRealtimeNgram(_str);
+        updateRealtimeNgram(string());
 
         std::vector<MString> words;
         // まず、交ぜ書き優先で形態素解析する
         int mazePenalty = -1;           // -SETTINGS->morphMazeEntryPenalty
         int mazeConnPenalty = 3000;     // -SETTINGS->morphMazeConnectionPenalty
-        _LOG_DETAIL(L"MorphBridge::morphCalcCost(_str={}, words, mazePenalty={}, mazeConnPenalty={}, allowNonTerminal=False)", to_wstr(_str), mazePenalty, mazeConnPenalty);
-        _DEBUG_SENT(int cost =) MorphBridge::morphCalcCost(_str, words, mazePenalty, mazeConnPenalty, false);
-        _LOG_DETAIL(L"{}: orig morph cost={}, morph={}", to_wstr(_str), cost, to_wstr(utils::join(words, to_mstr(L" ||| "))));
+        _LOG_DETAIL(L"MorphBridge::morphCalcCost(_str={}, words, mazePenalty={}, mazeConnPenalty={}, allowNonTerminal=False)", to_wstr(string()), mazePenalty, mazeConnPenalty);
+        _DEBUG_SENT(int cost =) MorphBridge::morphCalcCost(string(), words, mazePenalty, mazeConnPenalty, false);
+        _LOG_DETAIL(L"{}: orig morph cost={}, morph={}", to_wstr(string()), cost, to_wstr(utils::join(words, to_mstr(L" ||| "))));
 
         // 形態素単位で、交ぜ書き候補を取得する
         std::vector<std::vector<MorphCand>> vecMorphCands;
@@ -461,28 +481,28 @@ namespace lattice2 {
         size_t numMorph = vecMorphCands.size();
         // 末尾からみていって空白があるか、形態素数がMAX_MAZEGAKI_MORPHSを超えたらそこで変換をストップする
         {
-            size_t spacePos = _str.find_last_of(L' ');
+            size_t spacePos = string().find_last_of(L' ');
             _LOG_DETAIL(L"spacePos={}", spacePos);
             // tailStr は空白を含んでいない末尾文字列
-            MString tailStr = spacePos != MString::npos ? utils::safe_substr(_str, spacePos + 1) : _str;
+            MString tailStr = spacePos != MString::npos ? utils::safe_substr(string(), spacePos + 1) : string();
             _LOG_DETAIL(L"tailStr=<{}>", to_wstr(tailStr));
             MString cumYomi;
             for (size_t i = 0; i < numMorph && i < MAX_MAZEGAKI_MORPHS; ++i) {
                 index = numMorph - i - 1;
                 cumYomi = vecMorphCands[index][0].yomi() + cumYomi;
                 _LOG_DETAIL(L"cumYomi=<{}>", to_wstr(cumYomi));
-                if (cumYomi == tailStr || cumYomi.size() >= _str.size()) {
+                if (cumYomi == tailStr || cumYomi.size() >= string().size()) {
                     _LOG_DETAIL(L"cumYomi MATCH: index={}", index);
                     break;
                 }
             }
-            if (cumYomi.size() < _str.size()) {
-                size_t splitPos = _str.size() - cumYomi.size();
-                while (splitPos > 0 && _str[splitPos - 1] == ' ') {
+            if (cumYomi.size() < string().size()) {
+                size_t splitPos = string().size() - cumYomi.size();
+                while (splitPos > 0 && string()[splitPos - 1] == ' ') {
                     --splitPos;
                 }
                 if (splitPos > 0) {
-                    leaderStr = _str.substr(0, splitPos);
+                    leaderStr = string().substr(0, splitPos);
                 }
             }
         }
@@ -526,9 +546,11 @@ namespace lattice2 {
                 bool bRewriteFound = false;
                 if (rewInfo) {
                     // 末尾にマッチする書き換え情報があった
-                    for (MString s : split_piece_str(rewInfo->rewriteStr)) {
-                        LOG_DEBUG(_T("add rewrite piece: {}"), to_wstr(s));
-                        ss.push_back(utils::safe_substr(_str, 0, -numBS) + s);
+                    for (size_t i = 0; i < rewInfo->numAlternatives(); ++i) {
+                        MStringView s = rewInfo->alternative(i);
+                        LOG_DEBUG(_T("add rewrite piece: {}"), to_wstr(MString(s)));
+                        ss.push_back(utils::safe_substr(string(), 0, -numBS));
+                        ss.back().append(s);
                         if (!SETTINGS->multiCandidateMode) {
                             // 単一候補モードの場合は最初の候補だけを追加
                             bRewriteFound = true;
@@ -540,17 +562,17 @@ namespace lattice2 {
                     // 複数候補モードの場合か、書き換えがなかったら場合は、書き換えない候補も追加
                     // 複数文字が設定されたストロークの扱い
                     LOG_DEBUG(_T("add Non-rewrite pieces: {}"), to_wstr(piece.rewriteNode()->getString()));
-                    for (MString s : split_piece_str(piece.rewriteNode()->getString())) {
-                        ss.push_back(_str + convertoToKatakanaIfAny(s, bKatakanaConversion));
+                    for (size_t i = 0; i < piece.numAlternatives(); ++i) {
+                        ss.push_back(string() + convertoToKatakanaIfAny(piece.alternative(i), bKatakanaConversion));
                     }
                 }
             } else {
                 int numBS = piece.numBS();
                 if (numBS > 0) {
-                    LOG_DEBUG(_T("cand.str={}, numBS={}, piece.str={}"), to_wstr(_str), numBS, to_wstr(piece.getString()));
+                    LOG_DEBUG(_T("cand.str={}, numBS={}, piece.str={}"), to_wstr(string()), numBS, to_wstr(piece.getString()));
                     MString s;
-                    if ((size_t)numBS < _str.size()) {
-                        s.append(utils::safe_substr(_str, 0, (int)(_str.size() - numBS)));
+                    if ((size_t)numBS < string().size()) {
+                        s.append(utils::safe_substr(string(), 0, (int)(string().size() - numBS)));
                     }
                     s.append(piece.getString());
                     LOG_DEBUG(_T("new.str={}"), to_wstr(s));
@@ -558,9 +580,10 @@ namespace lattice2 {
                 } else {
                     // 複数文字が設定されたストロークの扱い
                     LOG_DEBUG(_T("normalNode: {}"), to_wstr(piece.getString()));
-                    for (MString s : split_piece_str(piece.getString())) {
+                    for (size_t i = 0; i < piece.numAlternatives(); ++i) {
+                        MStringView s = piece.alternative(i);
                         if (bKatakanaConversion) {
-                            ss.push_back(_str + convertoToKatakanaIfAny(s, bKatakanaConversion));
+                            ss.push_back(string() + convertoToKatakanaIfAny(s, bKatakanaConversion));
                         } else {
                             ss.push_back(applyGlobalPostRewrite(s));
                         }
@@ -581,11 +604,11 @@ namespace lattice2 {
     }
 
     String CandidateString::infoString() const {
-        return to_wstr(_str) + _T(" (strokeLen=") + std::to_wstring(_strokeLen) + _T(")");
+        return to_wstr(string()) + _T(" (strokeLen=") + std::to_wstring(_strokeLen) + _T(")");
     }
 
     String CandidateString::debugString() const {
-        return to_wstr(_str)
+        return to_wstr(string())
             + _T(" (totalCost=") + std::to_wstring(totalCost())
             + _T("(_morph=") + std::to_wstring(_morphCost)
             + _T(",_ngram=") + std::to_wstring(_ngramCost)
@@ -594,7 +617,7 @@ namespace lattice2 {
             //+ _T(",_llama_loss=") + std::to_wstring(_llama_loss)
             + _T("), strokeLen=") + std::to_wstring(_strokeLen)
             + _T(", prefType=") + to_string(_prefType)
-            + _T(", mazeFeat='") + to_wstr(_mazeFeat)
+            + _T(", mazeFeat='") + to_wstr(mazeFeat())
             + _T("')");
     }
 
@@ -12,11 +12,90 @@ namespace lattice2 {
     // グローバルな後置書き換えマップファイルの読み込み
     void readGlobalPostRewriteMapFile();
 
+    // グローバルな後置書き換えマップファイルを現在のマップとは別に読み込み、それに差し替える関数を返す
+    std::function<void()> prepareGlobalPostRewriteMapFile(StringRef rootDir);
+
+    // 自動部首合成の打鍵ごとのメモ (打鍵ごとに clear() する)
+    // 同じ打鍵内で合成できなかった (末尾文字, 素片先頭文字) の組を覚えておき、同じ組で辞書を引き直さないようにする。
+    // 合成できた組は、辞書の参照回数の更新や後置部首合成ノードの状態設定が必要なので、メモしない。
+    class AutoBushuMemo {
+        std::vector<uint64_t> _missedPairs;
+
+        static inline uint64_t makeKey(mchar_t a, mchar_t b) { return ((uint64_t)a << 32) | b; }
+
+    public:
+        inline void clear() {
+            _missedPairs.clear();
+        }
+
+        inline bool isMissed(mchar_t a, mchar_t b) const {
+            return std::find(_missedPairs.begin(), _missedPairs.end(), makeKey(a, b)) != _missedPairs.end();
+        }
+
+        inline void addMissed(mchar_t a, mchar_t b) {
+            _missedPairs.push_back(makeKey(a, b));
+        }
+    };
+
+    // 変更不可の共有文字列
+    // 候補は beam を展開するたびにコピーされるので、文字列は共有バッファに置いて、コピーでは参照だけを増やす。
+    // ハッシュ値は構築時に計算しておき、同一文字列かどうかは先にハッシュ値で判定する。
+    class SharedMString {
+        struct Body {
+            MString str;
+            size_t hash;
+        };
+
+        std::shared_ptr<const Body> _body;
+
+        static std::shared_ptr<const Body> makeBody(MString&& s) {
+            size_t h = hashOf(s);
+            return std::make_shared<const Body>(Body{ std::move(s), h });
+        }
+
+        // 空文字列はすべての候補で共有する
+        static const std::shared_ptr<const Body>& emptyBody() {
+            static const std::shared_ptr<const Body> body = makeBody(MString());
+            return body;
+        }
+
+    public:
+        SharedMString() : _body(emptyBody()) {
+        }
+
+        SharedMString(const MString& s) : SharedMString(MString(s)) {
+        }
+
+        SharedMString(MString&& s) : _body(s.empty() ? emptyBody() : makeBody(std::move(s))) {
+        }
+
+        static inline size_t hashOf(const MString& s) {
+            return std::hash<MString>()(s);
+        }
+
+        inline const MString& str() const {
+            return _body->str;
+        }
+
+        inline size_t hash() const {
+            return _body->hash;
+        }
+
+        inline bool equals(const SharedMString& other) const {
+            return _body == other._body || (_body->hash == other._body->hash && _body->str == other._body->str);
+        }
+
+        // s のハッシュ値 h は hashOf(s) で求めておくこと
+        inline bool equals(const MString& s, size_t h) const {
+            return _body->hash == h && _body->str == s;
+        }
+    };
+
     // 候補文字列
     class CandidateString {
         DECLARE_CLASS_LOGGER;
 
-        MString _str;
+        SharedMString _str;
         int _strokeLen = 0;
         int _morphCost = 0;
         int _ngramCost = 0;
@@ -24,19 +103,16 @@ namespace lattice2 {
         bool _paddingDerived = false;
         bool _isNonTerminal = false;
         FollowingPreferenceType _prefType = FollowingPreferenceType::Any;
-        MString _mazeFeat;
+        SharedMString _mazeFeat;
         //float _llama_loss = 0.0f;
 
         // 末尾文字列にマッチする RewriteInfo を取得する
         std::tuple<const RewriteInfo*, int> matchWithTailString(const PostRewriteOneShotNode* rewriteNode) const;
 
-        // 複数文字が設定されているストロークを1文字ずつに分解
-        std::vector<MString> split_piece_str(const MString& s) const;
-
-        MString convertoToKatakanaIfAny(const MString& str, bool bKatakana) const;
+        MString convertoToKatakanaIfAny(MStringView str, bool bKatakana) const;
 
         // グローバルな後置書き換えを適用する
-        MString applyGlobalPostRewrite(const MString& adder) const;
+        MString applyGlobalPostRewrite(MStringView adder) const;
 
     public:
         CandidateString() {
@@ -46,22 +122,38 @@ namespace lattice2 {
             : _str(s), _strokeLen(len) {
         }
 
+        CandidateString(MString&& s, int len)
+            : _str(std::move(s)), _strokeLen(len) {
+        }
+
         CandidateString(const MString& s, int len, const MString& mazeFeat)
             : _str(s), _strokeLen(len), _mazeFeat(mazeFeat) {
         }
 
-        CandidateString(const CandidateString& cand)
-            : _str(cand._str), _strokeLen(cand._strokeLen), _morphCost(cand._morphCost), _ngramCost(cand._ngramCost),
-              _penalty(cand._penalty), _paddingDerived(cand._paddingDerived), _isNonTerminal(cand._isNonTerminal), _prefType(cand._prefType), _mazeFeat(cand._mazeFeat) {
+        CandidateString(MString&& s, int len, MString&& mazeFeat)
+            : _str(std::move(s)), _strokeLen(len), _mazeFeat(std::move(mazeFeat)) {
         }
 
+        // 文字列 s に、接続元の候補 parent の交ぜ書き素性を引き継いだ候補 (素性はコピーせずに共有する)
+        CandidateString(MString&& s, int len, const CandidateString& parent)
+            : _str(std::move(s)), _strokeLen(len), _mazeFeat(parent._mazeFeat) {
+        }
+
+        CandidateString(const CandidateString& cand) = default;
+
+        CandidateString(CandidateString&& cand) = default;
+
+        CandidateString& operator=(const CandidateString& cand) = default;
+
+        CandidateString& operator=(CandidateString&& cand) = default;
+
         CandidateString(const CandidateString& cand, int strokeDelta)
             : _str(cand._str), _strokeLen(cand._strokeLen + strokeDelta), _morphCost(cand._morphCost), _ngramCost(cand._ngramCost),
               _penalty(cand._penalty), _paddingDerived(cand._paddingDerived), _prefType(cand._prefType), _mazeFeat(cand._mazeFeat) {
         }
 
         // 自動部首合成の実行
-        std::tuple<MString, int> applyAutoBushu(const WordPiece& piece, int strokeCount) const;
+        std::tuple<MString, int> applyAutoBushu(const WordPiece& piece, int strokeCount, AutoBushuMemo& memo) const;
 
         // 部首合成の実行
         MString applyBushuComp() const;
@@ -77,11 +169,26 @@ namespace lattice2 {
         std::vector<MString> applyPiece(const WordPiece& piece, int strokeCount, int paddingLen, bool isStrokeBS, bool bKatakanaConversion) const;
 
         inline const MString& string() const {
-            return _str;
+            return _str.str();
+        }
+
+        // 文字列のハッシュ値 (構築時に計算済み)
+        inline size_t stringHash() const {
+            return _str.hash();
+        }
+
+        // 同じ文字列を持つ候補か
+        inline bool hasSameString(const CandidateString& other) const {
+            return _str.equals(other._str);
+        }
+
+        // 文字列 s と同じか (h は SharedMString::hashOf(s) で求めておくこと)
+        inline bool hasSameString(const MString& s, size_t h) const {
+            return _str.equals(s, h);
         }
 
         inline const mchar_t tailChar() const {
-            return _str.empty() ? 0 : _str.back();
+            return string().empty() ? 0 : string().back();
         }
 
         inline const bool isKanjiTailChar() const {
@@ -101,6 +208,14 @@ namespace lattice2 {
             return _morphCost + _ngramCost + _penalty;
         }
 
+        inline int morphCost() const {
+            return _morphCost;
+        }
+
+        inline int ngramCost() const {
+            return _ngramCost;
+        }
+
         inline void addCost(int morphCost, int ngramCost) {
             _morphCost += morphCost;
             _ngramCost += ngramCost;
@@ -168,7 +283,7 @@ namespace lattice2 {
         }
 
         inline const MString& mazeFeat() const {
-            return _mazeFeat;
+            return _mazeFeat.str();
         }
 
         //inline float llama_loss() const {
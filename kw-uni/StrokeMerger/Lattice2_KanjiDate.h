@@ -0,0 +1,93 @@
+#pragma once
+
+// 漢数字による日付パターンの判定
+// - 以前の std::wregex による判定と同じ結果になることを kanji-date-test で確かめているので、標準ライブラリだけに依存させる
+
+#include <cstdint>
+
+#include "string_type.h"
+
+namespace lattice2 {
+    // 漢数字による日付パターンの DFA
+    // 以前の正規表現でいえば、下記にマッチする
+    //   [一二三四五六七八九十〇](年[一二三四五六七八九十〇]+月([一二三四五六七八九十〇]+日)?|月[一二三四五六七八九十〇]+日|[一二三四五六七八九十〇]日)
+    // (各選択肢は2文字目で決まり、省略可能な「〇日」は取れれば取るので、最長一致がそのまま正規表現のマッチと一致する)
+    namespace kanji_date {
+        enum CharClass { C_NUM, C_NEN, C_GATSU, C_NICHI, C_OTHER, NUM_CHAR_CLASSES };
+
+        inline CharClass charClassOf(mchar_t ch) {
+            switch (ch) {
+            case L'一': case L'二': case L'三': case L'四': case L'五':
+            case L'六': case L'七': case L'八': case L'九': case L'十': case L'〇':
+                return C_NUM;
+            case L'年': return C_NEN;
+            case L'月': return C_GATSU;
+            case L'日': return C_NICHI;
+            default: return C_OTHER;
+            }
+        }
+
+        enum State {
+            S_DEAD,
+            S_START,
+            S_NUM,          // 〇
+            S_NEN,          // 〇年
+            S_NEN_NUM,      // 〇年〇+
+            S_NEN_GATSU,    // 〇年〇+月 (受理)
+            S_NEN_GATSU_NUM,// 〇年〇+月〇+
+            S_GATSU,        // 〇月
+            S_GATSU_NUM,    // 〇月〇+
+            S_NUM_NUM,      // 〇〇
+            S_DONE,         // 〇年〇+月〇+日, 〇月〇+日, 〇〇日 (受理; これ以上は伸びない)
+            NUM_STATES
+        };
+
+        // 状態遷移表 [状態][文字種]
+        constexpr uint8_t transitions[NUM_STATES][NUM_CHAR_CLASSES] = {
+            //             NUM              NEN         GATSU          NICHI        OTHER
+            /* DEAD   */ { S_DEAD,          S_DEAD,     S_DEAD,        S_DEAD,      S_DEAD },
+            /* START  */ { S_NUM,           S_DEAD,     S_DEAD,        S_DEAD,      S_DEAD },
+            /* NUM    */ { S_NUM_NUM,       S_NEN,      S_GATSU,       S_DEAD,      S_DEAD },
+            /* NEN    */ { S_NEN_NUM,       S_DEAD,     S_DEAD,        S_DEAD,      S_DEAD },
+            /* NEN_N  */ { S_NEN_NUM,       S_DEAD,     S_NEN_GATSU,   S_DEAD,      S_DEAD },
+            /* NEN_G  */ { S_NEN_GATSU_NUM, S_DEAD,     S_DEAD,        S_DEAD,      S_DEAD },
+            /* NEN_G_N*/ { S_NEN_GATSU_NUM, S_DEAD,     S_DEAD,        S_DONE,      S_DEAD },
+            /* GATSU  */ { S_GATSU_NUM,     S_DEAD,     S_DEAD,        S_DEAD,      S_DEAD },
+            /* GATSU_N*/ { S_GATSU_NUM,     S_DEAD,     S_DEAD,        S_DONE,      S_DEAD },
+            /* NUM_NUM*/ { S_DEAD,          S_DEAD,     S_DEAD,        S_DONE,      S_DEAD },
+            /* DONE   */ { S_DEAD,          S_DEAD,     S_DEAD,        S_DEAD,      S_DEAD },
+        };
+
+        inline bool isAccepting(int state) {
+            return state == S_NEN_GATSU || state == S_DONE;
+        }
+
+        // str の start から始まる日付パターンの長さを返す (マッチしなければ 0)
+        inline size_t matchLenAt(const MString& str, size_t start) {
+            int state = S_START;
+            size_t matchedLen = 0;
+            for (size_t i = start; i < str.size(); ++i) {
+                state = transitions[state][charClassOf(str[i])];
+                if (state == S_DEAD) break;
+                if (isAccepting(state)) matchedLen = i + 1 - start;
+            }
+            return matchedLen;
+        }
+    }
+
+    // str 全体が日付パターンか
+    inline bool isKanjiDateTime(const MString& str) {
+        return !str.empty() && kanji_date::matchLenAt(str, 0) == str.size();
+    }
+
+    // pos 以降で最初に見つかった日付パターンの長さを返す (pos の文字が漢数字でなければ 0)
+    inline size_t datePatternMatchedLen(const MString& str, size_t pos) {
+        if (pos < str.size() && kanji_date::charClassOf(str[pos]) == kanji_date::C_NUM) {
+            for (size_t start = pos; start < str.size(); ++start) {
+                size_t len = kanji_date::matchLenAt(str, start);
+                if (len > 0) return len;
+            }
+        }
+        return 0;
+    }
+}
@@ -1,12 +1,14 @@
 #include "Logger.h"
-#include "settings.h"
+#include "Settings.h"
 #include "StateCommonInfo.h"
 
 #include "Llama/LlamaBridge.h"
+#include "flat_hash_map.h"
 
 #include "Lattice.h"
 #include "Lattice2_Common.h"
 #include "Lattice2_CandidateString.h"
+#include "Lattice2_CandidateLog.h"
 #include "Lattice2_Kbest.h"
 #include "Lattice2_Ngram.h"
 #include "Lattice2_Morpher.h"
@@ -143,6 +145,35 @@ namespace lattice2 {
         }
     }
 
+    // mchar_t を 21ビットに詰める (BMP の文字はそのまま、サロゲートペアはコードポイントにする)
+    // 21ビットに収まらないもの (ASCII ペアなど) は 0 を返す
+    inline uint64_t packMcharTo21bits(mchar_t ch) {
+        if (ch <= 0xffff) return ch;
+        mchar_t hi = ch >> 16;
+        mchar_t lo = ch & 0xffff;
+        if (hi >= 0xd800 && hi <= 0xdbff && lo >= 0xdc00 && lo <= 0xdfff) {
+            return 0x10000 + ((uint64_t)(hi - 0xd800) << 10) + (lo - 0xdc00);
+        }
+        return 0;
+    }
+
+    // 末尾 n 文字 (n <= 3) を1つの整数に詰める (str が n 文字未満なら 0 を返す)
+    // 各文字を21ビットに詰めて並べる。詰められない文字を含む場合は、最上位ビットを立てたハッシュ値で代用する
+    // (その場合に衝突しても、末尾の多様性の判定がわずかに甘くなるだけ)
+    inline uint64_t packTailNgram(const MString& str, size_t n) {
+        if (n == 0 || str.size() < n) return 0;
+        uint64_t key = 0;
+        uint64_t hash = 0;
+        bool packable = true;
+        for (size_t i = str.size() - n; i < str.size(); ++i) {
+            uint64_t code = packMcharTo21bits(str[i]);
+            if (code == 0) packable = false;
+            key = (key << 21) | code;
+            hash = (hash ^ str[i]) * 0x100000001B3ULL;
+        }
+        return packable ? key : (hash | 0x8000000000000000ULL);
+    }
+
     inline MString removeLastSpace(const MString& str) {
         MString result = str;
         auto pos = result.find_last_of(' ');
@@ -177,7 +208,8 @@ namespace lattice2 {
             return cands.empty() || (cands.front().string().empty());
         }
 
-        String _debugLog;
+        // 解候補ログ (無効なら nullptr)
+        CandidateLog* _candidateLog = nullptr;
 
     public:
         // コンストラクター
@@ -194,6 +226,43 @@ namespace lattice2 {
         std::vector<MString> _topCandidateHistory;
         MString _fixedLeaderPrefix;
 
+        // 自動部首合成の打鍵ごとのメモ
+        AutoBushuMemo _autoBushuMemo;
+
+        // reorderCandidates の作業領域 (打鍵ごとに使い回して、メモリ確保を避ける)
+        struct ReorderWork {
+            // 見つかった選択Ngramペア (文字列は選択Ngramの表の要素を参照する)
+            struct FoundPair {
+                const MString* ngramPair;
+                MStringView positiveNgram;
+                MStringView negativeNgram;
+                int bonusPoint = 0;
+                bool hasPositive = false;
+                bool hasNegative = false;
+                bool suppressed = false;
+            };
+            // どの候補に、どのペアの正負どちら側が含まれていたか
+            struct Hit {
+                uint32_t pairIndex;
+                uint32_t candIndex;
+                bool positive;
+
+                auto operator<=>(const Hit&) const = default;
+            };
+
+            std::vector<const SelectedNgramPairBonus*> pairBonuses;
+            std::vector<FoundPair> pairs;
+            std::vector<Hit> hits;
+            std::vector<std::pair<int, uint32_t>> sortKeys;     // (totalCost, 元の位置)
+            std::vector<uint32_t> order;
+        };
+        ReorderWork _reorderWork;
+
+        // truncateTailCandidates で採用した候補の末尾 1~3gram (packTailNgram で詰めたもの; 呼び出しごとに使い回す)
+        utils::FlatHashMap<uint64_t, bool> _tailUniGrams;
+        utils::FlatHashMap<uint64_t, bool> _tailBiGrams;
+        utils::FlatHashMap<uint64_t, bool> _tailTriGrams;
+
         //void setHighFreqJoshiStroke(int count, mchar_t ch) {
         //    if (count >= 0 && count < 1024) {
         //        if (count >= (int)_highFreqJoshiStroke.size()) {
@@ -306,17 +375,25 @@ namespace lattice2 {
             if (_fixedLeaderPrefix.empty() || _candidates.size() <= 1) return;
 
             int topStrokeLen = _candidates.front().strokeLen();
+            // 先頭と同じストローク長の候補だけを対象とし、残すものを前に詰めていく (順序は保つ)
+            size_t out = 1;
             size_t idx = 1;
-            while (idx < _candidates.size()) {
-                if (_candidates[idx].strokeLen() < topStrokeLen) {
+            for (; idx < _candidates.size(); ++idx) {
+                auto& cand = _candidates[idx];
+                if (cand.strokeLen() < topStrokeLen) {
                     // これより後は、ストローク長が短い候補しかないので、ループを抜ける
                     break;
-                } else if (!utils::startsWith(_candidates[idx].string(), _fixedLeaderPrefix)) {
-                    _LOG_DETAIL(L"erase by fixed leader prefix: prefix={}, cand={}", to_wstr(_fixedLeaderPrefix), _candidates[idx].debugString());
-                    _candidates.erase(_candidates.begin() + idx);
-                } else {
-                    ++idx;
                 }
+                if (!utils::startsWith(cand.string(), _fixedLeaderPrefix)) {
+                    _LOG_DETAIL(L"erase by fixed leader prefix: prefix={}, cand={}", to_wstr(_fixedLeaderPrefix), cand.debugString());
+                    continue;
+                }
+                if (out != idx) _candidates[out] = std::move(cand);
+                ++out;
+            }
+            if (out != idx) {
+                // 詰めた後の隙間を、ストローク長が短い候補ごと1回で前に寄せる
+                _candidates.erase(_candidates.begin() + out, _candidates.begin() + idx);
             }
         }
 
@@ -369,17 +446,19 @@ namespace lattice2 {
         void removeOtherThanFirst() override {
             _LOG_DETAIL(L"ENTER");
             if (_candidates.size() > 0) {
-                std::vector<CandidateString> filtered;
-                filtered.reserve(_candidates.size());
+                // 各ストローク長の最初の候補だけを、順序を保って前に詰める
+                size_t out = 0;
                 int prevStrokeLen = INT_MIN;
-                for (auto cand : _candidates) {
+                for (size_t idx = 0; idx < _candidates.size(); ++idx) {
+                    auto& cand = _candidates[idx];
                     if (cand.strokeLen() != prevStrokeLen) {
-                        cand.clean();
-                        filtered.push_back(cand);
                         prevStrokeLen = cand.strokeLen();
+                        cand.clean();
+                        if (out != idx) _candidates[out] = std::move(cand);
+                        ++out;
                     }
                 }
-                _candidates = std::move(filtered);
+                _candidates.erase(_candidates.begin() + out, _candidates.end());
             }
             _LOG_DETAIL(L"LEAVE");
         }
@@ -388,15 +467,17 @@ namespace lattice2 {
             _LOG_DETAIL(L"ENTER");
             if (_candidates.size() > 0) {
                 const MString& first = _candidates[0].string();
-                size_t n = 1;
-                while (n < _candidates.size()) {
-                    if (!utils::startsWith(first, _candidates[n].string())) {
-                        _candidates.erase(_candidates.begin() + n);
-                    } else {
-                        _candidates[n].clean();
-                        ++n;
+                // 先頭候補の前方部分になっている候補だけを、順序を保って前に詰める
+                size_t out = 1;
+                for (size_t n = 1; n < _candidates.size(); ++n) {
+                    auto& cand = _candidates[n];
+                    if (utils::startsWith(first, cand.string())) {
+                        cand.clean();
+                        if (out != n) _candidates[out] = std::move(cand);
+                        ++out;
                     }
                 }
+                _candidates.erase(_candidates.begin() + out, _candidates.end());
             }
             _LOG_DETAIL(L"LEAVE");
         }
@@ -408,6 +489,7 @@ namespace lattice2 {
                 size_t n = 0;
                 while (n < _candidates.size()) {
                     if (_candidates[n].strokeLen() < topLen) break;
+                    ++n;
                 }
                 if (n < _candidates.size()) {
                     _candidates.erase(_candidates.begin() + n, _candidates.end());
@@ -583,9 +665,16 @@ namespace lattice2 {
             return result;
         }
 
+        void setCandidateLog(CandidateLog* candidateLog) override {
+            _candidateLog = candidateLog;
+        }
+
+        void recordCandidates(CandidateLog& candidateLog, size_t maxLn) const override {
+            candidateLog.addKBest(_candidates, maxLn);
+        }
+
         String debugKBestString(size_t maxLn = 10000) const override {
             String result;
-            result.append(_debugLog);
             result.append(std::format(L"\nTotal candidates={}\n", _candidates.size()));
             result.append(L"\nKBest:\n");
             result.append(debugCandidates(maxLn));
@@ -693,9 +782,8 @@ namespace lattice2 {
                 _LOG_DETAIL(_T("CALC: candStr={}, myTotalCost={}, candCost={} (morph={}[<{}>], ngram={})"),
                     to_wstr(candStr), myTotalCost, candCost, morphCost, utils::reReplace(to_wstr(utils::join(morphs, to_mstr(L"> <"))), L"\t", L" "), ngramCost);
 
-                if (WORD_LATTICE->isCandidateLogEnabled()) {
-                    if (!isStrokeBS) _debugLog.append(std::format(L"candStr={}, myTotalCost={}, candCost={} (morph={} [<{}>] , ngram = {})\n",
-                        to_wstr(candStr), myTotalCost, candCost, morphCost, utils::reReplace(to_wstr(utils::join(morphs, to_mstr(L"> <"))), L"\t", L" "), ngramCost));
+                if (_candidateLog && !isStrokeBS) {
+                    _candidateLog->addCandidateCost(candStr, myTotalCost, candCost, morphCost, ngramCost, morphs);
                 }
             }
 
@@ -766,125 +854,124 @@ namespace lattice2 {
         }
 
         // SelectedNgramPairBonus の "positive|negative" 形式を分解する
-        std::pair<MString, MString> splitSelectedNgramPair(const MString& ngramPair) {
+        // "positive|negative" 形式の選択Ngramペアを分割する (分割できなければ両方とも空)
+        std::pair<MStringView, MStringView> splitSelectedNgramPair(const MString& ngramPair) {
             auto pos = ngramPair.find('|');
             if (pos == MString::npos) return {};
-            return {
-                utils::safe_substr(ngramPair, 0, pos),
-                utils::safe_substr(ngramPair, pos + 1)
-            };
+            MStringView view(ngramPair);
+            return { view.substr(0, pos), view.substr(pos + 1) };
         }
 
         // 正負の両側が包含されているときだけ、短い pair を包含対象とみなす
         bool isContainedSelectedNgramPair(
-            const std::pair<MString, MString>& current,
-            const std::pair<MString, MString>& other) {
+            const std::pair<MStringView, MStringView>& current,
+            const std::pair<MStringView, MStringView>& other) {
             if (current.first.empty() || current.second.empty() || other.first.empty() || other.second.empty()) {
                 return false;
             }
-            if (other.first.find(current.first) == MString::npos || other.second.find(current.second) == MString::npos) {
+            if (other.first.find(current.first) == MStringView::npos || other.second.find(current.second) == MStringView::npos) {
                 return false;
             }
             return current.first != other.first || current.second != other.second;
         }
 
         // ユーザーによるNgram選択をtotalCostに反映して、候補の順序を totalCost の昇順にソート
+        // 作業用の配列はすべて _reorderWork のものを使い回し、候補文字列そのものは並べ替えの最後に1度だけ移動する
         void reorderCandidates(std::vector<CandidateString>& newCandidates, std::vector<bool>& promotedFlags) {
             // CandidateString::totalCost() の昇順にソート
             _LOG_DETAIL(_T("ENTER: newCandidates:\n{}"), debugString(newCandidates));
             // ユーザー選択Ngramペアを探して、totalCostを調整
-            struct FoundNgramInfo {
-                int bonusPoint = 0;
-                std::set<size_t> positiveCandidateIndexes;
-                std::set<size_t> negativeCandidateIndexes;
-                MString positiveNgram;
-                MString negativeNgram;
-            };
-
-            std::map<MString, FoundNgramInfo> foundNgram;   // <Ngram, <bonusPoint, positiveCandidateIndexes, negativeCandidateIndexes, positiveNgram, negativeNgram>>
+            auto& work = _reorderWork;
+            work.pairs.clear();
+            work.hits.clear();
             for (size_t i = 0; i < newCandidates.size(); ++i) {
                 _LOG_DETAIL(_T("cand[{}]={}"), i, newCandidates[i].debugString());
-                const MString& candStr = newCandidates[i].string();
-                for (const auto& current : findNgramPairBonus(candStr)) {
-                    if (!current.isValid(SETTINGS->hiraganaBigramEnabled)) continue;
+                work.pairBonuses.clear();
+                findNgramPairBonus(newCandidates[i].string(), work.pairBonuses);
+                for (const SelectedNgramPairBonus* pBonus : work.pairBonuses) {
+                    const auto& current = *pBonus;
+                    if (current.bonusPoint == 0 || !current.isValid(SETTINGS->hiraganaBigramEnabled)) continue;
 
                     auto [positiveNgram, negativeNgram] = splitSelectedNgramPair(current.ngramPair);
                     if (positiveNgram.empty() || negativeNgram.empty()) continue;
 
-                    auto& info = foundNgram[current.ngramPair];
-                    if (info.positiveNgram.empty() && info.negativeNgram.empty()) {
-                        info.bonusPoint = current.bonusPoint > 0 ? current.bonusPoint : -current.bonusPoint;
-                        info.positiveNgram = positiveNgram;
-                        info.negativeNgram = negativeNgram;
+                    // 同じペアは正負どちら側から見つかっても同じエントリにまとめる (見つかるペアは少ないので線形探索)
+                    size_t pi = 0;
+                    while (pi < work.pairs.size() && *work.pairs[pi].ngramPair != current.ngramPair) ++pi;
+                    if (pi == work.pairs.size()) {
+                        work.pairs.push_back(ReorderWork::FoundPair{ &current.ngramPair, positiveNgram, negativeNgram,
+                            current.bonusPoint > 0 ? current.bonusPoint : -current.bonusPoint });
                     }
-
+                    auto& found = work.pairs[pi];
                     if (current.bonusPoint > 0) {
                         _LOG_DETAIL(_T("positive bonus info: [{}] {}"), i, current.debugString());
-                        info.positiveCandidateIndexes.insert(i);
-                    } else if (current.bonusPoint < 0) {
+                        found.hasPositive = true;
+                    } else {
                         _LOG_DETAIL(_T("negative bonus info: [{}] {}"), i, current.debugString());
-                        info.negativeCandidateIndexes.insert(i);
+                        found.hasNegative = true;
                     }
+                    work.hits.push_back(ReorderWork::Hit{ (uint32_t)pi, (uint32_t)i, current.bonusPoint > 0 });
                 }
             }
 
             // totalCost を再計算
-            std::set<MString> suppressedNgramPairs;
-            for (const auto& entry : foundNgram) {
-                const auto& currentInfo = entry.second;
-                // pair の片側だけが見つかった段階では仮採用のまま保持し、両側が揃ったものだけを suppress 判定対象にする
-                if (currentInfo.positiveCandidateIndexes.empty() || currentInfo.negativeCandidateIndexes.empty()) continue;
-
-                for (const auto& otherEntry : foundNgram) {
-                    if (entry.first == otherEntry.first) continue;
-                    const auto& otherInfo = otherEntry.second;
-                    if (otherInfo.positiveCandidateIndexes.empty() || otherInfo.negativeCandidateIndexes.empty()) continue;
-                    if (isContainedSelectedNgramPair(
-                        { currentInfo.positiveNgram, currentInfo.negativeNgram },
-                        { otherInfo.positiveNgram, otherInfo.negativeNgram })) {
-                        suppressedNgramPairs.insert(entry.first);
+            // pair の片側だけが見つかった段階では仮採用のまま保持し、両側が揃ったものだけを suppress 判定対象にする
+            for (auto& current : work.pairs) {
+                if (!current.hasPositive || !current.hasNegative) continue;
+                for (const auto& other : work.pairs) {
+                    if (&other == &current || !other.hasPositive || !other.hasNegative) continue;
+                    if (isContainedSelectedNgramPair({ current.positiveNgram, current.negativeNgram }, { other.positiveNgram, other.negativeNgram })) {
+                        current.suppressed = true;
                         _LOG_DETAIL(_T("suppress contained selected NgramPair: excluded={}, covering={}"),
-                            SelectedNgramPairBonus{ entry.first, currentInfo.bonusPoint }.debugString(),
-                            SelectedNgramPairBonus{ otherEntry.first, otherInfo.bonusPoint }.debugString());
+                            SelectedNgramPairBonus{ *current.ngramPair, current.bonusPoint }.debugString(),
+                            SelectedNgramPairBonus{ *other.ngramPair, other.bonusPoint }.debugString());
                         break;
                     }
                 }
             }
 
-            for (const auto& entry : foundNgram) {
-                // 集約後に正式採用された pair だけに bonus を反映する
-                if (suppressedNgramPairs.contains(entry.first)) continue;
-
-                const auto& bonusInfo = entry.second;
-                int bonus = calcNgramBonus(bonusInfo.bonusPoint);
-                const auto& posiCandIndex = bonusInfo.positiveCandidateIndexes;
-                const auto& negaCandIndex = bonusInfo.negativeCandidateIndexes;
-                if (bonus > 0 && !posiCandIndex.empty() && !negaCandIndex.empty()) {
-                    for (const auto& ci : posiCandIndex) {
-                        newCandidates[ci].addNgramCost(-bonus);
-                        _LOG_DETAIL(_T("positive selected Ngram: {}, bonus={}, cand=[{}] {}"), to_wstr(entry.first), bonus, ci, newCandidates[ci].debugString());
-                    }
-                    for (const auto& ci : negaCandIndex) {
-                        newCandidates[ci].addNgramCost(bonus);
-                        _LOG_DETAIL(_T("negative selected Ngram: {}, bonus={}, cand=[{}] {}"), to_wstr(entry.first), bonus, ci, newCandidates[ci].debugString());
+            // 集約後に正式採用された pair だけに bonus を反映する
+            // (同じ候補に同じペアが重複して見つかっていても1度しか反映しないように、ヒットを整列して重複を除く)
+            std::sort(work.hits.begin(), work.hits.end());
+            work.hits.erase(std::unique(work.hits.begin(), work.hits.end()), work.hits.end());
+            for (const auto& hit : work.hits) {
+                const auto& found = work.pairs[hit.pairIndex];
+                if (found.suppressed || !found.hasPositive || !found.hasNegative) continue;
+                int bonus = calcNgramBonus(found.bonusPoint);
+                if (bonus <= 0) continue;
+                auto& cand = newCandidates[hit.candIndex];
+                cand.addNgramCost(hit.positive ? -bonus : bonus);
+                _LOG_DETAIL(_T("{} selected Ngram: {}, bonus={}, cand=[{}] {}"),
+                    hit.positive ? _T("positive") : _T("negative"), to_wstr(*found.ngramPair), bonus, hit.candIndex, cand.debugString());
+            }
+
+            // 調整された totalCost に基づいてソート (コストが等しければ元の順序を保つ)
+            // (totalCost, 元の位置) のキーを整列してから、その置換を巡回ごとに適用する
+            size_t nCands = newCandidates.size();
+            work.sortKeys.clear();
+            for (size_t i = 0; i < nCands; ++i) {
+                work.sortKeys.emplace_back(newCandidates[i].totalCost(), (uint32_t)i);
+            }
+            std::sort(work.sortKeys.begin(), work.sortKeys.end());
+            work.order.clear();
+            for (const auto& key : work.sortKeys) work.order.push_back(key.second);
+            for (size_t i = 0; i < nCands; ++i) {
+                if (work.order[i] == i) continue;
+                // 位置 i から始まる巡回: 位置 j には元の位置 order[j] の候補が入る
+                CandidateString tmpCand = std::move(newCandidates[i]);
+                bool tmpFlag = i < promotedFlags.size() ? promotedFlags[i] : false;
+                size_t j = i;
+                while (true) {
+                    size_t k = work.order[j];
+                    work.order[j] = (uint32_t)j;
+                    if (k == i) {
+                        newCandidates[j] = std::move(tmpCand);
+                        if (j < promotedFlags.size()) promotedFlags[j] = tmpFlag;
+                        break;
                     }
-                }
-            }
-
-            // 調整された totalCost に基づいてソート
-            std::vector<std::pair<CandidateString, bool>> zippedCandidates;
-            zippedCandidates.reserve(newCandidates.size());
-            for (size_t i = 0; i < newCandidates.size(); ++i) {
-                zippedCandidates.emplace_back(newCandidates[i], i < promotedFlags.size() ? promotedFlags[i] : false);
-            }
-            std::sort(zippedCandidates.begin(), zippedCandidates.end(),
-                [](const auto& a, const auto& b) {
-                    return a.first.totalCost() < b.first.totalCost();
-                });
-            for (size_t i = 0; i < zippedCandidates.size(); ++i) {
-                newCandidates[i] = std::move(zippedCandidates[i].first);
-                if (i < promotedFlags.size()) {
-                    promotedFlags[i] = zippedCandidates[i].second;
+                    newCandidates[j] = std::move(newCandidates[k]);
+                    if (j < promotedFlags.size()) promotedFlags[j] = k < promotedFlags.size() ? promotedFlags[k] : false;
+                    j = k;
                 }
             }
             _LOG_DETAIL(_T("LEAVE"));
@@ -895,6 +982,26 @@ namespace lattice2 {
             _LOG_DETAIL(_T("ENTER: newCandidates.size={}, promotedFlags.size={}"), newCandidates.size(), promotedFlags.size());
             if (newCandidates.size() <= 1 || promotedFlags.size() != newCandidates.size()) return;
 
+            CandidateString firstCand = newCandidates.front();
+            bool firstMark = promotedFlags.front();
+            const MString& topStr = firstCand.string();
+
+            // 先頭候補と末尾が近すぎるものは前寄せせず、通常のコスト順に任せる (とりあえず4文字以上違うものだけを前寄せの対象とする)
+            // (前寄せするものが無ければ、候補を移動する前に抜ける)
+            std::vector<bool> toPromote(newCandidates.size(), false);
+            bool anyPromoted = false;
+            for (size_t i = 1; i < newCandidates.size(); ++i) {
+                if (promotedFlags[i] && calcTailDifferenceLen(topStr, newCandidates[i].string()) >= tailDiffLenForPromotion) {
+                    toPromote[i] = true;
+                    anyPromoted = true;
+                }
+            }
+
+            if (!anyPromoted) {
+                _LOG_DETAIL(_T("LEAVE: no representative candidates"));
+                return;
+            }
+
             std::vector<CandidateString> promoted;
             std::vector<bool> promotedMarks;
             std::vector<CandidateString> others;
@@ -902,13 +1009,8 @@ namespace lattice2 {
             promoted.reserve(newCandidates.size());
             others.reserve(newCandidates.size());
 
-            CandidateString firstCand = newCandidates.front();
-            bool firstMark = promotedFlags.front();
-            const MString& topStr = firstCand.string();
-
             for (size_t i = 1; i < newCandidates.size(); ++i) {
-                // 先頭候補と末尾が近すぎるものは前寄せせず、通常のコスト順に任せる (とりあえず4文字以上違うものだけを前寄せの対象とする)
-                if (promotedFlags[i] && calcTailDifferenceLen(topStr, newCandidates[i].string()) >= tailDiffLenForPromotion) {
+                if (toPromote[i]) {
                     promoted.push_back(std::move(newCandidates[i]));
                     promotedMarks.push_back(true);
                 } else {
@@ -917,11 +1019,6 @@ namespace lattice2 {
                 }
             }
 
-            if (promoted.empty()) {
-                _LOG_DETAIL(_T("LEAVE: no representative candidates"));
-                return;
-            }
-
             // 先頭候補はそのまま残し、その直後へ代表候補群を安定挿入する
             newCandidates.clear();
             promotedFlags.clear();
@@ -965,9 +1062,12 @@ namespace lattice2 {
         // Padding piece を含まない候補が見つかったら、Padding piece を含む候補は削除する
         void truncateTailCandidates(std::vector<CandidateString>& newCandidates, std::vector<bool>& promotedFlags) {
             _LOG_DETAIL(_T("ENTER: newCandidates.size={}, beamSieze={}, extraBeamSizeRate={}"), newCandidates.size(), SETTINGS->multiStreamBeamSize, SETTINGS->extraBeamSizeRate);
-            std::set<MString> triGrams;
-            std::set<MString> biGrams;
-            std::set<MString> uniGrams;
+            auto& uniGrams = _tailUniGrams;
+            auto& biGrams = _tailBiGrams;
+            auto& triGrams = _tailTriGrams;
+            uniGrams.clearKeepingCapacity();
+            biGrams.clearKeepingCapacity();
+            triGrams.clearKeepingCapacity();
             const size_t beamSize = SETTINGS->multiStreamBeamSize;
             const size_t beamSize2 = beamSize + (int)(beamSize * SETTINGS->extraBeamSizeRate);
             size_t candCount = 0;
@@ -985,25 +1085,26 @@ namespace lattice2 {
                     auto iter = newCandidates.begin() + candCount;
                     bool isPromoted = candCount < promotedFlags.size() ? promotedFlags[candCount] : false;
                     const MString& str = iter->string();
-                    const MString uni = str.size() >= 1 ? utils::safe_tailstr(str, 1) : EMPTY_MSTR;
-                    const MString bi = str.size() >= 2 ? utils::safe_tailstr(str, 2) : EMPTY_MSTR;
-                    const MString tri = str.size() >= 3 ? utils::safe_tailstr(str, 3) : EMPTY_MSTR;
+                    // 末尾の 1~3gram (文字数が足りなければ 0)
+                    const uint64_t uni = packTailNgram(str, 1);
+                    const uint64_t bi = packTailNgram(str, 2);
+                    const uint64_t tri = packTailNgram(str, 3);
                     if (topHead.size() == 0 || utils::startsWith(str, topHead)) {
                         // Padding piece を含まない候補(「燃」など)が見つかったら、Padding piece を含む候補は削除する
                         if (!bNonPaddingFound || !iter->isPaddingDerived()) {
                             if (isPromoted && pickCount < beamSize2) {
-                                if (!uni.empty()) uniGrams.insert(uni);
-                                if (!bi.empty()) biGrams.insert(bi);
-                                if (!tri.empty()) triGrams.insert(tri);
+                                if (uni) uniGrams.insert(uni, true);
+                                if (bi) biGrams.insert(bi, true);
+                                if (tri) triGrams.insert(tri, true);
                                 _LOG_DETAIL(_T("[{}] PICK: {}: representative"), candCount, iter->debugString());
                                 ++candCount;
                                 ++pickCount;
                                 continue;
                             }
                             if (candCount < beamSize) {
-                                if (!uni.empty()) uniGrams.insert(uni);
-                                if (!bi.empty()) biGrams.insert(bi);
-                                if (!tri.empty()) triGrams.insert(tri);
+                                if (uni) uniGrams.insert(uni, true);
+                                if (bi) biGrams.insert(bi, true);
+                                if (tri) triGrams.insert(tri, true);
                                 _LOG_DETAIL(_T("[{}] PICK: {}: OK"), candCount, iter->debugString());
                                 ++candCount;
                                 ++pickCount;
@@ -1011,9 +1112,7 @@ namespace lattice2 {
                             } else {
                                 if (IS_LOG_DEBUGH_ENABLED && candCount == beamSize) {
                                     _LOG_DETAIL(_T("count reached at beamSize={}, beamSize2={}"), beamSize, beamSize2);
-                                    _LOG_DETAIL(_T("tail 1grams={}"), to_wstr(utils::join(uniGrams, ',')));
-                                    _LOG_DETAIL(_T("tail 2gams={}"), to_wstr(utils::join(biGrams, ',')));
-                                    _LOG_DETAIL(_T("tail 3grams={}"), to_wstr(utils::join(triGrams, ',')));
+                                    _LOG_DETAIL(_T("tail 1grams={}, 2grams={}, 3grams={}"), uniGrams.size(), biGrams.size(), triGrams.size());
                                 }
                                 if (iter->isNonTerminal()) {
                                     if (nonTerminalPickCount < extraLimit) {
@@ -1025,11 +1124,11 @@ namespace lattice2 {
                                     }
                                     _LOG_DETAIL(_T("[{}]: SKIP: {}: non terminal limit reached({}/{})"), candCount, iter->debugString(), nonTerminalPickCount, extraLimit);
                                 }
-                                if (!uni.empty() && uniGrams.find(uni) == uniGrams.end()) {
+                                if (uni && !uniGrams.contains(uni)) {
                                     if (unigramPickCount < extraLimit) {
                                         // 未見のunigramは通常 beam とは別枠で一定数だけ残す
-                                        uniGrams.insert(uni);
-                                        _LOG_DETAIL(_T("[{}] PICK: {}: uniGram({}) OK, uniGrams.size={}/{}"), candCount, iter->debugString(), to_wstr(uni), uniGrams.size(), extraLimit);
+                                        uniGrams.insert(uni, true);
+                                        _LOG_DETAIL(_T("[{}] PICK: {}: uniGram({}) OK, uniGrams.size={}/{}"), candCount, iter->debugString(), to_wstr(utils::safe_tailstr(str, 1)), uniGrams.size(), extraLimit);
                                         ++candCount;
                                         ++unigramPickCount;
                                         continue;
@@ -1038,18 +1137,18 @@ namespace lattice2 {
                                 }
                                 if (pickCount < beamSize2) {
                                     // まだ余裕がある
-                                    if (!tri.empty() && triGrams.find(tri) == triGrams.end()) {
+                                    if (tri && !triGrams.contains(tri)) {
                                         // 未見のtrigramであり、まだ余裕がある
-                                        triGrams.insert(tri);
-                                        _LOG_DETAIL(_T("[{}] PICK: {}: triGram({}) OK, triGrams.size={}"), candCount, iter->debugString(), to_wstr(tri), triGrams.size());
+                                        triGrams.insert(tri, true);
+                                        _LOG_DETAIL(_T("[{}] PICK: {}: triGram({}) OK, triGrams.size={}"), candCount, iter->debugString(), to_wstr(utils::safe_tailstr(str, 3)), triGrams.size());
                                         ++candCount;
                                         ++pickCount;
                                         continue;
                                     }
-                                    if (!bi.empty() && biGrams.find(bi) == biGrams.end()) {
+                                    if (bi && !biGrams.contains(bi)) {
                                         // 未見のbigramであり、まだ余裕がある
-                                        biGrams.insert(bi);
-                                        _LOG_DETAIL(_T("[{}] PICK: {}: biGram({}) OK, biGrams.size={}"), candCount, iter->debugString(), to_wstr(bi), biGrams.size());
+                                        biGrams.insert(bi, true);
+                                        _LOG_DETAIL(_T("[{}] PICK: {}: biGram({}) OK, biGrams.size={}"), candCount, iter->debugString(), to_wstr(utils::safe_tailstr(str, 2)), biGrams.size());
                                         ++candCount;
                                         ++pickCount;
                                         continue;
@@ -1210,12 +1309,12 @@ namespace lattice2 {
                 if (!bAutoBushuFound && !bPaddingDerived) {
                     MString s;
                     int numBS;
-                    std::tie(s, numBS) = cand.applyAutoBushu(piece, strokeCount);  // 自動部首合成
+                    std::tie(s, numBS) = cand.applyAutoBushu(piece, strokeCount, _autoBushuMemo);  // 自動部首合成
                     if (!s.empty()) {
                         if (!isKatakanaConversionSatisfied(s, bKatakanaConversion)) continue;
                         if (!isKanjiOrHiraganaPreferenceSatisfied(cand, s, piece)) continue;
                         _LOG_DETAIL(_T("AutoBush FOUND"));
-                        CandidateString newCandStr(s, strokeCount, cand.mazeFeat());
+                        CandidateString newCandStr(std::move(s), strokeCount, cand);
                         newCandStr.setPenalty(penalty);
                         newCandStr.setPaddingDerived(bPaddingDerived);
                         newCandStr.setFollowingPreferenceType(prefType);
@@ -1233,20 +1332,20 @@ namespace lattice2 {
                 // 複数文字指定などの解析も行う
                 std::vector<MString> ss = cand.applyPiece(piece, strokeCount, paddingLen, isStrokeBS, bKatakanaConversion);
                 int prevKanjiCandCost = INT_MIN;
-                for (MString s : ss) {
+                for (MString& s : ss) {
                     if (!isKatakanaConversionSatisfied(s, bKatakanaConversion)) continue;
                     if (!isKanjiOrHiraganaPreferenceSatisfied(cand, s, piece)) continue;
-                    CandidateString newCandStr(s, strokeCount, cand.mazeFeat());
+                    CandidateString newCandStr(std::move(s), strokeCount, cand);
                     newCandStr.setPenalty(penalty);
                     newCandStr.setPaddingDerived(bPaddingDerived);
                     newCandStr.setFollowingPreferenceType(prefType);
                     // ここで形態素解析やNgram解析をしてコストを計算し、末尾に追加する
                     //MString subStr = substringBetweenNonJapaneseChars(s);
                     int tailMorphLen = calcCandidateCost(newCandStr, minLen, useMorphAnalyzer, isStrokeBS);
-                    if (tailMorphLen == 1 && isTailIsolatedKanji(s)) {
+                    if (tailMorphLen == 1 && isTailIsolatedKanji(newCandStr.string())) {
                         // 末尾が孤立した漢字なら、出現順で初期コストを加算する(「過|禍」で「禍」のほうが優先されて出力されることがあるため)
                         int cost = newCandStr.totalCost();
-                        _LOG_DETAIL(_T("ISOLATED KANJI={}, cost={}, prevCost={}"), to_wstr(s), cost, prevKanjiCandCost);
+                        _LOG_DETAIL(_T("ISOLATED KANJI={}, cost={}, prevCost={}"), to_wstr(newCandStr.string()), cost, prevKanjiCandCost);
                         if (prevKanjiCandCost == INT_MIN) {
                             prevKanjiCandCost = cost;
                         } else if (cost > prevKanjiCandCost) {
@@ -1317,7 +1416,7 @@ namespace lattice2 {
                 int delta = removeLen + 1;
                 for (const auto& cand : _candidates) {
                     if (cand.strokeLen() + delta <= strokeCount) {
-                        if (cand.string() == firstCand.string()) {
+                        if (cand.hasSameString(firstCand)) {
                             // 先頭と同じ文字列の候補だったら、そのストローク数の他の候補も残さない
                             ++delta;
                             continue;
@@ -1347,13 +1446,15 @@ namespace lattice2 {
                 int removeLen = 0;
                 const auto& firstCand = _candidates.front();
                 const MString& firstStr = firstCand.string();
+                // targetStr: 末尾から trimLen 文字削除した文字列 (1文字ずつ削っていくので、毎回作り直さない)
+                MString targetStr = firstStr;
                 for (size_t trimLen = 1; trimLen <= firstStr.size() && removeLen == 0; ++trimLen) {
-                    // targetStr: 末尾から trimLen 文字削除した文字列
-                    MString targetStr = utils::safe_substr(firstStr, 0, (int)(firstStr.size() - trimLen));
+                    targetStr.pop_back();
+                    size_t targetHash = SharedMString::hashOf(targetStr);
                     _LOG_DETAIL(L"_candidates.size={}, trimLen={}, targetStr={}, origCand: {}", _candidates.size(), trimLen, to_wstr(targetStr), firstCand.infoString());
                     for (const auto& cand : _candidates) {
                         _LOG_DETAIL(L"cand: {}", cand.infoString());
-                        if (targetStr == cand.string()) {
+                        if (cand.hasSameString(targetStr, targetHash)) {
                             _LOG_DETAIL(L"FOUND same candidate: trimLen={}, {}", trimLen, cand.debugString());
                             removeLen = firstCand.strokeLen() - cand.strokeLen();
                             break;
@@ -1512,7 +1613,7 @@ namespace lattice2 {
         void updateKBestList(const std::vector<WordPiece>& pieces, FollowingPreferenceType prefType, bool useMorphAnalyzer, int currentStrokeCount, bool strokeBack, bool bKatakanaConversion) override {
             _LOG_DETAIL(_T("ENTER: _candidates.size()={}, pieces.size()={}, prefType={}, useMorphAnalyzer={}, currentStrokeCount={}, strokeBack={}"),
                 _candidates.size(), pieces.size(), to_string(prefType), useMorphAnalyzer, currentStrokeCount, strokeBack);
-            _debugLog.clear();
+            _autoBushuMemo.clear();
             bool bCandidateSelecting = _origFirstCand >= 0;
 
             setRollOverStroke(currentStrokeCount - 1, STATE_COMMON->IsRollOverStroke());
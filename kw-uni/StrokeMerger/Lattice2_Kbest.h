@@ -1,6 +1,7 @@
 #pragma once
 
 namespace lattice2 {
+    class CandidateLog;
 
     // K-best な文字列を格納する
     class KBestList {
@@ -59,6 +60,12 @@ namespace lattice2 {
 
         virtual String debugKBestString(size_t maxLn = 100000) const = 0;
 
+        // 解候補ログの記録先を設定する (nullptr なら記録しない)
+        virtual void setCandidateLog(CandidateLog* candidateLog) = 0;
+
+        // 先頭から maxLn 個までの候補を解候補ログに記録する
+        virtual void recordCandidates(CandidateLog& candidateLog, size_t maxLn) const = 0;
+
     public:
         virtual FollowingPreferenceType getFollowingPreferenceType() const = 0;
         virtual void resetFollowingPreferenceType() = 0;
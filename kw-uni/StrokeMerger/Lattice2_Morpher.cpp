@@ -1,8 +1,8 @@
 #include "Logger.h"
 #include "file_utils.h"
-#include "settings.h"
+#include "Settings.h"
 
-#include "Dymazin/MorphBridge.h"
+#include "DyMazin/MorphBridge.h"
 #include "Llama/LlamaBridge.h"
 #include "Lattice2_Common.h"
 #include "Lattice2_Morpher.h"
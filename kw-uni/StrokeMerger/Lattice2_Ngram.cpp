@@ -2,10 +2,12 @@
 #include "file_utils.h"
 #include "string_utils.h"
 
-#include "settings.h"
+#include "Settings.h"
 
+#include "Lattice.h"
 #include "Lattice2_Common.h"
 #include "Lattice2_Ngram.h"
+#include "Lattice2_KanjiDate.h"
 
 #include "Ngram/NgramBridge.h"
 
@@ -84,6 +86,110 @@ namespace lattice2 {
 
     const size_t MAX_SELECTED_NGRAM_LEN = 8;
 
+    // 選択Ngramのキー (〓付きのものも含む) を、文字列の1回の走査で探すための Aho-Corasick オートマトン
+    // キーの集合が変わったら invalidate() しておき、次の走査の前に作り直す
+    class SelectedNgramMatcher {
+        struct Node {
+            std::vector<std::pair<mchar_t, int>> children;      // 文字の昇順
+            int fail = 0;
+            int output = -1;        // fail をたどって最初に見つかる、キーの終端ノード
+            int depth = 0;
+            const std::set<SelectedNgramPairBonus>* bonuses = 0;   // キーの終端ならそのボーナス集合
+            bool userDefined = false;
+            size_t lastAccepted = 0;    // 同じ走査で同じキーを2度出力しないための印
+        };
+
+        std::vector<Node> nodes;
+        size_t scanCount = 0;
+        bool bDirty = true;
+
+        int findChild(int n, mchar_t ch) const {
+            const auto& children = nodes[n].children;
+            auto iter = std::lower_bound(children.begin(), children.end(), ch,
+                [](const std::pair<mchar_t, int>& c, mchar_t x) { return c.first < x; });
+            return iter != children.end() && iter->first == ch ? iter->second : -1;
+        }
+
+        int addChild(int n, mchar_t ch) {
+            int m = findChild(n, ch);
+            if (m >= 0) return m;
+            m = (int)nodes.size();
+            int depth = nodes[n].depth + 1;
+            nodes.emplace_back();
+            nodes[m].depth = depth;
+            auto& children = nodes[n].children;
+            auto iter = std::lower_bound(children.begin(), children.end(), ch,
+                [](const std::pair<mchar_t, int>& c, mchar_t x) { return c.first < x; });
+            children.insert(iter, std::make_pair(ch, m));
+            return m;
+        }
+
+        int step(int n, mchar_t ch) const {
+            while (true) {
+                int m = findChild(n, ch);
+                if (m >= 0) return m;
+                if (n == 0) return 0;
+                n = nodes[n].fail;
+            }
+        }
+
+    public:
+        inline bool isDirty() const {
+            return bDirty;
+        }
+
+        inline void invalidate() {
+            bDirty = true;
+        }
+
+        // キーと、キーごとのボーナス集合からオートマトンを作る (ボーナス集合は map の要素を直接参照する)
+        void build(const std::map<MString, std::set<SelectedNgramPairBonus>>& selectedNgramMap, const std::set<MString>& userDefinedWords) {
+            nodes.clear();
+            nodes.emplace_back();
+            for (const auto& entry : selectedNgramMap) {
+                if (entry.first.empty()) continue;
+                int n = 0;
+                for (mchar_t ch : entry.first) n = addChild(n, ch);
+                nodes[n].bonuses = &entry.second;
+                nodes[n].userDefined = userDefinedWords.contains(entry.first);
+            }
+            // 幅優先で fail と output を張る
+            std::vector<int> queue;
+            queue.reserve(nodes.size());
+            for (const auto& c : nodes[0].children) queue.push_back(c.second);
+            for (size_t qi = 0; qi < queue.size(); ++qi) {
+                int n = queue[qi];
+                for (const auto& c : nodes[n].children) {
+                    int m = c.second;
+                    int f = n == 0 ? 0 : step(nodes[n].fail, c.first);
+                    if (nodes[m].depth == 1) f = 0;
+                    nodes[m].fail = f;
+                    nodes[m].output = nodes[f].bonuses ? f : nodes[f].output;
+                    queue.push_back(m);
+                }
+            }
+            scanCount = 0;
+            bDirty = false;
+        }
+
+        // head に続けて str を走査し、キーに一致するたびに accept(start, len, bonuses, userDefined) を呼ぶ
+        // start, len は head を先頭(位置0)に含めた位置と長さ。accept が true を返したキーは、同じ走査では再度呼ばない
+        template<typename F>
+        void scan(mchar_t head, const MString& str, F accept) {
+            if (nodes.size() <= 1) return;
+            ++scanCount;
+            int state = 0;
+            for (size_t t = 0; t <= str.size(); ++t) {
+                state = step(state, t == 0 ? head : str[t - 1]);
+                for (int o = nodes[state].bonuses ? state : nodes[state].output; o > 0; o = nodes[o].output) {
+                    Node& node = nodes[o];
+                    if (node.lastAccepted == scanCount) continue;
+                    if (accept(t + 1 - node.depth, (size_t)node.depth, *node.bonuses, node.userDefined)) node.lastAccepted = scanCount;
+                }
+            }
+        }
+    };
+
     // ユーザー選択によるポジティブ|ネガティブNgram対を扱うクラス
     class SelectedNgram {
         std::map<MString, int> selectedNgrams;
@@ -93,6 +199,9 @@ namespace lattice2 {
 
         std::map<MString, std::set<SelectedNgramPairBonus>> selectedNgramMap;
 
+        // selectedNgramMap のキーを探すオートマトン
+        SelectedNgramMatcher matcher;
+
         bool bUpdated = false;
 
     private:
@@ -125,8 +234,8 @@ namespace lattice2 {
 
         // ユーザー選択によるポジティブ|ネガティブNgram対の読み込み
         // 形式: <Positive Ngram>|<Negative Ngram> <TAB> <ボーナスポイント>
-        void _loadSelectedNgramFile(StringRef ngramFile, bool userDefined) {
-            auto path = utils::joinPath(SETTINGS->rootDir, ngramFile);
+        void _loadSelectedNgramFile(StringRef rootDir, StringRef ngramFile, bool userDefined) {
+            auto path = utils::joinPath(rootDir, ngramFile);
             LOG_INFOH(_T("LOAD SELECTED: {}"), path.c_str());
             utils::IfstreamReader reader(path);
             size_t count = 0;
@@ -170,32 +279,31 @@ namespace lattice2 {
             auto pred = [&key](const SelectedNgramPairBonus& item) { return item.ngramPair == key; };
             if (selectedNgramMap.contains(posi)) std::erase_if(selectedNgramMap[posi], pred);
             if (selectedNgramMap.contains(nega)) std::erase_if(selectedNgramMap[nega], pred);
+            if (!selectedNgramMap.contains(posi) || !selectedNgramMap.contains(nega)) matcher.invalidate();
             selectedNgramMap[posi].insert(SelectedNgramPairBonus{ key, bonusPoint });       // positive ngram
             selectedNgramMap[nega].insert(SelectedNgramPairBonus{ key, -bonusPoint });      // negative ngram
         }
 
-        bool _gatherSelectedNgramPairBonus(std::set<SelectedNgramPairBonus>& resultSet, const MString& ngram, bool onlyUserDefined = false) const {
-            _LOG_DETAIL(L"CALLED: ngram={}, userDefined={}", to_wstr(ngram), onlyUserDefined);
-            if (!onlyUserDefined || _isUserDefinedWord(ngram)) {
-                auto iter = selectedNgramMap.find(ngram);
-                if (iter != selectedNgramMap.end()) {
-                    resultSet.insert(iter->second.begin(), iter->second.end());
-                    _LOG_DETAIL(L"FOUND: ngram={}, set<SelectedNgramPairBonus>: {}", to_wstr(ngram), debugStringOfSelectedNgramPairBonusSet(resultSet));
-                    return true;
-                }
-            }
-            return false;
-        }
-
     public:
         // ユーザー選択によるポジティブ|ネガティブNgram対の読み込み
         // 形式: <Positive Ngram>|<Negative Ngram> <TAB> <ボーナスポイント>
-        void loadSelectedNgramFile(StringRef userNgramFile, StringRef selectedNgramFile) {
+        // (ファイル名は呼び出し側で決めて渡すこと。ここでは SETTINGS を参照しないので、バックグラウンドで呼んでもよい)
+        void loadSelectedNgramFile(StringRef rootDir, StringRef userNgramFile, StringRef selectedNgramFile) {
             selectedNgrams.clear();
             userDefinedNgramPairs.clear();
             selectedNgramMap.clear();
-            _loadSelectedNgramFile(userNgramFile, true);
-            _loadSelectedNgramFile(selectedNgramFile, false);
+            matcher.invalidate();
+            _loadSelectedNgramFile(rootDir, userNgramFile, true);
+            _loadSelectedNgramFile(rootDir, selectedNgramFile, false);
+        }
+
+        // 読み込んだエントリを other と入れ替える (それまでのエントリは other に移る)
+        void swapEntries(SelectedNgram& other) {
+            selectedNgrams.swap(other.selectedNgrams);
+            userDefinedNgramPairs.swap(other.userDefinedNgramPairs);
+            selectedNgramMap.swap(other.selectedNgramMap);
+            matcher.invalidate();
+            other.matcher.invalidate();
         }
 
         void saveSelectedNgramFile(StringRef ngramFile, int genNum) {
@@ -281,76 +389,58 @@ namespace lattice2 {
         }
 
     public:
-        // 指定された文字列に対して、そこに含まれるNgramに対応する選択Ngramペアボーナスを取得
-        // Ngramは、1~M文字
-        const std::set<SelectedNgramPairBonus> findNgramPairBonus(const MString& str) {
+        // 指定された文字列に対して、そこに含まれるNgramに対応する選択Ngramペアボーナスを results に追加する
+        // Ngramは、1~M文字。先頭からの部分については、〓付きのパターンも調べる
+        // 〓と str を続けて1回だけ走査し、見つかったキーを以下の条件で採用する
+        // - 〓付き: str 全体 (ただし、ひらがな1文字のケースを除く)、先頭から3文字以上(全体未満)、
+        //           および先頭から2文字で、そこに漢字が含まれる場合
+        // - 1文字: ユーザー定義のもの、および「非漢字-漢字-非漢字」の漢字
+        // - 2~M文字: すべて
+        void findNgramPairBonus(const MString& str, std::vector<const SelectedNgramPairBonus*>& results) {
             _LOG_DETAILH(L"ENTER: str={}", to_wstr(str));
-            std::set<SelectedNgramPairBonus> resultSet;
-            bool kanji = false;
-            bool pKanji = false;
-            bool ppKanji = false;
-            for (size_t i = 0; i < str.size(); ++i) {
-                ppKanji = pKanji;
-                pKanji = kanji;
-                kanji = utils::is_kanji(str[i]);
-                if (i == 0) {
-                    _LOG_DETAIL(L"PATH-0");
-                    // 先頭文字の場合は、str と一致する〓付きも調べる (例: 〓池 vs 〓での)
-                    // ただし、ひらがな1文字のケースを除く
-                    if (str.size() > 1 || !utils::is_hiragana(str.front())) {
-                        //for (size_t len = 1; len <= MAX_SELECTED_NGRAM_LEN && i + len <= str.size(); ++len) {
-                        //    _gatherSelectedNgramPairBonus(resultSet, MSTR_GETA + str.substr(i, len));
-                        //}
-                        //_LOG_DETAIL(L"Pattern:{}: {}", i, to_wstr(MSTR_GETA + str));
-                        bool found = _gatherSelectedNgramPairBonus(resultSet, MSTR_GETA + str);
-                        if (!found && str.size() > 2) {
-                            // 先頭全体の〓付きパターンが見つからなかった場合は、短い長さのパターンも調べる
-                            for (size_t len = 3; len <= MAX_SELECTED_NGRAM_LEN && len < str.size(); ++len) {
-                                //_LOG_DETAIL(L"Pattern:{}: {}", i, to_wstr(MSTR_GETA + str.substr(0, len)));
-                                _gatherSelectedNgramPairBonus(resultSet, MSTR_GETA + str.substr(0, len));
-                            }
-                        }
+            if (matcher.isDirty()) matcher.build(selectedNgramMap, userDefinedNgramPairs);
+            const size_t strLen = str.size();
+            auto isKanjiAt = [&str](size_t i) { return utils::is_kanji(str[i]); };
+            size_t numResults = results.size();
+            matcher.scan(MSTR_GETA.front(), str, [&](size_t start, size_t len, const std::set<SelectedNgramPairBonus>& bonuses, bool userDefined) {
+                bool accepted = false;
+                if (start == 0) {
+                    // 〓付き (先頭からの len - 1 文字)
+                    size_t n = len - 1;
+                    if (n == 0) {
+                        accepted = false;
+                    } else if (n == strLen) {
+                        accepted = strLen > 1 || !utils::is_hiragana(str.front());
+                    } else if (n >= 3) {
+                        accepted = true;
+                    } else if (n == 2) {
+                        accepted = isKanjiAt(0) || isKanjiAt(1);
                     }
-                } else if (i + 1 < str.size()) {
-                    _LOG_DETAIL(L"PATH-1");
-                    // 先頭以外で、後続する文字がある場合は、先頭からの〓付きも調べる
-                    if (i == 1 && (pKanji || kanji)) {
-                        // 先頭から2文字目にかけて、漢字が含まれるパターンの場合
-                        //_LOG_DETAIL(L"Pattern:{}: {}", i, to_wstr(MSTR_GETA + str.substr(0, 2)));
-                        _gatherSelectedNgramPairBonus(resultSet, MSTR_GETA + str.substr(0, 2));
-                    } else if (i > 1) {
-                        // 先頭から3文字目以降の場合は、ひらがなのみのパターンも含めて調べる
-                        //_LOG_DETAIL(L"Pattern:{}: {}", i, to_wstr(MSTR_GETA + str.substr(0, i + 1)));
-                        _gatherSelectedNgramPairBonus(resultSet, MSTR_GETA + str.substr(0, i + 1));
+                } else {
+                    size_t i = start - 1;
+                    if (len == 1) {
+                        // ユーザー定義差分については1文字の差分も調べる
+                        // また、「非漢字-漢字-非漢字」のパターンの場合は、漢字1文字についても調べる
+                        accepted = userDefined || (i >= 1 && i + 1 < strLen && !isKanjiAt(i - 1) && isKanjiAt(i) && !isKanjiAt(i + 1));
+                    } else {
+                        accepted = len <= MAX_SELECTED_NGRAM_LEN;
                     }
                 }
-                if (i >= 2 && !ppKanji && pKanji && !kanji) {
-                    _LOG_DETAIL(L"PATH-2");
-                    // 「非漢字-漢字-非漢字」のパターンの場合は、漢字1文字についても調べる
-                    //_LOG_DETAIL(L"Pattern:{}: non-kanji [{}] - kanji [{}] - non-kanji [{}]", i, to_wstr(str[i - 2]), to_wstr(str[i - 1]), to_wstr(str[i]));
-                    _gatherSelectedNgramPairBonus(resultSet, str.substr(i - 1, 1));
-                }
-                _LOG_DETAIL(L"PATH-3");
-                if (i + 1 <= str.size()) {
-                    // ユーザー定義差分については1文字の差分も調べる
-                    _gatherSelectedNgramPairBonus(resultSet, str.substr(i, 1), true);
-                }
-                _LOG_DETAIL(L"PATH-4");
-                for (size_t len = 2; len <= MAX_SELECTED_NGRAM_LEN && i + len <= str.size(); ++len) {
-                    // 2文字以上の差分についてはGETA(〓)なしパターンも調べる
-                    _gatherSelectedNgramPairBonus(resultSet, str.substr(i, len));
+                if (accepted) {
+                    for (const auto& bonus : bonuses) results.push_back(&bonus);
+                    _LOG_DETAIL(L"FOUND: start={}, len={}, set<SelectedNgramPairBonus>: {}", start, len, debugStringOfSelectedNgramPairBonusSet(bonuses));
                 }
-            }
-            _LOG_DETAILH(L"RESULTS: str={}, resultSet={}", to_wstr(str), resultSet.empty() ? L"EMPTY" : _joinSelectedNgramPairBonusSet(resultSet));
-            return resultSet;
+                return accepted;
+            });
+            _LOG_DETAILH(L"RESULTS: str={}, num={}", to_wstr(str), results.size() - numResults);
         }
     }; // class SelectedNgram
 
     SelectedNgram selectedNgramInstance;
 
-    // 指定された文字列に対して、そこに含まれるNgramに対応する選択Ngramペアボーナスを取得 (Ngramは、2~M文字)
-    const std::set<SelectedNgramPairBonus> findNgramPairBonus(const MString& str) {
-        return selectedNgramInstance.findNgramPairBonus(str);
+    // 指定された文字列に対して、そこに含まれるNgramに対応する選択Ngramペアボーナスを results に追加 (Ngramは、1~M文字)
+    void findNgramPairBonus(const MString& str, std::vector<const SelectedNgramPairBonus*>& results) {
+        selectedNgramInstance.findNgramPairBonus(str, results);
     }
 
     // 2つの文字列の最初の差分部分を見つける
@@ -617,28 +707,34 @@ namespace lattice2 {
 #define SELECTED_NGRAM_FILE (SETTINGS->useTmpRealtimeNgramFile ? SELECTED_NGRAM_TEMP_FILE : SELECTED_NGRAM_MAIN_FILE)
 #define USER_NGRAM_FILE (SETTINGS->useTmpRealtimeNgramFile ? USER_NGRAM_TEMP_FILE : USER_NGRAM_MAIN_FILE)
 
-    // 各種Ngramファイルの読み込み
-    void loadNgramFiles() {
-        LOG_INFO(L"ENTER");
+    NgramFileNames currentNgramFileNames() {
+        return NgramFileNames{ REALTIME_NGRAM_FILE, USER_NGRAM_FILE, SELECTED_NGRAM_FILE };
+    }
 
-        // リアルタイムNgramファイルの読み込み
-        auto realtimeNgramPath = utils::joinPath(SETTINGS->rootDir, REALTIME_NGRAM_FILE);
-        int nEntries = NgramBridge::loadRealtimeDict(realtimeNgramPath);
-        LOG_INFO(L"loadRealtimeDict(): nEntries={}", realtimeNgramPath, nEntries);
+    // 各種Ngramファイルの読み込み
+    // バックグラウンドで呼ばれるので、SETTINGS を参照しないこと
+    std::function<void()> prepareNgramFiles(StringRef rootDir, const NgramFileNames& files) {
+        LOG_INFO(L"ENTER: rootDir={}, realtime={}, user={}, selected={}", rootDir, files.realtimeNgramFile, files.userNgramFile, files.selectedNgramFile);
 
-        // ユーザー定義Ngramファイルの読み込み
-        auto userNgramPath = utils::joinPath(SETTINGS->rootDir, USER_NGRAM_FILE);
-        nEntries = NgramBridge::loadUserNgram(userNgramPath);
-        LOG_INFO(L"loadUserNgram(): nEntries={}", userNgramPath, nEntries);
-        //userNgramBonusCounts.clear();
-        //_loadNgramFile(USER_NGRAM_FILE, userNgramBonusCounts);
+        // リアルタイムNgramファイルとユーザー定義Ngramファイルの読み込み
+        auto realtimeNgramPath = utils::joinPath(rootDir, files.realtimeNgramFile);
+        auto userNgramPath = utils::joinPath(rootDir, files.userNgramFile);
+        auto installNgramDicts = NgramBridge::prepareNgramDicts(realtimeNgramPath, userNgramPath);
 
         // ユーザー選択Ngramファイルの読み込み
-        selectedNgramInstance.loadSelectedNgramFile(USER_NGRAM_FILE, SELECTED_NGRAM_FILE);
-
-        maxCandidatesSize = 0;
+        auto selectedNgram = std::make_shared<SelectedNgram>();
+        selectedNgram->loadSelectedNgramFile(rootDir, files.userNgramFile, files.selectedNgramFile);
 
         LOG_INFO(L"LEAVE");
+        return [installNgramDicts, selectedNgram]() {
+            installNgramDicts();
+            selectedNgramInstance.swapEntries(*selectedNgram);
+            maxCandidatesSize = 0;
+        };
+    }
+
+    void loadNgramFiles() {
+        prepareNgramFiles(SETTINGS->rootDir, currentNgramFileNames())();
     }
 
     // リアルタイムNgramファイルの保存
@@ -657,10 +753,12 @@ namespace lattice2 {
     //    return ch == ' ' || ch == '|';
     //}
 
-    void _updateRealtimeNgramCountByWord(bool bIncrease, const MString& word) {
-        int delta = bIncrease ? 1 : -1;
-        _DEBUG_SENT(int count =) NgramBridge::updateRealtimeEntry(to_wstr(word), delta);
-        LOG_DEBUGH(L"updateRealtimeEntry({}): resultCount={}", to_wstr(word), count);
+    // _updateRealtimeNgram で更新する Ngram の (位置, 長さ) を詰めて並べたもの (呼び出しごとに使い回す)
+    std::vector<size_t> realtimeNgramSpans;
+
+    inline void _addRealtimeNgramSpan(size_t pos, size_t len) {
+        realtimeNgramSpans.push_back(pos);
+        realtimeNgramSpans.push_back(len);
     }
 
     // リアルタイムNgramの更新
@@ -670,6 +768,7 @@ namespace lattice2 {
             LOG_DEBUGH(L"LEAVE: collectRealtimeNgram={}", collectRealtimeNgram);
             return;
         }
+        realtimeNgramSpans.clear();
         int strlen = (int)str.size();
         int hirakanLen = 0;
         int hiraLen = 0;
@@ -698,30 +797,32 @@ namespace lattice2 {
             }
             // 漢字1文字で、前後が非漢字の場合は、その漢字のみのNgramも更新する (例: 「池」の前後がひらがななら、「池」も更新する)
             if (pos >= 3 && !ppKanji && pKanji && !kanji) {
-                _updateRealtimeNgramCountByWord(bIncrease, str.substr(pos - 1, 1));
+                _addRealtimeNgramSpan(pos - 1, 1);
             }
             //if (kanjiLen >= 2 && pos >= 1) {
             //    // 漢字が2文字以上連続している場合は、2gramを更新する
-            //    _updateRealtimeNgramCountByWord(bIncrease, str.substr(pos - 1, 2));
+            //    _addRealtimeNgramSpan(pos - 1, 2);
             //}
             if (hirakanLen >= 2 && pos >= 1) {
                 // ひらがなor漢字が2文字以上連続している場合は、2gramを更新する
-                _updateRealtimeNgramCountByWord(bIncrease, str.substr(pos - 1, 2));
+                _addRealtimeNgramSpan(pos - 1, 2);
             }
             if (hirakanLen >= 3 && pos >= 2) {
                 // ひらがなor漢字が3文字以上連続している場合は、3gramを更新する
-                _updateRealtimeNgramCountByWord(bIncrease, str.substr(pos - 2, 3));
+                _addRealtimeNgramSpan(pos - 2, 3);
             }
             if (hiraLen >= 4 && pos >= 3) {
                 // ひらがなが4文字以上連続している場合は、4gramを更新する
-                _updateRealtimeNgramCountByWord(bIncrease, str.substr(pos - 3, 4));
+                _addRealtimeNgramSpan(pos - 3, 4);
             }
             if (SETTINGS->developerSettingsEnabled && hiraLen >= 5 && pos >= 4) {
                 // ひらがなが4文字以上連続している場合は、4gramを更新する
-                _updateRealtimeNgramCountByWord(bIncrease, str.substr(pos - 4, 5));
+                _addRealtimeNgramSpan(pos - 4, 5);
             }
         }
-        LOG_DEBUGH(L"LEAVE: str={}", to_wstr(str));
+        // 集めた Ngram をまとめて更新する
+        _DEBUG_SENT(int count =) NgramBridge::updateRealtimeEntries(str, realtimeNgramSpans, bIncrease ? 1 : -1);
+        LOG_DEBUGH(L"LEAVE: str={}, updated={}", to_wstr(str), count);
     }
 
     // 編集バッファのフラッシュによるリアルタイムNgramの更新
@@ -741,20 +842,6 @@ namespace lattice2 {
         return 0;
     }
 
-    MString kanjiNumChars = to_mstr(L"一二三四五六七八九十〇");
-    std::wregex kanjiDateTime(L"[一二三四五六七八九十〇](年[一二三四五六七八九十〇]+月([一二三四五六七八九十〇]+日)?|月[一二三四五六七八九十〇]+日|[一二三四五六七八九十〇]日)");
-    
-    size_t datePatternMatchedLen(const MString& str, size_t pos) {
-        if (pos < str.size() && kanjiNumChars.find(str[pos]) != MString::npos) {
-            std::wsmatch match;
-            std::wstring wstr = to_wstr(str.substr(pos));
-            if (std::regex_search(wstr, match, kanjiDateTime)) {
-                return match.length(0);
-            }
-        }
-        return 0;
-    }
-
 //#define SUCCESSIVE_HIRAGANA_LEN 8
 //#define LONG_HIRAGANA_LEN 4
 //#define SUCCESSIVE_HIRAGANA_COST 5000
@@ -801,7 +888,7 @@ namespace lattice2 {
         int cost0 = NgramBridge::ngramCalcCost(targetStr, morphs, ngrams, SETTINGS->multiStreamDetailLog);
         int cost = cost0;
         _LOG_DETAIL(L"ngrams: initial cost={}\n--------\n{}\n--------", cost, to_wstr(utils::join(ngrams, '\n')));
-        if (utils::reMatch(to_wstr(targetStr), kanjiDateTime)) {
+        if (isKanjiDateTime(targetStr)) {
             cost -= calcNgramBonus(DATE_PATTERN_BONUMS_POINT);
         }
         //cost += calcSuccessiveHiraganaCost(morphs);
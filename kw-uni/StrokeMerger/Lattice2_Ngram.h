@@ -1,7 +1,9 @@
 #pragma once
 
 #include "utils/string_type.h"
-#include "settings.h"
+#include "Settings.h"
+
+struct NgramFileNames;
 
 namespace lattice2 {
 
@@ -38,6 +40,13 @@ namespace lattice2 {
     // コストとNgramファイルの読み込み
     void loadNgramFiles();
 
+    // 現在の設定で読み込むNgramファイル
+    NgramFileNames currentNgramFileNames();
+
+    // Ngramファイルを現在の辞書とは別に読み込み、それらに差し替える関数を返す
+    // 読み込みはバックグラウンドで行ってよいが、差し替えはデコーダのロックを取得して行うこと
+    std::function<void()> prepareNgramFiles(StringRef rootDir, const NgramFileNames& files);
+
     // リアルタイムNgramの保存
     void saveRealtimeNgramFile();
 
@@ -47,8 +56,9 @@ namespace lattice2 {
     // 候補選択による、SelectedNgramの更新
     void updateSelectedNgramByUserSelect(const MString& oldCand, const MString& newCand);
 
-    // 指定された文字列に対して、そこに含まれるNgramに対応する選択Ngramペアボーナスを取得 (Ngramは、2~5文字)
-    const std::set<SelectedNgramPairBonus> findNgramPairBonus(const MString& str);
+    // 指定された文字列に対して、そこに含まれるNgramに対応する選択Ngramペアボーナスを results に追加 (Ngramは、1~8文字)
+    // 追加されるのは選択Ngramの表の要素へのポインタなので、選択Ngramが更新される前に使い終えること
+    void findNgramPairBonus(const MString& str, std::vector<const SelectedNgramPairBonus*>& results);
 
     // Ngramコストの取得
     int getNgramCost(const MString& str, const std::vector<MString>& morphs, bool bUseGeta = true);
@@ -1816,14 +1816,14 @@ void StrokeMergerHistoryNode::createStrokeTrees(int targetTable) {
     }
 
     // 主テーブルファイルの構築
-    auto tableFile1 = !SETTINGS->tableFile.empty() ? utils::joinPath(SETTINGS->rootDir, _T("tmp\\tableFile1.tbl")) : L"";
+    auto tableFile1 = !SETTINGS->tableFile.empty() ? utils::joinPath(SETTINGS->rootDir, _T("tmp/tableFile1.tbl")) : L"";
     createStrokeTree(tableFile1, STROKE_TREE_CREATOR(StrokeTableNode::CreateStrokeTree));
 
     // 副テーブルファイルの構築
-    auto tableFile2 = !SETTINGS->tableFile2.empty() ? utils::joinPath(SETTINGS->rootDir, _T("tmp\\tableFile2.tbl")) : L"";
+    auto tableFile2 = !SETTINGS->tableFile2.empty() ? utils::joinPath(SETTINGS->rootDir, _T("tmp/tableFile2.tbl")) : L"";
     createStrokeTree(tableFile2, STROKE_TREE_CREATOR(StrokeTableNode::CreateStrokeTree2));
 
     // 第3テーブルファイルの構築
-    auto tableFile3 = !SETTINGS->tableFile3.empty() ? utils::joinPath(SETTINGS->rootDir, _T("tmp\\tableFile3.tbl")) : L"";
+    auto tableFile3 = !SETTINGS->tableFile3.empty() ? utils::joinPath(SETTINGS->rootDir, _T("tmp/tableFile3.tbl")) : L"";
     createStrokeTree(tableFile3, STROKE_TREE_CREATOR(StrokeTableNode::CreateStrokeTree3));
 }
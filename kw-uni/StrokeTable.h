@@ -6,6 +6,7 @@
 #include "StringNode.h"
 #include "FunctionNode.h"
 #include "Node.h"
+#include "sparse_ptr_array.h"
 
 class PostRewriteOneShotNode;
 
@@ -33,7 +34,8 @@ class StrokeTableNode : public Node {
 
 private:
     //std::vector<std::unique_ptr<Node>> children;
-    std::vector<Node*> children;
+    // 子ノードの大半は空なので、使用中のスロットだけを詰めて持つ
+    utils::SparsePtrArray<Node> children;
 
     size_t _depth;
 
@@ -96,27 +98,20 @@ public:
 
     // n番目の子ノードを返す
     inline Node* getNth(size_t n) const {
-        return n < children.size() ? children[n] : 0;
+        return children.get(n);
     }
 
     // n番目の子ノードをセットする
     inline void setNthChild(size_t n, Node* node) {
-        if (n < children.size()) {
-            if (children[n]) {
-                delete children[n];     // 新しい n番目の子ノードをセットするために、既存のものを削除しておく
-            }
-            children[n] = node;
+        Node* old = children.set(n, node);
+        if (old) {
+            delete old;     // 新しい n番目の子ノードをセットしたので、既存のものを削除しておく
         }
     }
 
     // n番目の子ノードとスワップする
     inline Node* swapNthChild(size_t n, Node* node) {
-        Node* old = 0;
-        if (n < children.size()) {
-            old = children[n];
-            children[n] = node;
-        }
-        return old;
+        return children.set(n, node);
     }
 
     // 後置書き換えノードを取得
@@ -452,15 +452,16 @@ StrokeTableNode::~StrokeTableNode() {
     LOG_DEBUGH(_T("CALLED: destructor: ptr={:p}"), (void*)this);
     delete rewriteNode;
 #ifndef _DEBUG
-    for (auto p : children) {
+    for (size_t k = 0; k < children.count(); ++k) {
+        auto p = children.ptrAt(k);
         if (p && !p->isShared()) delete p;       // 子ノードの削除 (デストラクタ)
     }
 #else
     if (_depth == 0) {
-        target_ptr = (void*)children[44];
+        target_ptr = (void*)children.get(44);
     }
-    for (size_t i = 0; i < children.size(); ++i) {
-        auto p = children[i];
+    for (size_t k = 0; k < children.count(); ++k) {
+        auto p = children.ptrAt(k);
         if (_depth > 0 && target_ptr != nullptr && target_ptr == (void*)p) {
             if (p && !p->isShared()) delete p;       // 子ノードの削除 (デストラクタ)
             continue;
@@ -507,9 +508,10 @@ void StrokeTableNode::mergeRewriteNode(PostRewriteOneShotNode* node) {
 
 // 指定文字に至るストローク列を返す
 bool StrokeTableNode::getStrokeListSub(const MString& target, std::vector<int>& list, bool bFull) {
-    for (size_t i = 0; i < children.size(); ++i) {
+    for (size_t k = 0; k < children.count(); ++k) {
+        size_t i = children.indexAt(k);
         if (!bFull && i >= NORMAL_DECKEY_NUM) break;
-        Node* p = children[i];
+        Node* p = children.ptrAt(k);
         if (p) {
             StrokeTableNode* pn = dynamic_cast<StrokeTableNode*>(p);
             if (pn) {
@@ -551,7 +553,7 @@ void StrokeTableNode::MakeStrokeGuide(StringRef targetChars, int tableId) {
 String StrokeTableNode::makeChildrenString() const {
     String result;
     for (size_t i = 10; i < 20; ++i) {
-        Node* p = children[i];
+        Node* p = children.get(i);
         result += (p && p->isStringLikeNode()) ? to_wstr(p->getString()) : L"□";
     }
     return result;
@@ -577,7 +579,8 @@ bool StrokeTableNode::hasOnlyUsualRewriteNdoe() {
 }
 
 int StrokeTableNode::findPostRewriteNode(int result) {
-    for (Node* p : children) {
+    for (size_t k = 0; k < children.count(); ++k) {
+        Node* p = children.ptrAt(k);
         if (p) {
             StrokeTableNode* pn = dynamic_cast<StrokeTableNode*>(p);
             if (pn) {
@@ -601,13 +604,8 @@ int StrokeTableNode::findPostRewriteNode(int result) {
 
 bool StrokeTableNode::hasComboNode() {
     _LOG_DETAIL(_T("ENTER"));
-    bool result = false;
-    for (int i = COMBO_DECKEY_START; i < (int)children.size(); ++i) {
-        if (children[i]) {
-            result = true;
-            break;
-        }
-    }
+    // COMBO_DECKEY_START 以降に使用中のスロットがあるか
+    bool result = children.lowerBound(COMBO_DECKEY_START) < children.count();
     _LOG_DETAIL(_T("LEAVE: {}"), result);
     return result;
 }
@@ -16,7 +16,8 @@
 #include "DeckeyToChars.h"
 #include "deckey_id_defs.h"
 #include "MyPrevChar.h"
-#include "Oneshot/PostRewriteOneShot.h"
+#include "OneShot/PostRewriteOneShot.h"
+#include "StrokeTreeCache.h"
 
 
 #if 0
@@ -243,6 +244,9 @@ namespace {
         // 定義列マップ
         std::map<String, std::shared_ptr<std::vector<String>>> linesMap;
 
+        // インクルードしたファイルのパス
+        std::vector<String> includedFiles;
+
         //// 漢字置換マップ
         //std::map<String, String> kanjiConvMap;
 
@@ -285,6 +289,11 @@ namespace {
             return rootNode;
         }
 
+        // インクルードしたファイルのパスを返す
+        const std::vector<String>& GetIncludedFiles() const {
+            return includedFiles;
+        }
+
         // デフォルトのシフト面の機能(自身の文字を返す)ノード(MyCharNode)の設定
         void setupShiftedKeyFunction(StrokeTableNode* tblNode) {
             _LOG_DEBUGH(_T("CALLED"));
@@ -1090,6 +1099,7 @@ namespace {
             _LOG_DEBUGH(_T("INCLUDE: FILE PATH: {}"), includeFilePath);
             auto reader = utils::IfstreamReader(includeFilePath);
             if (reader.success()) {
+                includedFiles.push_back(includeFilePath);
                 auto lines = reader.getAllLines();
                 lines.push_back(_T("#end __include__"));
                 size_t nextLineNum = lineNumber + 1;
@@ -1283,6 +1293,23 @@ namespace {
         }
     }
 
+    // ストローク木を作成する
+    // テーブルソースとインクルードファイルが前回から変わっていなければ、コンパイル済みファイルから復元する
+    StrokeTableNode* createStrokeTree(StringRef tableFile, std::vector<String>& lines, bool bPrimary) {
+        String compiledFile = StrokeTreeCache::GetCompiledFilePath(tableFile);
+        uint64_t fingerprint = StrokeTreeCache::CalcFingerprint(lines);   // lines はインクルードにより書き換わるので、解析前に計算しておく
+        StrokeTableNode* rootNode = StrokeTreeCache::Load(compiledFile, fingerprint);
+        if (rootNode) return rootNode;
+
+        StrokeTreeBuilder builder(tableFile, lines, bPrimary);
+        rootNode = builder.CreateStrokeTree();
+        // エラーや警告があった場合は、次回も解析してメッセージを出すように、書き出さないでおく
+        if (ERROR_HANDLER->GetErrorLevel() >= ErrorHandler::LEVEL_INFO) {
+            StrokeTreeCache::Save(compiledFile, fingerprint, builder.GetIncludedFiles(), rootNode);
+        }
+        return rootNode;
+    }
+
     void gatherStrokeChars(std::set<mchar_t>& charSet, StrokeTableNode* node) {
         if (node == nullptr) return;
         for (size_t i = 0; i < PLANE_DECKEY_NUM; ++i) {
@@ -1325,7 +1352,7 @@ StrokeTableNode* StrokeTableNode::CreateStrokeTree(StringRef tableFile, std::vec
     LOG_INFO(_T("CALLED: tableFile={}, lines={}"), tableFile, lines.size());
     ROOT_STROKE_NODE = 0;
     if (!tableFile.empty()) {
-        ROOT_STROKE_NODE = StrokeTreeBuilder(tableFile, lines, true).CreateStrokeTree();
+        ROOT_STROKE_NODE = createStrokeTree(tableFile, lines, true);
     }
     RootStrokeNode1.reset(ROOT_STROKE_NODE);
     strokableChars.clear();
@@ -1341,7 +1368,7 @@ StrokeTableNode* StrokeTableNode::CreateStrokeTree2(StringRef tableFile, std::ve
         RootStrokeNode2.reset(nullptr);
     } else {
         LOG_INFO(_T("CreateStrokeTree2: Create: tableFile={}"), tableFile);
-        RootStrokeNode2.reset(StrokeTreeBuilder(tableFile, lines, false).CreateStrokeTree());
+        RootStrokeNode2.reset(createStrokeTree(tableFile, lines, false));
     }
     return RootStrokeNode2.get();
 }
@@ -1351,7 +1378,7 @@ StrokeTableNode* StrokeTableNode::CreateStrokeTree3(StringRef tableFile, std::ve
     LOG_INFO(_T("CALLED: tableFile={}, lines={}"), tableFile, lines.size());
     RootStrokeNode3.reset(nullptr);
     if (!tableFile.empty()) {
-        RootStrokeNode3.reset(StrokeTreeBuilder(tableFile, lines, false).CreateStrokeTree());
+        RootStrokeNode3.reset(createStrokeTree(tableFile, lines, false));
     }
     return RootStrokeNode3.get();
 }
@@ -0,0 +1,393 @@
+//#include "pch.h"
+
+#include "string_utils.h"
+#include "file_utils.h"
+#include "path_utils.h"
+#include "Logger.h"
+
+#include "Node.h"
+#include "StrokeTable.h"
+#include "StringNode.h"
+#include "FunctionNode.h"
+#include "FunctionNodeManager.h"
+#include "DeckeyToChars.h"
+#include "deckey_id_defs.h"
+#include "MyPrevChar.h"
+#include "OneShot/PostRewriteOneShot.h"
+
+#include "StrokeTreeCache.h"
+
+#if 0
+#undef LOG_DEBUGH
+#define LOG_DEBUGH LOG_INFOH
+#endif
+
+namespace {
+    // ファイルの先頭に置く識別子
+    const wchar_t* MAGIC = _T("KWSTROKETREE");
+
+    // 書式のバージョン (ノードの書き出し形式を変えたら上げること)
+    const size_t FORMAT_VERSION = 1;
+
+    // ファイルの末尾に置く終端マーク (途中で切れたファイルを検出するため)
+    const size_t END_MARK = 0x5354454e;
+
+    // ストロークテーブルの深さの上限 (壊れたファイルによる無限再帰の防止用)
+    const size_t MAX_TREE_DEPTH = 64;
+
+    // ノードの種類
+    enum class NodeTag {
+        Null,
+        Table,          // StrokeTableNode
+        String,         // StringNode
+        MyChar,         // MyCharNode
+        FuncSpec,       // FunctionNodeManager で作成される機能ノード
+        Rewrite,        // PostRewriteOneShotNode (およびその派生)
+    };
+
+    // FNV-1a
+    const uint64_t FNV_OFFSET = 0xcbf29ce484222325ULL;
+    const uint64_t FNV_PRIME = 0x100000001b3ULL;
+
+    inline void hashValue(uint64_t& h, uint64_t v) {
+        for (int i = 0; i < 8; ++i) {
+            h ^= (v & 0xff);
+            h *= FNV_PRIME;
+            v >>= 8;
+        }
+    }
+
+    // ファイルのサイズと更新時刻から作るスタンプ。ファイルがなければ 0
+    uint64_t getFileStamp(StringRef path) {
+        std::error_code ec;
+        auto size = std::filesystem::file_size(path, ec);
+        if (ec) return 0;
+        auto mtime = std::filesystem::last_write_time(path, ec);
+        if (ec) return 0;
+        uint64_t h = FNV_OFFSET;
+        hashValue(h, (uint64_t)size);
+        hashValue(h, (uint64_t)mtime.time_since_epoch().count());
+        return h;
+    }
+
+    // 読み込んだファイルの形式が不正だった場合に投げる
+    struct FormatError { };
+
+    // -------------------------------------------------------------------
+    // ストローク木の書き出し
+    class TreeWriter {
+        utils::OfstreamWriter& writer;
+
+        inline void writeTag(NodeTag tag) { writer.write((size_t)tag); }
+
+        inline void writeMString(const MString& ms) { writer.write(std::vector<mchar_t>(ms.begin(), ms.end())); }
+
+        bool writeTable(StrokeTableNode* tblNode) {
+            writeTag(NodeTag::Table);
+            writer.write(tblNode->depth());
+            writer.write(tblNode->numChildren());
+            size_t nChild = 0;
+            for (size_t i = 0; i < tblNode->numChildren(); ++i) {
+                if (tblNode->getNth(i)) ++nChild;
+            }
+            writer.write(nChild);
+            for (size_t i = 0; i < tblNode->numChildren(); ++i) {
+                Node* child = tblNode->getNth(i);
+                if (child) {
+                    writer.write(i);
+                    if (!writeNode(child)) return false;
+                }
+            }
+            return writeNode(tblNode->getRewriteNode());
+        }
+
+        bool writeRewrite(PostRewriteOneShotNode* rewNode) {
+            writeTag(NodeTag::Rewrite);
+            writer.write(rewNode->getFuncSpec());
+            writeMString(rewNode->getRewriteInfo().rewriteStr);
+            writer.write(rewNode->getRewriteInfo().rewritableLen);
+            writer.write(rewNode->getRewriteMap().size());
+            for (const auto& pair : rewNode->getRewriteMap()) {
+                writeMString(pair.first);
+                writeMString(pair.second.rewriteStr);
+                writer.write(pair.second.rewritableLen);
+                if (!writeNode(pair.second.subTable)) return false;
+            }
+            return true;
+        }
+
+    public:
+        TreeWriter(utils::OfstreamWriter& w) : writer(w) { }
+
+        // 復元できないノードがあったら false を返す
+        bool writeNode(Node* node) {
+            if (!node) {
+                writeTag(NodeTag::Null);
+                return true;
+            }
+            StrokeTableNode* tblNode = dynamic_cast<StrokeTableNode*>(node);
+            if (tblNode) return writeTable(tblNode);
+
+            PostRewriteOneShotNode* rewNode = dynamic_cast<PostRewriteOneShotNode*>(node);
+            if (rewNode) return writeRewrite(rewNode);
+
+            StringNode* strNode = dynamic_cast<StringNode*>(node);
+            if (strNode) {
+                writeTag(NodeTag::String);
+                writeMString(strNode->getString());
+                writer.write(strNode->getRewritableLen());
+                return true;
+            }
+
+            FunctionNode* funcNode = dynamic_cast<FunctionNode*>(node);
+            if (funcNode && !funcNode->getFuncSpec().empty()) {
+                writeTag(NodeTag::FuncSpec);
+                writer.write(funcNode->getFuncSpec());
+                return true;
+            }
+            if (dynamic_cast<MyCharNode*>(node)) {
+                writeTag(NodeTag::MyChar);
+                return true;
+            }
+            return false;
+        }
+    };
+
+    // -------------------------------------------------------------------
+    // ストローク木の復元
+    class TreeReader {
+        utils::IfstreamReader& reader;
+
+        inline size_t readSize() {
+            size_t value = 0;
+            reader.read(value);
+            if (!reader.good()) throw FormatError();
+            return value;
+        }
+
+        inline String readString() {
+            String str;
+            reader.read(str);
+            if (!reader.good()) throw FormatError();
+            return str;
+        }
+
+        inline MString readMString() {
+            std::vector<mchar_t> buf;
+            reader.read(buf);
+            if (!reader.good()) throw FormatError();
+            return MString(buf.begin(), buf.end());
+        }
+
+        StrokeTableNode* readTable(size_t level) {
+            size_t depth = readSize();
+            size_t numChildren = readSize();
+            if (level > MAX_TREE_DEPTH || numChildren > TOTAL_DECKEY_NUM) throw FormatError();
+            std::unique_ptr<StrokeTableNode> tblNode(new StrokeTableNode((int)depth, numChildren));
+            size_t nChild = readSize();
+            for (size_t i = 0; i < nChild; ++i) {
+                size_t n = readSize();
+                if (n >= numChildren) throw FormatError();
+                tblNode->setNthChild(n, readNode(level + 1));
+            }
+            Node* node = readNode(level + 1);
+            if (node) {
+                PostRewriteOneShotNode* rewNode = dynamic_cast<PostRewriteOneShotNode*>(node);
+                if (!rewNode) {
+                    if (!node->isShared()) delete node;
+                    throw FormatError();
+                }
+                tblNode->mergeRewriteNode(rewNode);
+            }
+            return tblNode.release();
+        }
+
+        PostRewriteOneShotNode* readRewrite(size_t level) {
+            String funcSpec = readString();
+            std::unique_ptr<PostRewriteOneShotNode> rewNode;
+            if (funcSpec.empty()) {
+                rewNode.reset(new PostRewriteOneShotNode(_T(""), false));
+            } else {
+                Node* node = FunctionNodeManager::CreateFunctionNode(funcSpec);
+                rewNode.reset(dynamic_cast<PostRewriteOneShotNode*>(node));
+                if (!rewNode) {
+                    if (node && !node->isShared()) delete node;
+                    throw FormatError();
+                }
+            }
+            MString rewStr = readMString();
+            size_t rewLen = readSize();
+            rewNode->setRewriteInfo(RewriteInfo(rewStr, rewLen, 0));
+            size_t nEntry = readSize();
+            for (size_t i = 0; i < nEntry; ++i) {
+                MString key = readMString();
+                MString str = readMString();
+                size_t len = readSize();
+                Node* node = readNode(level + 1);
+                StrokeTableNode* subTable = dynamic_cast<StrokeTableNode*>(node);
+                if (node && !subTable) {
+                    if (!node->isShared()) delete node;
+                    throw FormatError();
+                }
+                rewNode->addRewriteInfo(key, RewriteInfo(str, len, subTable));
+            }
+            return rewNode.release();
+        }
+
+    public:
+        TreeReader(utils::IfstreamReader& r) : reader(r) { }
+
+        // ヘッダを読んで、ソースのフィンガープリントとインクルードファイルが一致するか調べる
+        bool readHeader(uint64_t fingerprint) {
+            if (readString() != MAGIC || readSize() != FORMAT_VERSION) return false;
+            uint64_t fpLow = readSize();
+            uint64_t fpHigh = readSize();
+            if (fpLow != (fingerprint & 0xffffffff) || fpHigh != (fingerprint >> 32)) return false;
+            size_t nInclude = readSize();
+            for (size_t i = 0; i < nInclude; ++i) {
+                String path = readString();
+                uint64_t stampLow = readSize();
+                uint64_t stampHigh = readSize();
+                uint64_t stamp = getFileStamp(path);
+                if (stamp == 0 || stampLow != (stamp & 0xffffffff) || stampHigh != (stamp >> 32)) return false;
+            }
+            return true;
+        }
+
+        Node* readNode(size_t level) {
+            switch ((NodeTag)readSize()) {
+            case NodeTag::Null:
+                return 0;
+            case NodeTag::Table:
+                return readTable(level);
+            case NodeTag::String: {
+                MString str = readMString();
+                return new StringNode(str, readSize());
+            }
+            case NodeTag::MyChar:
+                return new MyCharNode();
+            case NodeTag::FuncSpec: {
+                Node* node = FunctionNodeManager::CreateFunctionNode(readString());
+                if (!node) throw FormatError();
+                return node;
+            }
+            case NodeTag::Rewrite:
+                return readRewrite(level);
+            default:
+                throw FormatError();
+            }
+        }
+
+        void readEndMark() {
+            if (readSize() != END_MARK) throw FormatError();
+        }
+    };
+
+} // namespace
+
+DEFINE_CLASS_LOGGER(StrokeTreeCache);
+
+// テーブルファイルに対応するコンパイル済みファイルのパスを返す
+String StrokeTreeCache::GetCompiledFilePath(StringRef tableFile) {
+    return tableFile + _T(".compiled");
+}
+
+// テーブルソースのフィンガープリントを計算する
+// @w, @W で作られる文字はキー配列に依存するので、それも含めておく
+uint64_t StrokeTreeCache::CalcFingerprint(const std::vector<String>& lines) {
+    uint64_t h = FNV_OFFSET;
+    hashValue(h, FORMAT_VERSION);
+    for (const auto& line : lines) {
+        for (auto ch : line) {
+            h ^= (uint64_t)ch;
+            h *= FNV_PRIME;
+        }
+        h ^= '\n';
+        h *= FNV_PRIME;
+    }
+    if (DECKEY_TO_CHARS) {
+        for (int i = 0; i < NORMAL_DECKEY_NUM; ++i) {
+            hashValue(h, DECKEY_TO_CHARS->GetCharFromDeckey(i));
+            hashValue(h, DECKEY_TO_CHARS->GetCharFromDeckey(i + SHIFT_DECKEY_START));
+        }
+    }
+    return h;
+}
+
+// コンパイル済みファイルからストローク木を復元する
+StrokeTableNode* StrokeTreeCache::Load(StringRef compiledFile, uint64_t fingerprint) {
+    LOG_INFO(_T("ENTER: compiledFile={}"), compiledFile);
+    if (!utils::isFileExistent(compiledFile)) {
+        LOG_INFO(_T("LEAVE: not found"));
+        return 0;
+    }
+    utils::IfstreamReader reader(compiledFile, true);
+    if (!reader.success()) {
+        LOG_WARN(_T("Can't open: {}"), compiledFile);
+        return 0;
+    }
+    try {
+        TreeReader treeReader(reader);
+        if (!treeReader.readHeader(fingerprint)) {
+            LOG_INFO(_T("LEAVE: source changed"));
+            return 0;
+        }
+        Node* node = treeReader.readNode(0);
+        std::unique_ptr<StrokeTableNode> rootNode(dynamic_cast<StrokeTableNode*>(node));
+        if (!rootNode) {
+            if (node && !node->isShared()) delete node;
+            throw FormatError();
+        }
+        treeReader.readEndMark();
+        if (rootNode->depth() != 0) throw FormatError();
+        rootNode->checkComboNode();
+        LOG_INFO(_T("LEAVE: loaded"));
+        return rootNode.release();
+    }
+    catch (...) {
+        LOG_WARN(_T("Broken compiled stroke table: {}"), compiledFile);
+    }
+    return 0;
+}
+
+// ストローク木をコンパイル済みファイルに書き出す
+// 書き出し途中のファイルを読まないように、一時ファイルに書いてから置き換える
+bool StrokeTreeCache::Save(StringRef compiledFile, uint64_t fingerprint, const std::vector<String>& includeFiles, StrokeTableNode* rootNode) {
+    LOG_INFO(_T("ENTER: compiledFile={}, includeFiles={}"), compiledFile, includeFiles.size());
+    if (!rootNode) return false;
+
+    String tmpFile = compiledFile + _T(".tmp");
+    bool result = false;
+    {
+        utils::OfstreamWriter writer(tmpFile, true, false);
+        if (writer.success()) {
+            writer.write(String(MAGIC));
+            writer.write(FORMAT_VERSION);
+            writer.write((size_t)(fingerprint & 0xffffffff));
+            writer.write((size_t)(fingerprint >> 32));
+            writer.write(includeFiles.size());
+            result = true;
+            for (const auto& path : includeFiles) {
+                uint64_t stamp = getFileStamp(path);
+                if (stamp == 0) {
+                    result = false;
+                    break;
+                }
+                writer.write(path);
+                writer.write((size_t)(stamp & 0xffffffff));
+                writer.write((size_t)(stamp >> 32));
+            }
+            if (result) result = TreeWriter(writer).writeNode(rootNode);
+            if (result) writer.write(END_MARK);
+        }
+    }
+    if (result) {
+        utils::moveFile(tmpFile, compiledFile);
+    } else {
+        LOG_INFO(_T("Can't compile stroke table: {}"), compiledFile);
+        utils::removeFileIfExists(tmpFile);
+        utils::removeFileIfExists(compiledFile);
+    }
+    LOG_INFO(_T("LEAVE: result={}"), result);
+    return result;
+}
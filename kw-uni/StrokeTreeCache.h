@@ -0,0 +1,29 @@
+#pragma once
+
+#include "string_type.h"
+#include "Logger.h"
+
+class StrokeTableNode;
+
+// -------------------------------------------------------------------
+// コンパイル済みストロークテーブル
+// 構築したストローク木をバイナリファイルに書き出しておき、テーブルソースと
+// インクルードされたファイルが変わっていなければ、次回はテーブルの解析をせずにそこから木を復元する
+class StrokeTreeCache {
+    DECLARE_CLASS_LOGGER;
+
+public:
+    // テーブルファイルに対応するコンパイル済みファイルのパスを返す
+    static String GetCompiledFilePath(StringRef tableFile);
+
+    // テーブルソースのフィンガープリントを計算する (インクルードされたファイルの内容は含まない)
+    static uint64_t CalcFingerprint(const std::vector<String>& lines);
+
+    // コンパイル済みファイルからストローク木を復元する
+    // ソースが変わっていたり、読み込みに失敗したりしたら nullptr を返す
+    static StrokeTableNode* Load(StringRef compiledFile, uint64_t fingerprint);
+
+    // ストローク木をコンパイル済みファイルに書き出す
+    // 復元できないノードを含んでいたり、書き出しに失敗したりしたら false を返す
+    static bool Save(StringRef compiledFile, uint64_t fingerprint, const std::vector<String>& includeFiles, StrokeTableNode* rootNode);
+};
@@ -1,5 +1,3 @@
-#pragma once
-
 #include "PackedString.h"
 
 namespace util {
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+namespace utils {
+    // 整数キー(mchar_t や、それをパックした値)用の open addressing (線形探査) ハッシュマップ
+    // - 要素の削除はサポートしない(辞書の再読み込み時は clear() する)
+    // - 列挙順は不定なので、ファイルに書き出すときは sortedKeys() を使う
+    template<class K, class V>
+    class FlatHashMap {
+    public:
+        using value_type = std::pair<K, V>;
+
+    private:
+        std::vector<value_type> _slots;
+        std::vector<uint8_t> _used;
+        size_t _size = 0;
+        size_t _mask = 0;
+
+        static inline size_t hashOf(K key) {
+            // Fibonacci hashing
+            uint64_t h = (uint64_t)key * 0x9E3779B97F4A7C15ULL;
+            return (size_t)(h ^ (h >> 32));
+        }
+
+        inline size_t findSlot(K key) const {
+            size_t pos = hashOf(key) & _mask;
+            while (_used[pos] && _slots[pos].first != key) pos = (pos + 1) & _mask;
+            return pos;
+        }
+
+        void rehash(size_t capacity) {
+            std::vector<value_type> slots(capacity);
+            std::vector<uint8_t> used(capacity, 0);
+            slots.swap(_slots);
+            used.swap(_used);
+            _mask = capacity - 1;
+            for (size_t i = 0; i < used.size(); ++i) {
+                if (used[i]) {
+                    size_t pos = findSlot(slots[i].first);
+                    _slots[pos] = std::move(slots[i]);
+                    _used[pos] = 1;
+                }
+            }
+        }
+
+        // 負荷率を 1/2 以下に保つ
+        inline void growIfNeeded() {
+            if (_slots.empty()) {
+                rehash(16);
+            } else if ((_size + 1) * 2 > _slots.size()) {
+                rehash(_slots.size() * 2);
+            }
+        }
+
+    public:
+        template<class M, class T>
+        class iterator_base {
+            M* _map;
+            size_t _pos;
+
+            inline void skip() { while (_pos < _map->_used.size() && !_map->_used[_pos]) ++_pos; }
+
+        public:
+            iterator_base(M* map, size_t pos) : _map(map), _pos(pos) { skip(); }
+
+            inline T& operator*() const { return _map->_slots[_pos]; }
+            inline T* operator->() const { return &_map->_slots[_pos]; }
+            inline iterator_base& operator++() { ++_pos; skip(); return *this; }
+            inline bool operator==(const iterator_base& other) const { return _pos == other._pos; }
+            inline bool operator!=(const iterator_base& other) const { return _pos != other._pos; }
+        };
+
+        using iterator = iterator_base<FlatHashMap, value_type>;
+        using const_iterator = iterator_base<const FlatHashMap, const value_type>;
+
+        iterator begin() { return iterator(this, 0); }
+        iterator end() { return iterator(this, _slots.size()); }
+        const_iterator begin() const { return const_iterator(this, 0); }
+        const_iterator end() const { return const_iterator(this, _slots.size()); }
+
+        inline size_t size() const { return _size; }
+
+        inline bool empty() const { return _size == 0; }
+
+        void clear() {
+            _slots.clear();
+            _used.clear();
+            _size = 0;
+            _mask = 0;
+        }
+
+        // 要素だけを消し、スロットの領域は残す (呼び出しごとに使い回す作業用の表で、メモリ確保を避けるため)
+        void clearKeepingCapacity() {
+            if (_size == 0) return;
+            std::fill(_used.begin(), _used.end(), (uint8_t)0);
+            _size = 0;
+        }
+
+        void reserve(size_t n) {
+            size_t capacity = 16;
+            while (capacity < n * 2) capacity *= 2;
+            if (capacity > _slots.size()) rehash(capacity);
+        }
+
+        // key に対応する値へのポインタを返す。見つからなければ nullptr
+        inline V* find(K key) {
+            if (_size == 0) return nullptr;
+            size_t pos = findSlot(key);
+            return _used[pos] ? &_slots[pos].second : nullptr;
+        }
+
+        inline const V* find(K key) const {
+            return const_cast<FlatHashMap*>(this)->find(key);
+        }
+
+        inline bool contains(K key) const {
+            return find(key) != nullptr;
+        }
+
+        // key に対応する値を返す。なければデフォルト値で作成する
+        V& operator[](K key) {
+            V* p = find(key);
+            if (p) return *p;
+            growIfNeeded();
+            size_t pos = findSlot(key);
+            _slots[pos] = value_type(key, V());
+            _used[pos] = 1;
+            ++_size;
+            return _slots[pos].second;
+        }
+
+        // key が未登録の場合に限り登録する。登録したら true を返す
+        bool insert(K key, const V& value) {
+            if (find(key)) return false;
+            (*this)[key] = value;
+            return true;
+        }
+
+        // キーを昇順に並べて返す(ファイル出力用)
+        std::vector<K> sortedKeys() const {
+            std::vector<K> keys;
+            keys.reserve(_size);
+            for (const auto& pair : *this) keys.push_back(pair.first);
+            std::sort(keys.begin(), keys.end());
+            return keys;
+        }
+    };
+}
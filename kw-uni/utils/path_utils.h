@@ -10,7 +10,7 @@ namespace utils {
             return std::filesystem::weakly_canonical(path).wstring();
         }
         catch (...) {
-            return path;
+            return path.wstring();
         }
     }
 
@@ -60,7 +60,7 @@ namespace utils {
             try {
                 return canonicalizePath(p1.append(path2));
             } catch (...) {
-                return path1 + std::filesystem::path::preferred_separator + path2;
+                return path1 + (wchar_t)std::filesystem::path::preferred_separator + path2;
             }
         }
 
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "string_type.h"
+
+namespace utils {
+    // '|' 区切りで複数の候補が設定された素片文字列を、あらかじめ分割しておいたもの
+    // - 各候補は元の文字列の中の (位置, 長さ) で持つので、元の文字列と一緒にコピーしてもそのまま使える
+    // - 分割の仕方は utils::split(s, '|') と同じ (ただし "|" 1文字だけなら、それ自体を1つの候補とする)
+    class PieceAlternatives {
+        std::vector<std::pair<uint32_t, uint32_t>> ranges;
+
+    public:
+        PieceAlternatives() { }
+
+        explicit PieceAlternatives(const MString& s) {
+            assign(s);
+        }
+
+        void assign(const MString& s) {
+            ranges.clear();
+            if (s.size() == 1 && s.front() == '|') {
+                ranges.emplace_back(0, 1);
+                return;
+            }
+            size_t start = 0;
+            for (size_t i = 0; i <= s.size(); ++i) {
+                if (i == s.size() || s[i] == '|') {
+                    ranges.emplace_back((uint32_t)start, (uint32_t)(i - start));
+                    start = i + 1;
+                }
+            }
+        }
+
+        inline size_t size() const {
+            return ranges.size();
+        }
+
+        // i 番目の候補 (s は分割した元の文字列)
+        inline MStringView at(const MString& s, size_t i) const {
+            return MStringView(s).substr(ranges[i].first, ranges[i].second);
+        }
+    };
+}
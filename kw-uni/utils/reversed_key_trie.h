@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "string_type.h"
+#include "flat_hash_map.h"
+
+namespace utils {
+    // std::map<MString, V> のキーを逆順に並べたトライ
+    // - 文字列の末尾から1文字ずつ遡るだけで、マッチする最長のキーが求まる
+    // - ノードの値は build() に渡した map の要素を指すので、map を変更したら作り直すこと
+    // - 空のキーは登録しない
+    template<class V>
+    class ReversedKeyTrie {
+        // ノードに対応する値 (キーの終端でなければ nullptr)
+        std::vector<const V*> nodeValues;
+
+        // 遷移表 -- (ノード番号 << 32) | 文字 => 遷移先ノード番号
+        FlatHashMap<uint64_t, uint32_t> transitions;
+
+        static inline uint64_t makeKey(uint32_t node, mchar_t ch) { return ((uint64_t)node << 32) | (uint32_t)ch; }
+
+    public:
+        // 根ノード (遷移先として根が現れることはないので、next() が遷移なしを表すのにも使う)
+        static constexpr uint32_t ROOT = 0;
+
+        // まだ build() されていないか
+        inline bool empty() const { return nodeValues.empty(); }
+
+        void build(const std::map<MString, V>& map) {
+            nodeValues.assign(1, nullptr);
+            transitions.clear();
+            size_t numChars = 0;
+            for (const auto& pair : map) numChars += pair.first.size();
+            transitions.reserve(numChars);
+            for (const auto& pair : map) {
+                const MString& key = pair.first;
+                if (key.empty()) continue;
+                uint32_t node = ROOT;
+                for (size_t i = key.size(); i > 0; --i) {
+                    uint32_t& dest = transitions[makeKey(node, key[i - 1])];
+                    if (dest == ROOT) {
+                        dest = (uint32_t)nodeValues.size();
+                        nodeValues.push_back(nullptr);
+                    }
+                    node = dest;
+                }
+                nodeValues[node] = &pair.second;
+            }
+        }
+
+        // node から ch で遷移した先のノード (遷移がなければ ROOT)
+        inline uint32_t next(uint32_t node, mchar_t ch) const {
+            auto p = transitions.find(makeKey(node, ch));
+            return p ? *p : ROOT;
+        }
+
+        // node から str[0, len) を末尾から遡り、値のある最長の位置の値とその文字数を value, matchLen に入れる
+        // (値のある位置がなければ、value, matchLen は変更しない)
+        void walkBack(uint32_t node, const mchar_t* str, size_t len, const V*& value, size_t& matchLen) const {
+            for (size_t k = 1; k <= len; ++k) {
+                node = next(node, str[len - k]);
+                if (node == ROOT) break;
+                if (nodeValues[node]) {
+                    value = nodeValues[node];
+                    matchLen = k;
+                }
+            }
+        }
+
+        // node から str[0, len) の全体を末尾から遡った位置の値 (途中で遷移が途切れたら nullptr)
+        const V* walkAll(uint32_t node, const mchar_t* str, size_t len) const {
+            for (size_t i = len; i > 0; --i) {
+                node = next(node, str[i - 1]);
+                if (node == ROOT) return nullptr;
+            }
+            return node != ROOT ? nodeValues[node] : nullptr;
+        }
+    };
+}
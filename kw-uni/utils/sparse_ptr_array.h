@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <bit>
+
+namespace utils {
+    // 大半が空いている固定長のポインタ配列
+    // 使用中のスロットをビットマップで持ち、要素そのものはインデックス順に詰めて格納する
+    // - get(n) はビットマップの popcount で詰めた配列上の位置を求めるので O(1)
+    // - set(n) は詰めた配列への挿入・削除となるので、構築時以外での多用は想定しない
+    template<class T>
+    class SparsePtrArray {
+        size_t _size = 0;
+        std::vector<uint64_t> _bits;
+        std::vector<uint16_t> _rankBase;    // 各ワードより前にある要素数
+        std::vector<uint16_t> _indices;     // 要素のスロット番号 (昇順)
+        std::vector<T*> _ptrs;              // 要素 (_indices と同じ並び)
+
+        // スロット n より前にある要素の数
+        inline size_t rank(size_t n) const {
+            size_t w = n >> 6;
+            uint64_t mask = (1ULL << (n & 63)) - 1;
+            return _rankBase[w] + (size_t)std::popcount(_bits[w] & mask);
+        }
+
+        inline bool test(size_t n) const {
+            return (_bits[n >> 6] >> (n & 63)) & 1;
+        }
+
+    public:
+        SparsePtrArray(size_t size = 0) {
+            resize(size);
+        }
+
+        // スロット数を設定する(既存の要素はクリアされる)
+        void resize(size_t size) {
+            _size = size;
+            _bits.assign((size + 63) / 64, 0);
+            _rankBase.assign(_bits.size(), 0);
+            _indices.clear();
+            _ptrs.clear();
+        }
+
+        // スロット数
+        inline size_t size() const { return _size; }
+
+        // 使用中のスロット数
+        inline size_t count() const { return _ptrs.size(); }
+
+        // n番目のスロットの要素を返す。空きなら nullptr
+        inline T* get(size_t n) const {
+            return n < _size && test(n) ? _ptrs[rank(n)] : nullptr;
+        }
+
+        // n番目のスロットに p をセットして、それまでの要素を返す (p == nullptr ならスロットを空ける)
+        T* set(size_t n, T* p) {
+            if (n >= _size) return nullptr;
+            size_t pos = rank(n);
+            size_t w = n >> 6;
+            if (test(n)) {
+                T* old = _ptrs[pos];
+                if (p) {
+                    _ptrs[pos] = p;
+                } else {
+                    _bits[w] &= ~(1ULL << (n & 63));
+                    for (size_t i = w + 1; i < _rankBase.size(); ++i) --_rankBase[i];
+                    _indices.erase(_indices.begin() + pos);
+                    _ptrs.erase(_ptrs.begin() + pos);
+                }
+                return old;
+            }
+            if (p) {
+                _bits[w] |= 1ULL << (n & 63);
+                for (size_t i = w + 1; i < _rankBase.size(); ++i) ++_rankBase[i];
+                _indices.insert(_indices.begin() + pos, (uint16_t)n);
+                _ptrs.insert(_ptrs.begin() + pos, p);
+            }
+            return nullptr;
+        }
+
+        // k番目の使用中スロットのスロット番号と要素 (スロット番号の昇順に列挙するため)
+        inline size_t indexAt(size_t k) const { return _indices[k]; }
+
+        inline T* ptrAt(size_t k) const { return _ptrs[k]; }
+
+        // n番目以降で最初の使用中スロットの k を返す (なければ count())
+        inline size_t lowerBound(size_t n) const {
+            return n >= _size ? count() : rank(n);
+        }
+    };
+}
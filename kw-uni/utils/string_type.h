@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 
 #ifndef _T
 #define _T(x) L ## x
@@ -15,6 +16,8 @@ using MString = std::basic_string<mchar_t>;
 
 typedef const MString& MStringRef;
 
+using MStringView = std::basic_string_view<mchar_t>;
+
 struct MojiPair {
     wchar_t first;
     wchar_t second;
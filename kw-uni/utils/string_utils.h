@@ -6,6 +6,7 @@
 
 #include "std_utils.h"
 #include "string_type.h"
+#include "utf_utils.h"
 #include "langedge/ctypeutil.hpp"
 
 //#define _WC(p) (_T(p)[0])
@@ -248,30 +249,19 @@ namespace {
 
     MString to_mstr(StringRef ws) {
         MString result;
-        size_t pos = 0;
-        while (pos < ws.size()) result.push_back(make_mchar(ws, &pos));
+        utils::append_wstr_to_mstr(ws, result);
         return result;
     }
 
     MString to_mstr(const wchar_t* wp) {
         MString result;
-        size_t pos = 0;
-        if (wp) {
-            while (wp[pos] != 0) {
-                result.push_back(make_mchar(wp, &pos));
-            }
-        }
+        if (wp) utils::append_wstr_to_mstr(wp, result);
         return result;
     }
 
     MString to_mstr(const wchar_t* wp, size_t len) {
         MString result;
-        size_t pos = 0;
-        if (wp) {
-            while (pos < len) {
-                result.push_back(make_mchar(wp, &pos));
-            }
-        }
+        if (wp) utils::append_wstr_to_mstr(std::wstring_view(wp, len), result);
         return result;
     }
 
@@ -292,9 +282,7 @@ namespace {
 
     String to_wstr(const MString& mstr) {
         String result;
-        for (auto m : mstr) {
-            push_back_wstr(m, result);
-        }
+        utils::append_mstr_to_wstr(mstr, result);
         return result;
     }
 
@@ -326,9 +314,7 @@ namespace {
 
     String to_wstr(const std::vector<mchar_t>& mstr) {
         String result;
-        for (auto m : mstr) {
-            push_back_wstr(m, result);
-        }
+        utils::append_mstr_to_wstr(MStringView(mstr.data(), mstr.size()), result);
         return result;
     }
 
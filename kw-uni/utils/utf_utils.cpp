@@ -1,6 +1,14 @@
 #include <array>
+#include <cstring>
+#include <type_traits>
 
 #include "std_utils.h"
+#include "utf_utils.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define UTF_UTILS_USE_SSE2 1
+#include <emmintrin.h>
+#endif
 
 namespace utils
 {
@@ -209,33 +217,7 @@ namespace utils
     }
 
     bool ConvU8strToWstr(const std::string& u8Str, String& wstr) {
-        for (auto u8It = u8Str.begin(); u8It != u8Str.end(); ++u8It) {
-            auto numBytes = GetU8ByteCount((*u8It));
-            if (numBytes == 0) {
-                return false;
-            }
-
-            std::array<char, 4> u8Ch;
-            u8Ch[0] = (*u8It);
-            for (int i = 1; i < numBytes; i++) {
-                ++u8It;
-                if (u8It == u8Str.end()) {
-                    return false;
-                }
-                u8Ch[i] = (*u8It);
-            }
-
-            std::array<char16_t, 2> u16Ch;
-            if (!ConvChU8ToU16(u8Ch, u16Ch)) {
-                return false;
-            }
-
-            wstr.push_back(u16Ch[0]);
-            if (u16Ch[1] != 0) {
-                wstr.push_back(u16Ch[1]);
-            }
-        }
-        return true;
+        return append_utf8_to_wstr(u8Str, wstr);
     }
 
     bool ConvU8ToU32(const std::string& u8Str, std::u32string& u32Str) {
@@ -301,38 +283,7 @@ namespace utils
     }
 
     bool ConvWstrToU8str(StringRef wstr, std::string& u8Str) {
-        for (auto u16It = wstr.begin(); u16It != wstr.end(); ++u16It) {
-            std::array<char16_t, 2> u16Ch;
-            if (IsU16HighSurrogate((*u16It))) {
-                u16Ch[0] = (*u16It);
-                ++u16It;
-                if (u16It == wstr.end()) {
-                    return false;
-                }
-                u16Ch[1] = (*u16It);
-            } else {
-                u16Ch[0] = (*u16It);
-                u16Ch[1] = 0;
-            }
-
-            std::array<char, 4> u8Ch;
-            if (!ConvChU16ToU8(u16Ch, u8Ch)) {
-                return false;
-            }
-            if (u8Ch[0] != 0) {
-                u8Str.push_back(u8Ch[0]);
-            }
-            if (u8Ch[1] != 0) {
-                u8Str.push_back(u8Ch[1]);
-            }
-            if (u8Ch[2] != 0) {
-                u8Str.push_back(u8Ch[2]);
-            }
-            if (u8Ch[3] != 0) {
-                u8Str.push_back(u8Ch[3]);
-            }
-        }
-        return true;
+        return append_wstr_to_utf8(wstr, u8Str);
     }
 
     bool ConvU16ToU32(const std::u16string& u16Str, std::u32string& u32Str) {
@@ -399,4 +350,298 @@ namespace utils
         }
         return true;
     }
+
+    // -------------------------------------------------------------------
+    // 呼び出し側のバッファに書き込む変換 (cf. utf_utils.h)
+    namespace {
+        inline bool isHighSurrogate(uint32_t ch) { return ch >= 0xD800 && ch <= 0xDBFF; }
+
+        inline bool isLowSurrogate(uint32_t ch) { return ch >= 0xDC00 && ch <= 0xDFFF; }
+
+        // wchar_t は4バイトの環境では符号付きなので、いったん符号なしにしてから拡げる
+        inline uint32_t wcharValue(wchar_t ch) { return (uint32_t)(std::make_unsigned_t<wchar_t>)ch; }
+
+#if UTF_UTILS_USE_SSE2
+        // ASCII 16バイトを wchar_t 16個に拡げて書き込む
+        inline void storeAsciiAsWchars(__m128i v, wchar_t* d) {
+            const __m128i zero = _mm_setzero_si128();
+            __m128i lo = _mm_unpacklo_epi8(v, zero);
+            __m128i hi = _mm_unpackhi_epi8(v, zero);
+            if constexpr (sizeof(wchar_t) == 2) {
+                _mm_storeu_si128((__m128i*)d, lo);
+                _mm_storeu_si128((__m128i*)(d + 8), hi);
+            } else {
+                _mm_storeu_si128((__m128i*)d, _mm_unpacklo_epi16(lo, zero));
+                _mm_storeu_si128((__m128i*)(d + 4), _mm_unpackhi_epi16(lo, zero));
+                _mm_storeu_si128((__m128i*)(d + 8), _mm_unpacklo_epi16(hi, zero));
+                _mm_storeu_si128((__m128i*)(d + 12), _mm_unpackhi_epi16(hi, zero));
+            }
+        }
+
+        // wchar_t 8個がすべて ASCII なら、1バイトずつに詰めて返す
+        inline bool loadWcharsAsAscii(const wchar_t* s, __m128i& packed) {
+            const __m128i zero = _mm_setzero_si128();
+            __m128i v;
+            if constexpr (sizeof(wchar_t) == 2) {
+                v = _mm_loadu_si128((const __m128i*)s);
+                if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(v, _mm_set1_epi16((short)0xFF80)), zero)) != 0xFFFF) return false;
+            } else {
+                __m128i v0 = _mm_loadu_si128((const __m128i*)s);
+                __m128i v1 = _mm_loadu_si128((const __m128i*)(s + 4));
+                __m128i nonAscii = _mm_and_si128(_mm_or_si128(v0, v1), _mm_set1_epi32(~0x7F));
+                if (_mm_movemask_epi8(_mm_cmpeq_epi32(nonAscii, zero)) != 0xFFFF) return false;
+                v = _mm_packs_epi32(v0, v1);
+            }
+            packed = _mm_packus_epi16(v, v);
+            return true;
+        }
+#endif
+    }
+
+    UtfConvResult utf8_to_wchars(std::span<const char> src, std::span<wchar_t> dst) {
+        const uint8_t* s = (const uint8_t*)src.data();
+        const size_t slen = src.size();
+        wchar_t* d = dst.data();
+        const size_t dlen = dst.size();
+        size_t i = 0;
+        size_t j = 0;
+        while (i < slen) {
+            // ASCII が続く区間はまとめて拡げる
+#if UTF_UTILS_USE_SSE2
+            while (i + 16 <= slen && j + 16 <= dlen) {
+                __m128i v = _mm_loadu_si128((const __m128i*)(s + i));
+                if (_mm_movemask_epi8(v) != 0) break;
+                storeAsciiAsWchars(v, d + j);
+                i += 16;
+                j += 16;
+            }
+#else
+            while (i + 8 <= slen && j + 8 <= dlen) {
+                uint64_t v;
+                memcpy(&v, s + i, 8);
+                if ((v & 0x8080808080808080ULL) != 0) break;
+                for (size_t k = 0; k < 8; ++k) d[j + k] = (wchar_t)s[i + k];
+                i += 8;
+                j += 8;
+            }
+#endif
+            if (i >= slen) break;
+
+            uint32_t ch = s[i];
+            if (ch < 0x80) {
+                if (j >= dlen) break;
+                d[j++] = (wchar_t)ch;
+                ++i;
+                continue;
+            }
+            size_t n;
+            if (ch >= 0xC2 && ch < 0xE0) {
+                n = 2;
+                ch &= 0x1F;
+            } else if (ch >= 0xE0 && ch < 0xF0) {
+                n = 3;
+                ch &= 0x0F;
+            } else if (ch >= 0xF0 && ch < 0xF5) {
+                n = 4;
+                ch &= 0x07;
+            } else {
+                break;
+            }
+            if (i + n > slen) break;
+            size_t k = 1;
+            for (; k < n; ++k) {
+                uint32_t t = s[i + k];
+                if ((t & 0xC0) != 0x80) break;
+                ch = (ch << 6) | (t & 0x3F);
+            }
+            if (k < n) break;
+            if ((n == 3 && ch < 0x800) || (n == 4 && (ch < 0x10000 || ch > 0x10FFFF))) break;     // 冗長な表現
+            if (ch < 0x10000) {
+                if (j >= dlen) break;
+                d[j++] = (wchar_t)ch;
+            } else {
+                if (j + 2 > dlen) break;
+                ch -= 0x10000;
+                d[j++] = (wchar_t)(0xD800 + (ch >> 10));
+                d[j++] = (wchar_t)(0xDC00 + (ch & 0x3FF));
+            }
+            i += n;
+        }
+        return { i, j };
+    }
+
+    UtfConvResult wchars_to_utf8(std::span<const wchar_t> src, std::span<char> dst) {
+        const wchar_t* s = src.data();
+        const size_t slen = src.size();
+        char* d = dst.data();
+        const size_t dlen = dst.size();
+        size_t i = 0;
+        size_t j = 0;
+        while (i < slen) {
+#if UTF_UTILS_USE_SSE2
+            // ASCII が続く区間はまとめて詰める
+            __m128i packed;
+            while (i + 8 <= slen && j + 8 <= dlen && loadWcharsAsAscii(s + i, packed)) {
+                _mm_storel_epi64((__m128i*)(d + j), packed);
+                i += 8;
+                j += 8;
+            }
+            if (i >= slen) break;
+#endif
+            uint32_t ch = wcharValue(s[i]);
+            size_t n = 1;
+            if (isHighSurrogate(ch)) {
+                if (i + 1 >= slen || !isLowSurrogate(wcharValue(s[i + 1]))) break;
+                ch = 0x10000 + ((ch - 0xD800) << 10) + (wcharValue(s[i + 1]) - 0xDC00);
+                n = 2;
+            } else if (ch > 0x10FFFF) {
+                break;
+            }
+            if (ch < 0x80) {
+                if (j >= dlen) break;
+                d[j++] = (char)ch;
+            } else if (ch < 0x800) {
+                if (j + 2 > dlen) break;
+                d[j++] = (char)(0xC0 | (ch >> 6));
+                d[j++] = (char)(0x80 | (ch & 0x3F));
+            } else if (ch < 0x10000) {
+                if (j + 3 > dlen) break;
+                d[j++] = (char)(0xE0 | (ch >> 12));
+                d[j++] = (char)(0x80 | ((ch >> 6) & 0x3F));
+                d[j++] = (char)(0x80 | (ch & 0x3F));
+            } else {
+                if (j + 4 > dlen) break;
+                d[j++] = (char)(0xF0 | (ch >> 18));
+                d[j++] = (char)(0x80 | ((ch >> 12) & 0x3F));
+                d[j++] = (char)(0x80 | ((ch >> 6) & 0x3F));
+                d[j++] = (char)(0x80 | (ch & 0x3F));
+            }
+            i += n;
+        }
+        return { i, j };
+    }
+
+    UtfConvResult wchars_to_mchars(std::span<const wchar_t> src, std::span<mchar_t> dst) {
+        const wchar_t* s = src.data();
+        const size_t slen = src.size();
+        mchar_t* d = dst.data();
+        const size_t dlen = dst.size();
+        size_t i = 0;
+        size_t j = 0;
+        while (i < slen) {
+#if UTF_UTILS_USE_SSE2
+            // 上位サロゲートを含まない BMP の区間は、そのまま拡げる
+            const __m128i zero = _mm_setzero_si128();
+            if constexpr (sizeof(wchar_t) == 2) {
+                while (i + 8 <= slen && j + 8 <= dlen) {
+                    __m128i v = _mm_loadu_si128((const __m128i*)(s + i));
+                    __m128i high = _mm_cmpeq_epi16(_mm_and_si128(v, _mm_set1_epi16((short)0xFC00)), _mm_set1_epi16((short)0xD800));
+                    if (_mm_movemask_epi8(high) != 0) break;
+                    _mm_storeu_si128((__m128i*)(d + j), _mm_unpacklo_epi16(v, zero));
+                    _mm_storeu_si128((__m128i*)(d + j + 4), _mm_unpackhi_epi16(v, zero));
+                    i += 8;
+                    j += 8;
+                }
+            } else {
+                while (i + 4 <= slen && j + 4 <= dlen) {
+                    __m128i v = _mm_loadu_si128((const __m128i*)(s + i));
+                    __m128i high = _mm_cmpeq_epi32(_mm_and_si128(v, _mm_set1_epi32((int)0xFFFFFC00)), _mm_set1_epi32(0xD800));
+                    __m128i bmp = _mm_cmpeq_epi32(_mm_srli_epi32(v, 16), zero);
+                    if (_mm_movemask_epi8(_mm_andnot_si128(high, bmp)) != 0xFFFF) break;
+                    _mm_storeu_si128((__m128i*)(d + j), v);
+                    i += 4;
+                    j += 4;
+                }
+            }
+            if (i >= slen) break;
+#endif
+            if (j >= dlen) break;
+            uint32_t ch = wcharValue(s[i]);
+            if (isHighSurrogate(ch) && i + 1 < slen && isLowSurrogate(wcharValue(s[i + 1]))) {
+                d[j++] = mchar_t((ch << 16) + wcharValue(s[i + 1]));
+                i += 2;
+            } else if (ch >= 0x10000 && ch <= 0x10FFFF) {
+                // 4バイトの wchar_t にコードポイントが入っていたら、サロゲートペアにして詰める
+                ch -= 0x10000;
+                d[j++] = mchar_t(((0xD800 + (ch >> 10)) << 16) + (0xDC00 + (ch & 0x3FF)));
+                ++i;
+            } else {
+                d[j++] = mchar_t(ch);
+                ++i;
+            }
+        }
+        return { i, j };
+    }
+
+    UtfConvResult mchars_to_wchars(std::span<const mchar_t> src, std::span<wchar_t> dst) {
+        const mchar_t* s = src.data();
+        const size_t slen = src.size();
+        wchar_t* d = dst.data();
+        const size_t dlen = dst.size();
+        size_t i = 0;
+        size_t j = 0;
+        while (i < slen) {
+#if UTF_UTILS_USE_SSE2
+            // 0 でない BMP の文字が続く区間は、そのまま詰める
+            const __m128i zero = _mm_setzero_si128();
+            while (i + 8 <= slen && j + 8 <= dlen) {
+                __m128i v0 = _mm_loadu_si128((const __m128i*)(s + i));
+                __m128i v1 = _mm_loadu_si128((const __m128i*)(s + i + 4));
+                __m128i ok0 = _mm_andnot_si128(_mm_cmpeq_epi32(v0, zero), _mm_cmpeq_epi32(_mm_srli_epi32(v0, 16), zero));
+                __m128i ok1 = _mm_andnot_si128(_mm_cmpeq_epi32(v1, zero), _mm_cmpeq_epi32(_mm_srli_epi32(v1, 16), zero));
+                if (_mm_movemask_epi8(_mm_and_si128(ok0, ok1)) != 0xFFFF) break;
+                if constexpr (sizeof(wchar_t) == 2) {
+                    // 符号付きの飽和をよけるため、0x8000 ずらしてから詰めて戻す
+                    const __m128i bias32 = _mm_set1_epi32(0x8000);
+                    __m128i packed = _mm_packs_epi32(_mm_sub_epi32(v0, bias32), _mm_sub_epi32(v1, bias32));
+                    _mm_storeu_si128((__m128i*)(d + j), _mm_add_epi16(packed, _mm_set1_epi16((short)0x8000)));
+                } else {
+                    _mm_storeu_si128((__m128i*)(d + j), v0);
+                    _mm_storeu_si128((__m128i*)(d + j + 4), v1);
+                }
+                i += 8;
+                j += 8;
+            }
+            if (i >= slen) break;
+#endif
+            mchar_t m = s[i];
+            wchar_t first = static_cast<wchar_t>(m >> 16);
+            wchar_t second = static_cast<wchar_t>(m & 0xffff);
+            size_t n = (first != 0 ? 1 : 0) + (second != 0 ? 1 : 0);
+            if (j + n > dlen) break;
+            if (first != 0) d[j++] = first;
+            if (second != 0) d[j++] = second;
+            ++i;
+        }
+        return { i, j };
+    }
+
+    namespace {
+        // dst の末尾に maxLen 分の領域を拡げて変換し、書き込んだ長さに切り詰める
+        template<typename S, typename D, typename Conv>
+        bool appendConverted(const S* src, size_t srcLen, size_t maxLen, D& dst, Conv conv) {
+            if (srcLen == 0) return true;
+            size_t base = dst.size();
+            dst.resize(base + maxLen);
+            auto result = conv(std::span<const S>(src, srcLen), std::span<typename D::value_type>(dst.data() + base, maxLen));
+            dst.resize(base + result.written);
+            return result.read == srcLen;
+        }
+    }
+
+    bool append_utf8_to_wstr(std::string_view src, String& dst) {
+        return appendConverted(src.data(), src.size(), src.size(), dst, utf8_to_wchars);
+    }
+
+    bool append_wstr_to_utf8(std::wstring_view src, std::string& dst) {
+        return appendConverted(src.data(), src.size(), src.size() * UTF8_MAX_BYTES_PER_WCHAR, dst, wchars_to_utf8);
+    }
+
+    bool append_wstr_to_mstr(std::wstring_view src, MString& dst) {
+        return appendConverted(src.data(), src.size(), src.size(), dst, wchars_to_mchars);
+    }
+
+    bool append_mstr_to_wstr(MStringView src, String& dst) {
+        return appendConverted(src.data(), src.size(), src.size() * WCHARS_MAX_PER_MCHAR, dst, mchars_to_wchars);
+    }
 }
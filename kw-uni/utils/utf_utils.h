@@ -0,0 +1,48 @@
+#pragma once
+
+#include <span>
+#include <string_view>
+
+#include "string_type.h"
+
+namespace utils
+{
+    // -------------------------------------------------------------------
+    // 呼び出し側が用意したバッファに書き込む文字コード変換
+    // - wchar_t の列は (wchar_t が4バイトの環境でも) UTF-16 のコード単位列として扱う
+    //   (ただし 0xFFFF を超える値が入っていればコードポイントとみなす)
+    // - mchar_t はサロゲートペアを (上位 << 16) + 下位 に詰めたもの (make_mchar と同じ)
+    // - 出力先が足りなくなるか、不正な入力に出会ったところで止まる (read < src.size() で判別する)
+    // - ASCII や BMP の文字だけが続く区間は、まとめて (SSE2 が使えればそれで) 変換する
+
+    struct UtfConvResult {
+        size_t read;        // 変換を終えた入力の長さ
+        size_t written;     // 出力した長さ
+    };
+
+    // 各変換で出力先に必要な長さ (入力1単位あたりの最大)
+    constexpr size_t UTF8_MAX_BYTES_PER_WCHAR = sizeof(wchar_t) == 2 ? 3 : 4;
+    constexpr size_t WCHARS_MAX_PER_MCHAR = 2;
+
+    // UTF-8 → wchar_t (出力は入力のバイト数以下)
+    UtfConvResult utf8_to_wchars(std::span<const char> src, std::span<wchar_t> dst);
+
+    // wchar_t → UTF-8 (出力は入力の UTF8_MAX_BYTES_PER_WCHAR 倍以下)
+    UtfConvResult wchars_to_utf8(std::span<const wchar_t> src, std::span<char> dst);
+
+    // wchar_t → mchar_t (出力は入力の長さ以下)
+    UtfConvResult wchars_to_mchars(std::span<const wchar_t> src, std::span<mchar_t> dst);
+
+    // mchar_t → wchar_t (出力は入力の2倍以下。0 の mchar_t は出力しない)
+    UtfConvResult mchars_to_wchars(std::span<const mchar_t> src, std::span<wchar_t> dst);
+
+    // 変換結果を dst の末尾に追加する (dst の容量が足りていればメモリ確保は起きない)
+    // 入力をすべて変換できたら true を返す (不正な入力があれば、その手前までを追加して false を返す)
+    bool append_utf8_to_wstr(std::string_view src, String& dst);
+
+    bool append_wstr_to_utf8(std::wstring_view src, std::string& dst);
+
+    bool append_wstr_to_mstr(std::wstring_view src, MString& dst);
+
+    bool append_mstr_to_wstr(MStringView src, String& dst);
+}